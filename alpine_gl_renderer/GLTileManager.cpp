@@ -18,6 +18,8 @@
 
 #include "GLTileManager.h"
 
+#include <unordered_set>
+
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QOpenGLExtraFunctions>
@@ -85,6 +87,25 @@ void GLTileManager::draw(QOpenGLShaderProgram* shader_program, const glm::mat4&
 }
 
 void GLTileManager::addTile(const std::shared_ptr<Tile>& tile)
+{
+  m_gpu_tiles.push_back(uploadTile(*tile));
+
+  emit tilesChanged();
+}
+
+void GLTileManager::updateTiles(const TileSetDelta& delta)
+{
+  if (delta.ready.empty() && delta.expired.empty())
+    return;
+  const auto expired = std::unordered_set<srs::TileId, srs::TileId::Hasher>(delta.expired.begin(), delta.expired.end());
+  std::erase_if(m_gpu_tiles, [&expired](const GLTileSet& tileset) { return expired.contains(tileset.tiles.front().first); });
+  for (const auto& tile : delta.ready)
+    m_gpu_tiles.push_back(uploadTile(*tile));
+
+  emit tilesChanged();
+}
+
+GLTileSet GLTileManager::uploadTile(const Tile& tile)
 {
   assert(m_attribute_locations.height != -1);
   auto* f = QOpenGLContext::currentContext()->extraFunctions();
@@ -92,7 +113,7 @@ void GLTileManager::addTile(const std::shared_ptr<Tile>& tile)
   // find an empty slot => todo, for now just create a new tile every time.
   // setup / copy data to gpu
   GLTileSet tileset;
-  tileset.tiles.emplace_back(tile->id, tile->bounds);
+  tileset.tiles.emplace_back(tile.id, tile.bounds);
   tileset.vao = std::make_unique<QOpenGLVertexArrayObject>();
   tileset.vao->create();
   tileset.vao->bind();
@@ -101,7 +122,7 @@ void GLTileManager::addTile(const std::shared_ptr<Tile>& tile)
     tileset.heightmap_buffer->create();
     tileset.heightmap_buffer->bind();
     tileset.heightmap_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    tileset.heightmap_buffer->allocate(tile->height_map.buffer().data(), bufferLengthInBytes(tile->height_map.buffer()));
+    tileset.heightmap_buffer->allocate(tile.height_map.buffer().data(), bufferLengthInBytes(tile.height_map.buffer()));
     f->glEnableVertexAttribArray(GLuint(m_attribute_locations.height));
     f->glVertexAttribPointer(GLuint(m_attribute_locations.height), /*size*/ 1, /*type*/ GL_UNSIGNED_SHORT, /*normalised*/ GL_TRUE, /*stride*/ 0, nullptr);
 
@@ -110,15 +131,11 @@ void GLTileManager::addTile(const std::shared_ptr<Tile>& tile)
     tileset.gl_index_type = GL_UNSIGNED_SHORT;
   }
   tileset.vao->release();
-  tileset.ortho_texture = std::make_unique<QOpenGLTexture>(tile->orthotexture);
+  tileset.ortho_texture = std::make_unique<QOpenGLTexture>(tile.orthotexture);
   tileset.ortho_texture->setMaximumAnisotropy(m_max_anisotropy);
   tileset.ortho_texture->setWrapMode(QOpenGLTexture::WrapMode::ClampToEdge);
   tileset.ortho_texture->setMinMagFilters(QOpenGLTexture::Filter::LinearMipMapLinear, QOpenGLTexture::Filter::Linear);
-
-  // add to m_gpu_tiles
-  m_gpu_tiles.push_back(std::move(tileset));
-
-  emit tilesChanged();
+  return tileset;
 }
 
 void GLTileManager::removeTile(const srs::TileId& tile_id)
@@ -23,6 +23,7 @@
 #include <QObject>
 
 #include "alpine_renderer/Tile.h"
+#include "alpine_renderer/TileSetDelta.h"
 #include "alpine_gl_renderer/GLVariableLocations.h"
 #include "alpine_gl_renderer/GLTileSet.h"
 
@@ -43,10 +44,14 @@ signals:
 public slots:
   void addTile(const std::shared_ptr<Tile>& tile);
   void removeTile(const srs::TileId& tile_id);
+  // removes the expired and adds the ready tiles of the delta, tilesChanged is emitted only once
+  void updateTiles(const TileSetDelta& delta);
   void setAttributeLocations(const TileGLAttributeLocations& d);
   void setUniformLocations(const TileGLUniformLocations& d);
 
 private:
+  [[nodiscard]] GLTileSet uploadTile(const Tile& tile);
+
   static constexpr auto N_EDGE_VERTICES = 65;
   static constexpr auto MAX_TILES_PER_TILESET = 1;
   float m_max_anisotropy = 0;
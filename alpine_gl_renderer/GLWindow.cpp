@@ -73,7 +73,6 @@
 #include "alpine_gl_renderer/GLShaderManager.h"
 #include "alpine_gl_renderer/GLDebugPainter.h"
 #include "alpine_renderer/Tile.h"
-#include "alpine_renderer/TileScheduler.h"
 
 GLWindow::GLWindow() : m_camera({1822577.0, 6141664.0 - 500, 171.28 + 500}, {1822577.0, 6141664.0, 171.28}), // should point right at the stephansdom
                        m_debug_stored_camera(m_camera)
@@ -162,6 +161,7 @@ void GLWindow::paintGL()
 
 //  glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
   m_frame_end = std::chrono::time_point_cast<ClockResolution>(Clock::now());
+  emit frameTimeMeasured(m_frame_end - m_frame_start);
 }
 
 void GLWindow::paintOverGL()
@@ -171,11 +171,21 @@ void GLWindow::paintOverGL()
   const auto frame_duration_text = QString("Last frame: %1ms, draw indicator: ")
                                        .arg(QString::asprintf("%04.1f", frame_duration_float));
 
-  const auto scheduler_stats = QString("Scheduler: %1 tiles in transit, %2 waiting height tiles, %3 waiting ortho tiles, %4 tiles on gpu")
-                                   .arg(m_tile_scheduler->numberOfTilesInTransit())
-                                   .arg(m_tile_scheduler->numberOfWaitingHeightTiles())
-                                   .arg(m_tile_scheduler->numberOfWaitingOrthoTiles())
-                                   .arg(m_tile_scheduler->gpuTiles().size());
+  const auto& statistics = m_tile_scheduler_statistics;
+  const auto scheduler_stats = QString("Scheduler: %1 tiles in transit, %2 waiting height tiles, %3 waiting ortho tiles, %4 tiles on gpu (%5 / %6 MiB)")
+                                   .arg(statistics.n_tiles_in_transit)
+                                   .arg(statistics.n_waiting_height_tiles)
+                                   .arg(statistics.n_waiting_ortho_tiles)
+                                   .arg(statistics.n_gpu_tiles)
+                                   .arg(statistics.gpu_residency.bytes / (1024 * 1024))
+                                   .arg(statistics.gpu_residency.budget / (1024 * 1024));
+  const auto& lod_state = statistics.lod;
+  const auto lod_stats = QString("LOD: threshold scale %1, pressure %2, %3 KiB/s, latency %4ms, download backlog %5ms")
+                             .arg(QString::asprintf("%.2f", lod_state.threshold_scale))
+                             .arg(QString::asprintf("%.2f", lod_state.pressure))
+                             .arg(int(lod_state.throughput / 1024))
+                             .arg(int(std::chrono::duration_cast<std::chrono::milliseconds>(lod_state.latency).count()))
+                             .arg(int(std::chrono::duration_cast<std::chrono::milliseconds>(lod_state.download_backlog).count()));
 
   const auto random_u32 = QRandomGenerator::global()->generate();
 
@@ -185,6 +195,7 @@ void GLWindow::paintOverGL()
   QRect text_bb = painter.boundingRect(10, 20, 1, 15, Qt::TextSingleLine, frame_duration_text);
   painter.drawText(10, 20, frame_duration_text);
   painter.drawText(10, 40, scheduler_stats);
+  painter.drawText(10, 60, lod_stats);
   painter.setBrush(QBrush(QColor(random_u32)));
   painter.drawRect(int(text_bb.right()) + 5, 8, 12, 12);
 }
@@ -219,14 +230,22 @@ void GLWindow::keyPressEvent(QKeyEvent* e)
     m_debug_stored_camera = m_camera;
 
   if (e->key() == Qt::Key::Key_T) {
-    m_tile_scheduler->setEnabled(!m_tile_scheduler->enabled());
-    qDebug("setting tile scheduler enabled = %d", int(m_tile_scheduler->enabled()));
+    // optimistic, the next snapshot from the scheduler confirms it
+    m_tile_scheduler_statistics.enabled = !m_tile_scheduler_statistics.enabled;
+    emit tileSchedulerEnabledRequested(m_tile_scheduler_statistics.enabled);
+    qDebug("setting tile scheduler enabled = %d", int(m_tile_scheduler_statistics.enabled));
+  }
+  if (e->key() == Qt::Key::Key_P) {
+    m_tile_scheduler_statistics.progressive = !m_tile_scheduler_statistics.progressive;
+    emit tileSchedulerProgressiveRequested(m_tile_scheduler_statistics.progressive);
+    qDebug("setting tile scheduler progressive = %d", int(m_tile_scheduler_statistics.progressive));
   }
 }
 
-void GLWindow::setTileScheduler(TileScheduler* new_tile_scheduler)
+void GLWindow::updateTileSchedulerStatistics(const TileScheduler::Statistics& statistics)
 {
-  m_tile_scheduler = new_tile_scheduler;
+  m_tile_scheduler_statistics = statistics;
+  update();
 }
 
 GLTileManager*GLWindow::gpuTileManager() const
@@ -60,6 +60,7 @@
 #include <QPainter>
 
 #include "alpine_renderer/Camera.h"
+#include "alpine_renderer/TileScheduler.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -72,7 +73,6 @@ QT_END_NAMESPACE
 class GLDebugPainter;
 class GLTileManager;
 class GLShaderManager;
-class TileScheduler;
 
 class GLWindow : public QOpenGLWindow
 {
@@ -88,7 +88,9 @@ public:
 
   GLTileManager* gpuTileManager() const;
 
-  void setTileScheduler(TileScheduler* new_tile_scheduler);
+public slots:
+  // the scheduler may run in another thread, its state is only known through these snapshots
+  void updateTileSchedulerStatistics(const TileScheduler::Statistics& statistics);
 
 protected:
   void mouseMoveEvent(QMouseEvent*) override;
@@ -96,6 +98,9 @@ protected:
 
 signals:
   void cameraUpdated(const Camera&);
+  void frameTimeMeasured(std::chrono::steady_clock::duration frame_time);
+  void tileSchedulerEnabledRequested(bool enabled);
+  void tileSchedulerProgressiveRequested(bool progressive);
 
 private:
   using ClockResolution = std::chrono::microseconds;
@@ -106,7 +111,7 @@ private:
   std::unique_ptr<GLDebugPainter> m_debug_painter; // needs opengl context
   std::unique_ptr<GLShaderManager> m_shader_manager;
   std::unique_ptr<QOpenGLPaintDevice> m_gl_paint_device;
-  TileScheduler* m_tile_scheduler;
+  TileScheduler::Statistics m_tile_scheduler_statistics;
 
   Camera m_camera;
   Camera m_debug_stored_camera;
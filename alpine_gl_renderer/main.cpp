@@ -48,15 +48,23 @@
 **
 ****************************************************************************/
 
+#include <QCommandLineParser>
 #include <QGuiApplication>
 #include <QSurfaceFormat>
 #include <QOpenGLContext>
 #include <QObject>
+#include <QStandardPaths>
+#include <QThread>
 #include <QTimer>
 
 #include "GLWindow.h"
 #include "alpine_gl_renderer/GLTileManager.h"
+#include "alpine_renderer/TileArchive.h"
+#include "alpine_renderer/TileDiskCache.h"
 #include "alpine_renderer/TileLoadService.h"
+#include "alpine_renderer/tile_source/ArchiveTileSource.h"
+#include "alpine_renderer/tile_source/FallbackTileSource.h"
+#include "alpine_renderer/tile_source/MemoryTileSource.h"
 #include "alpine_renderer/tile_scheduler/BasicTreeTileScheduler.h"
 #include "alpine_renderer/tile_scheduler/SimplisticTileScheduler.h"
 
@@ -88,23 +96,91 @@ int main(int argc, char *argv[])
 
     QSurfaceFormat::setDefaultFormat(fmt);
 
-    TileLoadService terrain_service("http://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileLoadService::UrlPattern::ZXY, ".png");
-    TileLoadService ortho_service("http://maps.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg");
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption height_archive_option("height-archive", "Serve the height tiles in the tile archive <file> without network.", "file");
+    const QCommandLineOption ortho_archive_option("ortho-archive", "Serve the ortho tiles in the tile archive <file> without network.", "file");
+    const QCommandLineOption offline_option("offline", "Don't download tiles, only the archives and the disk cache are used.");
+    const QCommandLineOption height_zoom_offset_option("height-zoom-offset", "Load the height tiles <levels> zoom levels coarser than the ortho tiles (no prefetching then).", "levels", "0");
+    parser.addOptions({height_archive_option, ortho_archive_option, offline_option, height_zoom_offset_option});
+    parser.process(app);
+    const auto offline = parser.isSet(offline_option);
+
+    // per layer: recently used tiles in memory -> archive (if given) -> disk cache -> network
+    const auto make_tile_source = [&](const QCommandLineOption& archive_option, std::shared_ptr<TileLoadService> network_service) {
+        std::vector<std::shared_ptr<TileSource>> sources = {std::make_shared<MemoryTileSource>(64 * 1024 * 1024)};
+        if (parser.isSet(archive_option))
+            sources.push_back(std::make_shared<ArchiveTileSource>(std::make_shared<TileArchive>(parser.value(archive_option))));
+        sources.push_back(std::move(network_service));
+        return std::make_shared<FallbackTileSource>(std::move(sources));
+    };
+    auto terrain_network_service = std::make_shared<TileLoadService>(offline ? "" : "http://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/", TileSource::UrlPattern::ZXY, ".png");
+    // basemap.at mirrors its tiles on maps1 to maps4, spreading the requests over them gives more parallel connections
+    auto ortho_network_service = std::make_shared<TileLoadService>(
+        offline ? TileUrlTemplate() : TileUrlTemplate("http://maps{s}.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/{z}/{-y}/{x}.jpeg", {"1", "2", "3", "4"}));
+#ifndef __EMSCRIPTEN__
+    // downloaded tiles are kept between runs, hits don't go to the network
+    const auto disk_cache = std::make_shared<TileDiskCache>(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tiles");
+    terrain_network_service->setDiskCache(disk_cache, "height");
+    ortho_network_service->setDiskCache(disk_cache, "ortho");
+#endif
+    // downloaded tiles are decoded in the services' decoder threads, while the next ones are still downloading
+    terrain_network_service->setDecodeOnArrival(true);
+    ortho_network_service->setDecodeOnArrival(true);
+    const auto terrain_service = make_tile_source(height_archive_option, terrain_network_service);
+    const auto ortho_service = make_tile_source(ortho_archive_option, ortho_network_service);
     SimplisticTileScheduler scheduler;
+    scheduler.setProgressive(true);
+    scheduler.prefetcher().setEnabled(true);
+    scheduler.prefetcher().setIdlePrefetchEnabled(true);
+    scheduler.setTimeBudget(std::chrono::microseconds(2000));
+    scheduler.lodController().setEnabled(true);
+    scheduler.setHeightZoomOffset(parser.value(height_zoom_offset_option).toUInt());
     GLWindow glWindow;
     glWindow.showMaximized();
-    glWindow.setTileScheduler(&scheduler);  // i don't like this, gl window is tightly coupled with the scheduler.
 
-    QObject::connect(&glWindow, &GLWindow::cameraUpdated, &scheduler, &TileScheduler::updateCamera);
-    QObject::connect(&scheduler, &TileScheduler::tileRequested, &terrain_service, &TileLoadService::load);
-    QObject::connect(&scheduler, &TileScheduler::tileRequested, &ortho_service, &TileLoadService::load);
-    QObject::connect(&ortho_service, &TileLoadService::loadReady, &scheduler, &TileScheduler::receiveOrthoTile);
-    QObject::connect(&terrain_service, &TileLoadService::loadReady, &scheduler, &TileScheduler::receiveHeightTile);
-    QObject::connect(&ortho_service, &TileLoadService::tileUnavailable, &scheduler, &TileScheduler::notifyAboutUnavailableOrthoTile);
-    QObject::connect(&terrain_service, &TileLoadService::tileUnavailable, &scheduler, &TileScheduler::notifyAboutUnavailableHeightTile);
-    QObject::connect(&scheduler, &TileScheduler::tileReady, [&glWindow](const std::shared_ptr<Tile>& tile) { glWindow.gpuTileManager()->addTile(tile); });
-    QObject::connect(&scheduler, &TileScheduler::tileExpired, [&glWindow](const auto& tile) { glWindow.gpuTileManager()->removeTile(tile); });
-    QObject::connect(&scheduler, &TileScheduler::tileReady, &glWindow, qOverload<>(&GLWindow::update));
+    // traversal and decoding (of tiles, that were not decoded on arrival) run in the scheduler thread, everything between the gl window and the scheduler goes through queued signals.
+    QThread scheduler_thread;
+    scheduler_thread.setObjectName("tile scheduler");
+    scheduler.moveToThread(&scheduler_thread);
+    QObject::connect(&app, &QGuiApplication::aboutToQuit, &scheduler_thread, [&]() {
+        // back to the gui thread, so that the scheduler (and its timers) are destroyed in the thread they live in
+        QMetaObject::invokeMethod(&scheduler, [&]() { scheduler.moveToThread(app.thread()); }, Qt::BlockingQueuedConnection);
+        scheduler_thread.quit();
+        scheduler_thread.wait();
+    });
+    scheduler_thread.start();
+
+    // postCamera is thread safe and drops outdated cameras
+    QObject::connect(&glWindow, &GLWindow::cameraUpdated, &scheduler, &TileScheduler::postCamera, Qt::DirectConnection);
+    QObject::connect(&glWindow, &GLWindow::frameTimeMeasured, &scheduler, &TileScheduler::addFrameTime);
+    QObject::connect(&glWindow, &GLWindow::tileSchedulerEnabledRequested, &scheduler, &TileScheduler::setEnabled);
+    QObject::connect(&glWindow, &GLWindow::tileSchedulerProgressiveRequested, &scheduler, &TileScheduler::setProgressive);
+    QObject::connect(&scheduler, &TileScheduler::statisticsUpdated, &glWindow, &GLWindow::updateTileSchedulerStatistics);
+    // requests, shipments and expiries are batched into one queued signal per scheduler cycle
+    // with a height zoom offset, the requested ids are ortho tiles. the terrain service only gets the coarser height tiles then.
+    if (scheduler.heightZoomOffset() == 0)
+        QObject::connect(&scheduler, &TileScheduler::tileSetChanged, terrain_service.get(), &TileSource::loadBatch);
+    QObject::connect(&scheduler, &TileScheduler::heightTileRequested, terrain_service.get(), &TileSource::load);
+    QObject::connect(&scheduler, &TileScheduler::tileSetChanged, ortho_service.get(), &TileSource::loadBatch);
+    QObject::connect(&scheduler, &TileScheduler::tilePrefetchRequested, terrain_service.get(), &TileSource::prefetch);
+    QObject::connect(&scheduler, &TileScheduler::tilePrefetchRequested, ortho_service.get(), &TileSource::prefetch);
+    QObject::connect(ortho_service.get(), &TileSource::loadReady, &scheduler, &TileScheduler::receiveOrthoTile);
+    QObject::connect(terrain_service.get(), &TileSource::loadReady, &scheduler, &TileScheduler::receiveHeightTile);
+    QObject::connect(ortho_service.get(), &TileSource::imageReady, &scheduler, &TileScheduler::receiveDecodedOrthoTile);
+    QObject::connect(terrain_service.get(), &TileSource::imageReady, &scheduler, &TileScheduler::receiveDecodedHeightTile);
+    // the lod gets coarser, when the network can't deliver the tiles in transit within the max download backlog
+    QObject::connect(ortho_network_service.get(), &TileLoadService::transferEstimateUpdated, &scheduler, &TileScheduler::updateOrthoTransferEstimate);
+    QObject::connect(terrain_network_service.get(), &TileLoadService::transferEstimateUpdated, &scheduler, &TileScheduler::updateHeightTransferEstimate);
+    QObject::connect(ortho_service.get(), &TileSource::tileUnavailable, &scheduler, &TileScheduler::notifyAboutUnavailableOrthoTile);
+    QObject::connect(terrain_service.get(), &TileSource::tileUnavailable, &scheduler, &TileScheduler::notifyAboutUnavailableHeightTile);
+    // with glWindow as context, the lambda is queued to the gui thread
+    QObject::connect(&scheduler, &TileScheduler::tileSetChanged, &glWindow, [&glWindow](const TileSetDelta& delta) {
+        if (delta.ready.empty() && delta.expired.empty())
+            return;
+        glWindow.gpuTileManager()->updateTiles(delta);
+        glWindow.update();
+    });
 
     return app.exec();
 }
@@ -1,5 +1,7 @@
  #pragma once
 
+#include <unordered_map>
+
 #include <glm/glm.hpp>
 #include <QImage>
 
@@ -15,4 +17,5 @@ struct Tile {
   srs::Bounds bounds = {};
   Raster<uint16_t> height_map;
   QImage orthotexture;
+  std::unordered_map<unsigned, QImage> layers; // further layers by TileLayerRegistry::LayerId (overlays), not uploaded to the gpu
 };
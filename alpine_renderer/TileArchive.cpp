@@ -0,0 +1,177 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileArchive.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <tuple>
+
+#include <QDebug>
+
+static_assert(std::endian::native == std::endian::little, "the archive is read and written without byte swapping");
+
+namespace {
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t n_tiles;
+  uint64_t index_offset;
+};
+static_assert(sizeof(Header) == 32);
+
+template <typename Entry>
+auto key(const Entry& entry)
+{
+  return std::make_tuple(entry.zoom_level, entry.x, entry.y);
+}
+}
+
+TileArchive::TileArchive(const QString& path)
+    : m_file(path)
+{
+  if (!map()) {
+    qWarning() << "Could not open tile archive" << path;
+    if (m_data)
+      m_file.unmap(m_data);
+    m_data = nullptr;
+    m_index = nullptr;
+    m_n_tiles = 0;
+  }
+}
+
+TileArchive::~TileArchive()
+{
+  if (m_data)
+    m_file.unmap(m_data);
+}
+
+bool TileArchive::map()
+{
+  static_assert(sizeof(IndexEntry) == 32);
+  if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(Header)))
+    return false;
+  const auto file_size = uint64_t(m_file.size());
+  m_data = m_file.map(0, m_file.size());
+  if (!m_data)
+    return false;
+
+  Header header;
+  std::memcpy(&header, m_data, sizeof(Header));
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+    return false;
+  if (header.index_offset % alignof(IndexEntry) != 0 || header.index_offset < sizeof(Header) || header.index_offset > file_size
+      || header.n_tiles > (file_size - header.index_offset) / sizeof(IndexEntry))
+    return false;
+  m_index = reinterpret_cast<const IndexEntry*>(m_data + header.index_offset);
+  m_n_tiles = size_t(header.n_tiles);
+
+  // checked once, so that lookups don't have to
+  for (size_t i = 0; i < m_n_tiles; ++i) {
+    const auto& entry = m_index[i];
+    if (entry.offset < sizeof(Header) || entry.offset > header.index_offset || entry.size > header.index_offset - entry.offset)
+      return false;
+    if (i > 0 && !(key(m_index[i - 1]) < key(entry)))
+      return false;
+  }
+  return true;
+}
+
+const TileArchive::IndexEntry* TileArchive::find(const srs::TileId& tile_id) const
+{
+  const auto wanted = std::make_tuple(uint32_t(tile_id.zoom_level), uint32_t(tile_id.coords.x), uint32_t(tile_id.coords.y));
+  const auto end = m_index + m_n_tiles;
+  const auto found = std::lower_bound(m_index, end, wanted, [](const IndexEntry& entry, const auto& value) { return key(entry) < value; });
+  if (found == end || key(*found) != wanted)
+    return nullptr;
+  return found;
+}
+
+bool TileArchive::contains(const srs::TileId& tile_id) const
+{
+  return find(tile_id) != nullptr;
+}
+
+QByteArray TileArchive::tile(const srs::TileId& tile_id) const
+{
+  const auto entry = find(tile_id);
+  if (!entry)
+    return {};
+  return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + entry->offset), qsizetype(entry->size));
+}
+
+std::vector<srs::TileId> TileArchive::tileIds() const
+{
+  std::vector<srs::TileId> tile_ids;
+  tile_ids.reserve(m_n_tiles);
+  for (size_t i = 0; i < m_n_tiles; ++i)
+    tile_ids.push_back({m_index[i].zoom_level, {m_index[i].x, m_index[i].y}});
+  return tile_ids;
+}
+
+TileArchiveWriter::TileArchiveWriter(const QString& path)
+    : m_file(path)
+{
+  // the header is written in finish(), when the index offset is known
+  const Header placeholder = {};
+  m_failed = !m_file.open(QIODevice::WriteOnly) || m_file.write(reinterpret_cast<const char*>(&placeholder), sizeof(Header)) != qint64(sizeof(Header));
+  m_offset = sizeof(Header);
+}
+
+bool TileArchiveWriter::add(const srs::TileId& tile_id, const QByteArray& data)
+{
+  if (m_failed || !m_tile_ids.insert(tile_id).second)
+    return false;
+  if (m_file.write(data) != data.size()) {
+    m_failed = true;
+    return false;
+  }
+  m_index.push_back({tile_id.zoom_level, tile_id.coords.x, tile_id.coords.y, 0, m_offset, uint64_t(data.size())});
+  m_offset += uint64_t(data.size());
+  return true;
+}
+
+bool TileArchiveWriter::finish()
+{
+  if (m_failed) {
+    m_file.cancelWriting();
+    return false;
+  }
+  const auto padding = (alignof(TileArchive::IndexEntry) - m_offset % alignof(TileArchive::IndexEntry)) % alignof(TileArchive::IndexEntry);
+  const char zeros[alignof(TileArchive::IndexEntry)] = {};
+  std::sort(m_index.begin(), m_index.end(), [](const auto& a, const auto& b) { return key(a) < key(b); });
+
+  Header header = {};
+  std::memcpy(header.magic, TileArchive::magic, sizeof(header.magic));
+  header.version = TileArchive::version;
+  header.n_tiles = m_index.size();
+  header.index_offset = m_offset + padding;
+
+  const auto index_bytes = qint64(m_index.size() * sizeof(TileArchive::IndexEntry));
+  const auto written = m_file.write(zeros, qint64(padding)) == qint64(padding)
+      && m_file.write(reinterpret_cast<const char*>(m_index.data()), index_bytes) == index_bytes
+      && m_file.seek(0)
+      && m_file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) == qint64(sizeof(Header));
+  if (!written) {
+    m_file.cancelWriting();
+    return false;
+  }
+  return m_file.commit();
+}
@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+
+#include "alpine_renderer/srs.h"
+
+// read-only archive of the encoded tiles (png, jpeg) of one layer in a single file, for rendering a region without network.
+// layout (little endian):
+//   header:   "ATBTILES", u32 version, u32 reserved, u64 number of tiles, u64 offset of the index
+//   payloads: the encoded tiles, concatenated
+//   index:    per tile u32 zoom, u32 x, u32 y, u32 reserved, u64 offset, u64 size; sorted by (zoom, x, y), 8 byte aligned
+// the file is memory mapped, tiles are looked up by binary search and returned without copying.
+class TileArchive
+{
+public:
+  static constexpr char magic[8] = { 'A', 'T', 'B', 'T', 'I', 'L', 'E', 'S' };
+  static constexpr uint32_t version = 1;
+
+  // check isValid(). a missing, truncated or corrupt archive is invalid (and contains no tiles).
+  explicit TileArchive(const QString& path);
+  ~TileArchive();
+  TileArchive(const TileArchive&) = delete;
+  TileArchive& operator=(const TileArchive&) = delete;
+
+  [[nodiscard]] bool isValid() const { return m_data != nullptr; }
+  [[nodiscard]] bool contains(const srs::TileId& tile_id) const;
+  // points into the mapped file (QByteArray::fromRawData), the data is valid as long as the archive exists.
+  // empty if the tile is not in the archive.
+  [[nodiscard]] QByteArray tile(const srs::TileId& tile_id) const;
+  [[nodiscard]] size_t numberOfTiles() const { return m_n_tiles; }
+  [[nodiscard]] std::vector<srs::TileId> tileIds() const;
+
+private:
+  struct IndexEntry {
+    uint32_t zoom_level;
+    uint32_t x;
+    uint32_t y;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+  };
+  [[nodiscard]] const IndexEntry* find(const srs::TileId& tile_id) const;
+  bool map();
+
+  QFile m_file;
+  uchar* m_data = nullptr;
+  const IndexEntry* m_index = nullptr;
+  size_t m_n_tiles = 0;
+
+  friend class TileArchiveWriter;
+};
+
+// writes a TileArchive. the tiles can be added in any order, the payloads are written right away, the index on finish().
+// the file is replaced only when finish() succeeds (QSaveFile).
+class TileArchiveWriter
+{
+public:
+  explicit TileArchiveWriter(const QString& path);
+
+  // returns false, if the tile was added already or writing failed
+  bool add(const srs::TileId& tile_id, const QByteArray& data);
+  bool finish();
+  [[nodiscard]] size_t numberOfTiles() const { return m_index.size(); }
+
+private:
+  QSaveFile m_file;
+  std::vector<TileArchive::IndexEntry> m_index;
+  std::unordered_set<srs::TileId, srs::TileId::Hasher> m_tile_ids;
+  uint64_t m_offset = 0;
+  bool m_failed = false;
+};
@@ -0,0 +1,325 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileDiskCache.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+TileDiskCache::TileDiskCache(const QString& directory, size_t byte_budget)
+    : m_directory(directory),
+      m_byte_budget(byte_budget)
+{
+  loadIndex();
+  m_io_thread.setObjectName("tile disk cache");
+  m_io_context.moveToThread(&m_io_thread);
+  m_io_thread.start();
+}
+
+TileDiskCache::~TileDiskCache()
+{
+  // pending async requests are dropped
+  m_io_thread.quit();
+  m_io_thread.wait();
+}
+
+namespace {
+const QByteArray header_magic = "ATB-TILE-CACHE 1\n";
+
+enum class CacheFile {
+  Tile,
+  LeftOver, // of a write, that was interrupted (the temporary file of QSaveFile)
+  Foreign
+};
+
+// only <layer>/<zoom>/<x>/<y>.tile and the temporary files next to them belong to the cache, anything else in the directory is left alone
+CacheFile classify(const QString& relative_path)
+{
+  const auto parts = relative_path.split('/');
+  if (parts.size() != 4)
+    return CacheFile::Foreign;
+  const auto is_number = [](const QString& string) {
+    bool ok = false;
+    string.toUInt(&ok);
+    return ok;
+  };
+  const auto& file_name = parts[3];
+  const auto dot = file_name.indexOf('.');
+  if (!is_number(parts[1]) || !is_number(parts[2]) || dot < 0 || !is_number(file_name.left(dot)))
+    return CacheFile::Foreign;
+  const auto ending = file_name.mid(dot);
+  if (ending == ".tile")
+    return CacheFile::Tile;
+  if (ending.startsWith(".tile."))
+    return CacheFile::LeftOver;
+  return CacheFile::Foreign;
+}
+}
+
+std::shared_ptr<QByteArray> TileDiskCache::read(const QString& layer, const srs::TileId& tile_id)
+{
+  return readWithMetadata(layer, tile_id).data;
+}
+
+TileDiskCache::CachedTile TileDiskCache::readWithMetadata(const QString& layer, const srs::TileId& tile_id)
+{
+  QMutexLocker locker(&m_mutex);
+  const auto found = m_index.find(key(layer, tile_id));
+  if (found == m_index.end()) {
+    m_statistics.misses++;
+    return {};
+  }
+  QFile file(filePath(found->first));
+  if (!file.open(QIODevice::ReadOnly)) {
+    // deleted behind our back
+    eraseEntry(found->second);
+    m_statistics.misses++;
+    return {};
+  }
+  auto data = std::make_shared<QByteArray>(file.readAll());
+  const auto metadata = decode(*data);
+  // the modification time is the last use, when the index is rebuilt
+  file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+  m_entries.splice(m_entries.begin(), m_entries, found->second);
+  m_statistics.hits++;
+  return {std::move(data), metadata};
+}
+
+bool TileDiskCache::write(const QString& layer, const srs::TileId& tile_id, const QByteArray& data, const Metadata& metadata)
+{
+  QMutexLocker locker(&m_mutex);
+  return store(key(layer, tile_id), data, metadata);
+}
+
+bool TileDiskCache::updateMetadata(const QString& layer, const srs::TileId& tile_id, const Metadata& metadata)
+{
+  QMutexLocker locker(&m_mutex);
+  const auto tile_key = key(layer, tile_id);
+  const auto found = m_index.find(tile_key);
+  if (found == m_index.end())
+    return false;
+  QFile file(filePath(tile_key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    eraseEntry(found->second);
+    return false;
+  }
+  auto data = file.readAll();
+  file.close();
+  std::ignore = decode(data);
+  return store(tile_key, data, metadata);
+}
+
+bool TileDiskCache::contains(const QString& layer, const srs::TileId& tile_id) const
+{
+  QMutexLocker locker(&m_mutex);
+  return m_index.contains(key(layer, tile_id));
+}
+
+void TileDiskCache::erase(const QString& layer, const srs::TileId& tile_id)
+{
+  QMutexLocker locker(&m_mutex);
+  const auto found = m_index.find(key(layer, tile_id));
+  if (found != m_index.end())
+    eraseEntry(found->second);
+}
+
+void TileDiskCache::clear()
+{
+  QMutexLocker locker(&m_mutex);
+  while (!m_entries.empty())
+    eraseEntry(std::prev(m_entries.end()));
+}
+
+void TileDiskCache::readAsync(const QString& layer, const srs::TileId& tile_id)
+{
+  QMetaObject::invokeMethod(&m_io_context, [this, layer, tile_id]() {
+    const auto cached = readWithMetadata(layer, tile_id);
+    emit readFinished(layer, tile_id, cached.data, cached.metadata);
+  });
+}
+
+void TileDiskCache::writeAsync(const QString& layer, const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, const Metadata& metadata)
+{
+  assert(data);
+  QMetaObject::invokeMethod(&m_io_context, [this, layer, tile_id, data = std::move(data), metadata]() { write(layer, tile_id, *data, metadata); });
+}
+
+void TileDiskCache::updateMetadataAsync(const QString& layer, const srs::TileId& tile_id, const Metadata& metadata)
+{
+  QMetaObject::invokeMethod(&m_io_context, [this, layer, tile_id, metadata]() { updateMetadata(layer, tile_id, metadata); });
+}
+
+size_t TileDiskCache::byteBudget() const
+{
+  QMutexLocker locker(&m_mutex);
+  return m_byte_budget;
+}
+
+void TileDiskCache::setByteBudget(size_t new_byte_budget)
+{
+  QMutexLocker locker(&m_mutex);
+  m_byte_budget = new_byte_budget;
+  evict();
+}
+
+size_t TileDiskCache::sizeInBytes() const
+{
+  QMutexLocker locker(&m_mutex);
+  return m_size_in_bytes;
+}
+
+size_t TileDiskCache::numberOfTiles() const
+{
+  QMutexLocker locker(&m_mutex);
+  return m_entries.size();
+}
+
+TileDiskCache::Statistics TileDiskCache::statistics() const
+{
+  QMutexLocker locker(&m_mutex);
+  return m_statistics;
+}
+
+void TileDiskCache::resetStatistics()
+{
+  QMutexLocker locker(&m_mutex);
+  m_statistics = {};
+}
+
+std::string TileDiskCache::key(const QString& layer, const srs::TileId& tile_id)
+{
+  return layer.toStdString() + "/" + std::to_string(tile_id.zoom_level) + "/" + std::to_string(tile_id.coords.x) + "/" + std::to_string(tile_id.coords.y) + ".tile";
+}
+
+QString TileDiskCache::filePath(const std::string& key) const
+{
+  return m_directory + "/" + QString::fromStdString(key);
+}
+
+QByteArray TileDiskCache::encode(const QByteArray& data, const Metadata& metadata)
+{
+  if (!metadata.hasValidators() && metadata.fresh_until == 0)
+    return data;
+  QByteArray contents = header_magic;
+  contents.reserve(header_magic.size() + metadata.etag.size() + metadata.last_modified.size() + 64 + data.size());
+  contents += "etag: " + metadata.etag + "\n";
+  contents += "last-modified: " + metadata.last_modified + "\n";
+  contents += "fresh-until: " + QByteArray::number(metadata.fresh_until) + "\n\n";
+  contents += data;
+  return contents;
+}
+
+TileDiskCache::Metadata TileDiskCache::decode(QByteArray& contents)
+{
+  Metadata metadata;
+  if (!contents.startsWith(header_magic))
+    return metadata; // written before there was a header
+  const auto end = contents.indexOf("\n\n");
+  if (end < 0)
+    return metadata;
+  for (const auto& line : contents.left(end).split('\n')) {
+    const auto separator = line.indexOf(": ");
+    if (separator < 0)
+      continue;
+    const auto name = line.left(separator);
+    const auto value = line.mid(separator + 2);
+    if (name == "etag")
+      metadata.etag = value;
+    else if (name == "last-modified")
+      metadata.last_modified = value;
+    else if (name == "fresh-until")
+      metadata.fresh_until = value.toLongLong();
+  }
+  contents.remove(0, end + 2);
+  return metadata;
+}
+
+void TileDiskCache::loadIndex()
+{
+  QDir().mkpath(m_directory);
+  const auto root = QDir(m_directory);
+  std::vector<std::tuple<qint64, std::string, size_t>> files; // last use, key, bytes
+  QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    const auto path = it.next();
+    const auto relative_path = root.relativeFilePath(path);
+    const auto type = classify(relative_path);
+    if (type == CacheFile::LeftOver)
+      QFile::remove(path);
+    if (type != CacheFile::Tile)
+      continue;
+    const auto info = it.fileInfo();
+    files.emplace_back(info.lastModified().toMSecsSinceEpoch(), relative_path.toStdString(), size_t(info.size()));
+  }
+  std::sort(files.begin(), files.end());
+
+  QMutexLocker locker(&m_mutex);
+  for (const auto& [last_use, tile_key, bytes] : files) {
+    m_entries.push_front({tile_key, bytes});
+    m_index[tile_key] = m_entries.begin();
+    m_size_in_bytes += bytes;
+  }
+  evict();
+}
+
+bool TileDiskCache::store(const std::string& tile_key, const QByteArray& data, const Metadata& metadata)
+{
+  const auto path = filePath(tile_key);
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  // written to a temporary file, which replaces the old one on commit
+  const auto contents = encode(data, metadata);
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size() || !file.commit()) {
+    m_statistics.write_failures++;
+    return false;
+  }
+  if (const auto found = m_index.find(tile_key); found != m_index.end()) {
+    m_size_in_bytes -= found->second->bytes;
+    m_entries.erase(found->second);
+    m_index.erase(found);
+  }
+  m_entries.push_front({tile_key, size_t(contents.size())});
+  m_index[tile_key] = m_entries.begin();
+  m_size_in_bytes += size_t(contents.size());
+  evict();
+  return true;
+}
+
+void TileDiskCache::eraseEntry(EntryList::iterator entry)
+{
+  QFile::remove(filePath(entry->key));
+  m_size_in_bytes -= entry->bytes;
+  m_index.erase(entry->key);
+  m_entries.erase(entry);
+}
+
+void TileDiskCache::evict()
+{
+  while (m_size_in_bytes > m_byte_budget && !m_entries.empty()) {
+    eraseEntry(std::prev(m_entries.end()));
+    m_statistics.evictions++;
+  }
+}
@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+#include "alpine_renderer/srs.h"
+
+// http validators and freshness of a cached tile
+struct CachedTileMetadata {
+  QByteArray etag;
+  QByteArray last_modified;
+  qint64 fresh_until = 0; // utc, ms since epoch. afterwards the tile is stale and should be revalidated with the server.
+  [[nodiscard]] bool hasValidators() const { return !etag.isEmpty() || !last_modified.isEmpty(); }
+  [[nodiscard]] bool isFresh(qint64 now) const { return now < fresh_until; }
+};
+
+// persistent cache for downloaded (still encoded) tiles, keyed by layer and tile id. tiles are stored as single files
+// (<directory>/<layer>/<zoom>/<x>/<y>.tile), layer names have to be valid directory names. other files in the directory are left alone.
+// the cache is bounded by the size of the files, the least recently used tiles are deleted first. the order survives restarts,
+// reads touch the modification time of the file, which is used to rebuild the index when the cache is opened.
+// files are written to a temporary file and renamed once complete, so a crash never leaves a truncated tile behind.
+// tiles with metadata get a short text header in front of the data, that holds the http validators and the freshness.
+// files without header have no validators and are stale.
+// all public functions are thread safe. the async variants run in the cache's own io thread.
+class TileDiskCache : public QObject
+{
+  Q_OBJECT
+public:
+  struct Statistics {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t write_failures = 0;
+    [[nodiscard]] double hitRate() const { return (hits + misses) ? double(hits) / double(hits + misses) : 0.0; }
+  };
+  using Metadata = CachedTileMetadata;
+  struct CachedTile {
+    std::shared_ptr<QByteArray> data; // nullptr on a miss
+    Metadata metadata;
+  };
+
+  explicit TileDiskCache(const QString& directory, size_t byte_budget = size_t(1024) * 1024 * 1024);
+  ~TileDiskCache() override;
+
+  // returns nullptr, if the tile is not in the cache. marks the tile as recently used.
+  [[nodiscard]] std::shared_ptr<QByteArray> read(const QString& layer, const srs::TileId& tile_id);
+  [[nodiscard]] CachedTile readWithMetadata(const QString& layer, const srs::TileId& tile_id);
+  bool write(const QString& layer, const srs::TileId& tile_id, const QByteArray& data, const Metadata& metadata = {});
+  // e.g., after the server answered a revalidation with 304 (not modified). false, if the tile is not in the cache.
+  bool updateMetadata(const QString& layer, const srs::TileId& tile_id, const Metadata& metadata);
+  [[nodiscard]] bool contains(const QString& layer, const srs::TileId& tile_id) const;
+  void erase(const QString& layer, const srs::TileId& tile_id);
+  void clear();
+
+  // read in the io thread, the result is delivered through readFinished
+  void readAsync(const QString& layer, const srs::TileId& tile_id);
+  void writeAsync(const QString& layer, const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, const Metadata& metadata = {});
+  void updateMetadataAsync(const QString& layer, const srs::TileId& tile_id, const Metadata& metadata);
+
+  [[nodiscard]] const QString& directory() const { return m_directory; }
+  [[nodiscard]] size_t byteBudget() const;
+  void setByteBudget(size_t new_byte_budget);
+  [[nodiscard]] size_t sizeInBytes() const;
+  [[nodiscard]] size_t numberOfTiles() const;
+  [[nodiscard]] Statistics statistics() const;
+  void resetStatistics();
+
+signals:
+  // emitted from the io thread. data is nullptr on a miss.
+  void readFinished(const QString& layer, const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, const TileDiskCache::Metadata& metadata);
+
+private:
+  struct Entry {
+    std::string key; // path relative to the cache directory
+    size_t bytes = 0;
+  };
+  using EntryList = std::list<Entry>;
+  [[nodiscard]] static std::string key(const QString& layer, const srs::TileId& tile_id);
+  [[nodiscard]] QString filePath(const std::string& key) const;
+  [[nodiscard]] static QByteArray encode(const QByteArray& data, const Metadata& metadata);
+  // removes the header from the file contents
+  [[nodiscard]] static Metadata decode(QByteArray& contents);
+  void loadIndex();
+  // require a locked m_mutex
+  bool store(const std::string& tile_key, const QByteArray& data, const Metadata& metadata);
+  void eraseEntry(EntryList::iterator entry);
+  void evict();
+
+  QString m_directory;
+  mutable QMutex m_mutex; // guards everything below
+  EntryList m_entries; // front is the most recently used tile
+  std::unordered_map<std::string, EntryList::iterator> m_index;
+  size_t m_byte_budget = 0;
+  size_t m_size_in_bytes = 0;
+  Statistics m_statistics;
+
+  QThread m_io_thread;
+  QObject m_io_context; // lives in m_io_thread, async requests are queued to it
+};
@@ -18,61 +18,449 @@
 
 #include "TileLoadService.h"
 
+#include <algorithm>
+#include <optional>
+
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QImage>
+#include <QDateTime>
 #include <QDebug>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QUrl>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+#include <QHttp1Configuration>
+#endif
 
+namespace {
+bool isTransientError(const QNetworkReply& reply)
+{
+  const auto status = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).value<int>();
+  if (status >= 500 || status == 408 || status == 429)
+    return true;
+  if (status >= 400)
+    return false;
+  switch (reply.error()) {
+  case QNetworkReply::ConnectionRefusedError:
+  case QNetworkReply::RemoteHostClosedError:
+  case QNetworkReply::TimeoutError:
+  case QNetworkReply::OperationCanceledError: // transfer timeout
+  case QNetworkReply::TemporaryNetworkFailureError:
+  case QNetworkReply::NetworkSessionFailedError:
+  case QNetworkReply::ProxyTimeoutError:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// max-age of the cache-control header, 0 for no-cache / no-store
+std::optional<qint64> maxAgeInMs(const QByteArray& cache_control)
+{
+  for (const auto& directive : cache_control.split(',')) {
+    const auto normalised = directive.trimmed().toLower();
+    if (normalised == "no-cache" || normalised == "no-store")
+      return 0;
+    if (normalised.startsWith("max-age="))
+      return normalised.mid(8).toLongLong() * 1000;
+  }
+  return {};
+}
+}
 
 TileLoadService::TileLoadService(const QString& base_url, UrlPattern url_pattern, const QString& file_ending)
-    : m_network_manager(new QNetworkAccessManager()),
-      m_base_url(base_url),
-      m_url_pattern(url_pattern),
-      m_file_ending(file_ending)
+    : TileLoadService(TileUrlTemplate::fromPattern(base_url, url_pattern, file_ending))
 {
+}
 
+TileLoadService::TileLoadService(const TileUrlTemplate& url_template)
+    : m_network_manager(new QNetworkAccessManager()),
+      m_url_template(url_template)
+{
+  if (!m_url_template.isValid() && !m_url_template.urlTemplate().isEmpty())
+    qWarning() << "Invalid tile url template:" << m_url_template.errorString();
 }
 
 TileLoadService::~TileLoadService()
 {
 }
 
+void TileLoadService::setDiskCache(std::shared_ptr<TileDiskCache> disk_cache, const QString& layer)
+{
+  if (m_disk_cache)
+    disconnect(m_disk_cache.get(), nullptr, this, nullptr);
+  m_disk_cache = std::move(disk_cache);
+  m_disk_cache_layer = layer;
+  m_disk_cache_reads.clear();
+  if (m_disk_cache)
+    connect(m_disk_cache.get(), &TileDiskCache::readFinished, this, &TileLoadService::receiveFromDiskCache);
+}
+
+void TileLoadService::setDecodeOnArrival(bool enabled)
+{
+  m_decode_on_arrival = enabled;
+  if (!enabled || m_decoder)
+    return;
+  // kept, when it is disabled again. tiles, that are still being decoded, are delivered.
+  m_decoder = std::make_unique<TileDecoder>();
+  connect(m_decoder.get(), &TileDecoder::decoded, this, &TileLoadService::receiveDecodedTile);
+}
+
+void TileLoadService::setCircuitBreakerPolicy(unsigned failure_threshold, CircuitBreaker::Clock::duration open_duration)
+{
+  m_circuit_breaker_prototype = CircuitBreaker(failure_threshold, open_duration);
+  m_circuit_breakers.clear();
+  // they might wait for the answer to a probe of the old breaker
+  for (const auto& host : m_postponed.keys())
+    resendPostponed(host);
+}
+
+CircuitBreaker::State TileLoadService::circuitBreakerState(const QString& host) const
+{
+  if (!m_circuit_breakers.contains(host))
+    return CircuitBreaker::State::Closed;
+  return m_circuit_breakers.value(host).state();
+}
+
 void TileLoadService::load(const srs::TileId& tile_id)
 {
-  QNetworkReply* reply = m_network_manager->get(QNetworkRequest(QUrl(build_tile_url(tile_id))));
-  connect(reply, &QNetworkReply::finished, [tile_id, reply, this]() {
-    const auto url = reply->url();
-    const auto error = reply->error();
-    if (error == QNetworkReply::NoError) {
-      auto tile = std::make_shared<QByteArray>(reply->readAll());
-      emit loadReady(tile_id, std::move(tile));
-    }
-    else {
-      qDebug() << "Loading of tile " << url << " failed: " << error;
-      emit tileUnavailable(tile_id);
-      // do we need better error handling?
+  request(tile_id, QNetworkRequest::NormalPriority);
+}
+
+void TileLoadService::prefetch(const srs::TileId& tile_id)
+{
+  request(tile_id, QNetworkRequest::LowPriority);
+}
+
+void TileLoadService::request(const srs::TileId& tile_id, QNetworkRequest::Priority priority)
+{
+  if (!m_disk_cache) {
+    download(tile_id, priority);
+    return;
+  }
+  // a read for the tile is running already, a miss is downloaded with the higher priority
+  const auto [read, inserted] = m_disk_cache_reads.try_emplace(tile_id, priority);
+  if (!inserted) {
+    read->second = std::min(read->second, priority); // HighPriority is the smallest value
+    m_statistics.n_coalesced_requests++;
+    return;
+  }
+  m_disk_cache->readAsync(m_disk_cache_layer, tile_id);
+}
+
+void TileLoadService::receiveFromDiskCache(const QString& layer, const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, const TileDiskCache::Metadata& metadata)
+{
+  if (layer != m_disk_cache_layer)
+    return;
+  const auto read = m_disk_cache_reads.find(tile_id);
+  if (read == m_disk_cache_reads.end())
+    return;
+  const auto priority = read->second;
+  m_disk_cache_reads.erase(read);
+  if (!data) {
+    download(tile_id, priority);
+    return;
+  }
+  if (metadata.isFresh(QDateTime::currentMSecsSinceEpoch())) {
+    ready(tile_id, std::move(data));
+    return;
+  }
+  if (m_stale_while_revalidate) {
+    m_statistics.n_stale_hits++;
+    ready(tile_id, data);
+    download(tile_id, QNetworkRequest::LowPriority, {data, metadata}, true);
+    return;
+  }
+  download(tile_id, priority, {data, metadata}, false);
+}
+
+void TileLoadService::download(const srs::TileId& tile_id, QNetworkRequest::Priority priority, const TileDiskCache::CachedTile& stale, bool background)
+{
+  if (!m_url_template.isValid()) {
+    // offline, the stale tile is better than nothing
+    if (stale.data && !background)
+      ready(tile_id, stale.data, true);
+    else if (!background)
+      deliverUnavailable(tile_id);
+    return;
+  }
+  const auto url = build_tile_url(tile_id);
+  // the running download answers this request as well. its priority can't be changed once it is sent.
+  if (m_downloads.contains(url)) {
+    m_statistics.n_coalesced_requests++;
+    auto& running = m_downloads[url];
+    if (!background)
+      running.background = false;
+    // keep the stale tile for stale-if-error. the running request stays unconditional, a retry revalidates.
+    if (stale.data && !running.stale.data)
+      running.stale = stale;
+    return;
+  }
+  auto& download = m_downloads[url];
+  download.tile_id = tile_id;
+  download.priority = priority;
+  download.stale = stale;
+  download.background = background;
+  if (stale.data)
+    m_statistics.n_revalidations++;
+  send(url);
+}
+
+void TileLoadService::send(const QString& url)
+{
+  auto& download = m_downloads[url];
+  if (!circuitBreaker(url).allowRequest()) {
+    m_statistics.n_short_circuited_requests++;
+    postpone(url);
+    return;
+  }
+  download.original = get(url, download);
+  download.replies = {download.original};
+  if (m_hedge_delay.count() > 0)
+    QTimer::singleShot(m_hedge_delay, this, [this, url, n_retries = download.n_retries]() { hedge(url, n_retries); });
+}
+
+void TileLoadService::hedge(const QString& url, unsigned n_retries)
+{
+  // only if the same attempt is still running, and never as the probe of a half open breaker
+  if (!m_downloads.contains(url))
+    return;
+  auto& download = m_downloads[url];
+  if (download.n_retries != n_retries || download.replies.size() != 1 || circuitBreaker(url).state() != CircuitBreaker::State::Closed)
+    return;
+  download.replies.push_back(get(url, download));
+  m_statistics.n_hedged_requests++;
+}
+
+QNetworkReply* TileLoadService::get(const QString& url, const Download& download)
+{
+  auto request = QNetworkRequest(QUrl(url));
+  request.setPriority(download.priority);
+  if (download.stale.data) {
+    if (!download.stale.metadata.etag.isEmpty())
+      request.setRawHeader("If-None-Match", download.stale.metadata.etag);
+    if (!download.stale.metadata.last_modified.isEmpty())
+      request.setRawHeader("If-Modified-Since", download.stale.metadata.last_modified);
+  }
+  if (m_transfer_timeout.count() > 0)
+    request.setTransferTimeout(int(m_transfer_timeout.count()));
+  request.setAttribute(QNetworkRequest::Http2AllowedAttribute, m_http2_allowed);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+  if (m_connections_per_host > 0) {
+    QHttp1Configuration http1_configuration;
+    http1_configuration.setNumberOfConnectionsPerHost(m_connections_per_host);
+    request.setHttp1Configuration(http1_configuration);
+  }
+#endif
+  QNetworkReply* reply = m_network_manager->get(request);
+  m_transfers[reply].requested = TransferMonitor::Clock::now();
+  m_statistics.n_downloads++;
+  connect(reply, &QNetworkReply::readyRead, this, [this, reply]() { receiveBytes(reply); });
+  connect(reply, &QNetworkReply::finished, this, [this, url, reply]() { receiveReply(url, reply); });
+  return reply;
+}
+
+void TileLoadService::receiveBytes(QNetworkReply* reply)
+{
+  // the bytes are taken while the transfer goes on, instead of copying the whole tile at the end
+  auto& transfer = m_transfers[reply];
+  if (!transfer.first_byte)
+    transfer.first_byte = TransferMonitor::Clock::now();
+  auto& body = transfer.body;
+  if (body.isEmpty()) {
+    const auto content_length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    if (content_length > 0)
+      body.reserve(qsizetype(content_length));
+  }
+  body += reply->readAll();
+}
+
+void TileLoadService::receiveReply(const QString& url, QNetworkReply* reply)
+{
+  reply->deleteLater();
+  auto transfer = m_transfers.take(reply);
+  if (!m_downloads.contains(url))
+    return;
+  auto& download = m_downloads[url];
+  const auto found = std::find(download.replies.begin(), download.replies.end(), reply);
+  if (found == download.replies.end())
+    return; // aborted after the other request of a hedged pair won
+  download.replies.erase(found);
+  const auto tile_id = download.tile_id;
+  const auto host = QUrl(url).host();
+  auto& circuit_breaker = circuitBreaker(url);
+  const auto was_closed = circuit_breaker.state() == CircuitBreaker::State::Closed;
+
+  if (reply->error() == QNetworkReply::NoError) {
+    circuit_breaker.recordSuccess(transfer.requested);
+    if (reply != download.original)
+      m_statistics.n_hedges_won++;
+    const auto finished = m_downloads.take(url);
+    for (auto* loser : finished.replies)
+      loser->abort();
+    // the probe closed the breaker
+    if (!was_closed && circuit_breaker.state() == CircuitBreaker::State::Closed)
+      resendPostponed(host);
+    const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).value<int>();
+    if (status == 304 && finished.stale.data) {
+      // not modified, only the freshness (and maybe the validators) changed
+      m_statistics.n_not_modified++;
+      if (m_disk_cache)
+        m_disk_cache->updateMetadataAsync(m_disk_cache_layer, tile_id, metadata(*reply, finished.stale.metadata));
+      if (!finished.background)
+        ready(tile_id, finished.stale.data);
+      return;
     }
-    reply->deleteLater();
-  });
+    transfer.body += reply->readAll();
+    auto tile = std::make_shared<QByteArray>(std::move(transfer.body));
+    const auto now = TransferMonitor::Clock::now();
+    m_transfer_monitor.add(transfer.requested, transfer.first_byte.value_or(now), now, size_t(tile->size()));
+    emit transferEstimateUpdated(m_transfer_monitor.estimate(now));
+    if (m_disk_cache)
+      m_disk_cache->writeAsync(m_disk_cache_layer, tile_id, tile, metadata(*reply, {}));
+    if (!finished.background)
+      ready(tile_id, std::move(tile));
+    return;
+  }
+
+  const auto transient = isTransientError(*reply);
+  // a 404 is an answer of a working server
+  if (transient)
+    circuit_breaker.recordFailure(transfer.requested);
+  else
+    circuit_breaker.recordSuccess(transfer.requested);
+  if (!was_closed && circuit_breaker.state() == CircuitBreaker::State::Closed)
+    resendPostponed(host);
+  else
+    schedulePostponed(host); // after a failed probe
+  auto& failed = m_downloads[url]; // the resent downloads might have moved it
+  if (!failed.replies.empty())
+    return; // the other request of a hedged pair is still running
+  if (transient && failed.n_retries < m_retry_policy.max_retries) {
+    const auto backoff = m_retry_policy.backoff(failed.n_retries, QRandomGenerator::global()->generateDouble());
+    failed.n_retries++;
+    m_statistics.n_retries++;
+    QTimer::singleShot(backoff, this, [this, url]() {
+      if (m_downloads.contains(url))
+        send(url);
+    });
+    return;
+  }
+  qDebug() << "Loading of tile " << url << " failed: " << reply->error();
+  if (transient) {
+    postpone(url);
+    return;
+  }
+  m_statistics.n_failed_downloads++;
+  fail(url);
 }
 
-QString TileLoadService::build_tile_url(const srs::TileId& tile_id) const
+void TileLoadService::fail(const QString& url)
 {
-  QString tile_address;
-  const auto n_y_tiles = srs::number_of_vertical_tiles_for_zoom_level(tile_id.zoom_level);
-  switch (m_url_pattern) {
-  case UrlPattern::ZXY:
-    tile_address = QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
-    break;
-  case UrlPattern::ZYX:
-    tile_address = QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
+  const auto download = m_downloads.take(url);
+  if (download.background)
+    return;
+  if (download.stale.data) {
+    m_statistics.n_stale_if_error++;
+    ready(download.tile_id, download.stale.data, true);
+    return;
+  }
+  deliverUnavailable(download.tile_id);
+}
+
+void TileLoadService::postpone(const QString& url)
+{
+  const auto& download = m_downloads[url];
+  if (!m_wait_for_failing_hosts || download.background || download.stale.data) {
+    fail(url);
+    return;
+  }
+  m_statistics.n_postponed_downloads++;
+  const auto host = QUrl(url).host();
+  m_postponed[host].urls.push_back(url);
+  schedulePostponed(host);
+}
+
+void TileLoadService::schedulePostponed(const QString& host)
+{
+  if (!m_postponed.contains(host) || m_postponed[host].resend_scheduled)
+    return;
+  const auto& circuit_breaker = m_circuit_breakers[host];
+  auto delay = CircuitBreaker::Clock::duration::zero();
+  switch (circuit_breaker.state()) {
+  case CircuitBreaker::State::Closed:
+    // the host answers, but these tiles failed anyway
+    delay = circuit_breaker.openDuration();
     break;
-  case UrlPattern::ZXY_yPointingSouth:
-    tile_address = QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
+  case CircuitBreaker::State::Open:
+    delay = circuit_breaker.timeUntilHalfOpen();
     break;
-  case UrlPattern::ZYX_yPointingSouth:
-    tile_address = QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
+  case CircuitBreaker::State::HalfOpen:
+    if (circuit_breaker.probeInFlight())
+      return; // its answer decides
     break;
   }
-  return m_base_url + tile_address + m_file_ending;
+  m_postponed[host].resend_scheduled = true;
+  const auto delay_in_ms = std::chrono::ceil<std::chrono::milliseconds>(delay);
+  QTimer::singleShot(delay_in_ms, this, [this, host]() { resendPostponed(host); });
+}
+
+void TileLoadService::resendPostponed(const QString& host)
+{
+  // the first one is the probe of a half open breaker, the others are short circuited and postponed again
+  const auto postponed = m_postponed.take(host);
+  for (const auto& url : postponed.urls) {
+    if (!m_downloads.contains(url))
+      continue;
+    m_downloads[url].n_retries = 0;
+    send(url);
+  }
+}
+
+TileDiskCache::Metadata TileLoadService::metadata(const QNetworkReply& reply, const TileDiskCache::Metadata& previous) const
+{
+  auto metadata = previous;
+  if (reply.hasRawHeader("ETag"))
+    metadata.etag = reply.rawHeader("ETag");
+  if (reply.hasRawHeader("Last-Modified"))
+    metadata.last_modified = reply.rawHeader("Last-Modified");
+  const auto default_lifetime = std::chrono::duration_cast<std::chrono::milliseconds>(m_default_freshness_lifetime).count();
+  metadata.fresh_until = QDateTime::currentMSecsSinceEpoch() + maxAgeInMs(reply.rawHeader("Cache-Control")).value_or(default_lifetime);
+  return metadata;
+}
+
+CircuitBreaker& TileLoadService::circuitBreaker(const QString& url)
+{
+  const auto host = QUrl(url).host();
+  if (!m_circuit_breakers.contains(host))
+    m_circuit_breakers.insert(host, m_circuit_breaker_prototype);
+  return m_circuit_breakers[host];
+}
+
+QString TileLoadService::build_tile_url(const srs::TileId& tile_id) const
+{
+  return m_url_template.url(tile_id);
+}
+
+void TileLoadService::ready(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, bool queued)
+{
+  if (m_decode_on_arrival) {
+    m_decoder->decode(tile_id, std::move(data));
+    return;
+  }
+  if (queued)
+    deliver(tile_id, std::move(data));
+  else
+    emit loadReady(tile_id, std::move(data));
+}
+
+void TileLoadService::receiveDecodedTile(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  if (image.isNull()) {
+    emit loadReady(tile_id, data);
+    return;
+  }
+  m_statistics.n_decoded_on_arrival++;
+  emit imageReady(tile_id, data, image);
 }
@@ -18,34 +18,170 @@
 
 #pragma once
 
-#include <QObject>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <QHash>
+#include <QNetworkRequest>
 #include "alpine_renderer/srs.h"
+#include "alpine_renderer/TileDiskCache.h"
+#include "alpine_renderer/TileSource.h"
+#include "alpine_renderer/tile_source/CircuitBreaker.h"
+#include "alpine_renderer/tile_source/RetryPolicy.h"
+#include "alpine_renderer/tile_source/TileDecoder.h"
+#include "alpine_renderer/tile_source/TransferMonitor.h"
+#include "alpine_renderer/tile_source/TileUrlTemplate.h"
 
 class QNetworkAccessManager;
+class QNetworkReply;
 
-class TileLoadService : public QObject
+// http tile source
+class TileLoadService : public TileSource
 {
   Q_OBJECT
 public:
-  enum class UrlPattern {
-    ZXY, ZYX,                              // y=0 is southern most tile
-    ZXY_yPointingSouth, ZYX_yPointingSouth // y=0 is the northern most tile
+  struct Statistics {
+    size_t n_downloads = 0; // GET requests sent, including retries and hedged requests
+    // requests for a tile, that was being read from the disk cache or downloaded already. they are answered by the running one.
+    size_t n_coalesced_requests = 0;
+    size_t n_retries = 0;
+    size_t n_hedged_requests = 0;
+    size_t n_hedges_won = 0; // the hedged request arrived before the original one
+    size_t n_short_circuited_requests = 0; // not sent, because the circuit breaker of the host was open
+    size_t n_postponed_downloads = 0; // short circuited, or failed with transient errors after the last retry. they wait for the host.
+    size_t n_failed_downloads = 0; // reported unavailable after the last attempt failed
+    size_t n_revalidations = 0; // downloads of stale tiles from the disk cache, conditional if the cache has validators
+    size_t n_not_modified = 0; // revalidations answered with 304
+    size_t n_stale_hits = 0; // stale tiles delivered, while they were revalidated in the background
+    size_t n_stale_if_error = 0; // stale tiles delivered, because the revalidation failed
+    size_t n_decoded_on_arrival = 0; // delivered through imageReady
   };
+
+  // with an empty base url, nothing is downloaded (tiles, that are not in the disk cache, are unavailable)
   TileLoadService(const QString& base_url, UrlPattern url_pattern, const QString& file_ending);
+  // same for an invalid template. with {s}, the tiles are spread over several hosts (sharding).
+  explicit TileLoadService(const TileUrlTemplate& url_template);
   ~TileLoadService() override;
   [[nodiscard]] QString build_tile_url(const srs::TileId& tile_id) const;
+  [[nodiscard]] const TileUrlTemplate& urlTemplate() const { return m_url_template; }
+  // tiles are looked up in the disk cache (in its io thread) before they are downloaded, downloaded tiles are written to it.
+  // the cache can be shared between several services, the layer has to be unique for each of them.
+  void setDiskCache(std::shared_ptr<TileDiskCache> disk_cache, const QString& layer);
+  [[nodiscard]] const std::shared_ptr<TileDiskCache>& diskCache() const { return m_disk_cache; }
+  // downloaded tiles are fresh for the max-age of their cache-control header, or for this long, if there is none.
+  // stale tiles from the disk cache are revalidated with the server (if-none-match / if-modified-since), a 304 only refreshes them.
+  void setDefaultFreshnessLifetime(std::chrono::seconds lifetime) { m_default_freshness_lifetime = lifetime; }
+  [[nodiscard]] std::chrono::seconds defaultFreshnessLifetime() const { return m_default_freshness_lifetime; }
+  // stale tiles are delivered at once and revalidated in the background (on by default), a changed tile is used on the next load.
+  // otherwise the revalidation is waited for. if it fails, the stale tile is delivered anyway.
+  void setStaleWhileRevalidate(bool enabled) { m_stale_while_revalidate = enabled; }
+  [[nodiscard]] bool staleWhileRevalidate() const { return m_stale_while_revalidate; }
+  // tiles are decoded in a worker thread as soon as they are there (while other tiles are still downloading), and delivered
+  // through imageReady instead of loadReady (off by default). tiles, that can't be decoded, still come through loadReady.
+  void setDecodeOnArrival(bool enabled);
+  [[nodiscard]] bool decodeOnArrival() const { return m_decode_on_arrival; }
+  // server errors (5xx), timeouts and lost connections are retried, other errors (e.g., 404) are not
+  void setRetryPolicy(const RetryPolicy& retry_policy) { m_retry_policy = retry_policy; }
+  [[nodiscard]] const RetryPolicy& retryPolicy() const { return m_retry_policy; }
+  // transfers, that stall for longer, fail with a timeout. 0 keeps the default of qt.
+  void setTransferTimeout(std::chrono::milliseconds transfer_timeout) { m_transfer_timeout = transfer_timeout; }
+  // a second request for the same tile is sent, if the first one is not answered within the delay. the later one is aborted. 0 disables hedging.
+  void setHedgeDelay(std::chrono::milliseconds hedge_delay) { m_hedge_delay = hedge_delay; }
+  [[nodiscard]] std::chrono::milliseconds hedgeDelay() const { return m_hedge_delay; }
+  // http/2 multiplexes all requests to a host over one connection. qt negotiates it for https only. allowed by default.
+  void setHttp2Allowed(bool allowed) { m_http2_allowed = allowed; }
+  [[nodiscard]] bool http2Allowed() const { return m_http2_allowed; }
+  // parallel http/1.1 connections to each host, 0 keeps the default of qt (6). needs qt 6.5, ignored before.
+  void setConnectionsPerHost(unsigned n_connections) { m_connections_per_host = n_connections; }
+  [[nodiscard]] unsigned connectionsPerHost() const { return m_connections_per_host; }
+  // one breaker per host. resets the breakers.
+  void setCircuitBreakerPolicy(unsigned failure_threshold, CircuitBreaker::Clock::duration open_duration);
+  [[nodiscard]] CircuitBreaker::State circuitBreakerState(const QString& host) const;
+  // short circuited tiles, and tiles that failed with transient errors after the last retry, are not reported unavailable (on by default).
+  // they are sent again, once the breaker of their host is half open (the first one is the probe, the others wait for its answer),
+  // or after the open duration, if the breaker is closed. otherwise they are reported unavailable at once.
+  void setWaitForFailingHosts(bool enabled) { m_wait_for_failing_hosts = enabled; }
+  [[nodiscard]] bool waitForFailingHosts() const { return m_wait_for_failing_hosts; }
+  // including the ones waiting for a retry or for their host
+  [[nodiscard]] size_t numberOfDownloadsInFlight() const { return size_t(m_downloads.size()); }
+  [[nodiscard]] const Statistics& statistics() const { return m_statistics; }
+  // throughput and latency of the downloads (not the disk cache hits) within a sliding window, see TransferMonitor
+  [[nodiscard]] TransferEstimate transferEstimate() const { return m_transfer_monitor.estimate(); }
+  [[nodiscard]] TransferMonitor& transferMonitor() { return m_transfer_monitor; }
 
 public slots:
-  void load(const srs::TileId& tile_id);
+  void load(const srs::TileId& tile_id) override;
+  // at low network priority
+  void prefetch(const srs::TileId& tile_id) override;
 
 signals:
-  void loadReady(srs::TileId tile_id, std::shared_ptr<QByteArray> data);
-  void tileUnavailable(srs::TileId tile_id);
+  // after every download, e.g., for AdaptiveLodController::setTransferEstimate (TileScheduler::updateTransferEstimate)
+  void transferEstimateUpdated(const TransferEstimate& estimate);
 
 private:
+  void request(const srs::TileId& tile_id, QNetworkRequest::Priority priority);
+  struct Download {
+    srs::TileId tile_id;
+    QNetworkRequest::Priority priority = QNetworkRequest::NormalPriority;
+    unsigned n_retries = 0;
+    std::vector<QNetworkReply*> replies; // two, if the request is hedged
+    QNetworkReply* original = nullptr;
+    TileDiskCache::CachedTile stale; // the tile is revalidated, if there is data
+    bool background = false; // the stale tile was delivered already, the result only goes to the disk cache
+  };
+  void download(const srs::TileId& tile_id, QNetworkRequest::Priority priority, const TileDiskCache::CachedTile& stale = {}, bool background = false);
+  void send(const QString& url);
+  void hedge(const QString& url, unsigned n_retries);
+  QNetworkReply* get(const QString& url, const Download& download);
+  struct Transfer {
+    QByteArray body; // read so far, sized by the content length
+    TransferMonitor::Clock::time_point requested;
+    std::optional<TransferMonitor::Clock::time_point> first_byte;
+  };
+  // appends the bytes, that arrived, to the body of the reply
+  void receiveBytes(QNetworkReply* reply);
+  void receiveReply(const QString& url, QNetworkReply* reply);
+  // after the last attempt
+  void fail(const QString& url);
+  // the download waits for its host, unless there is a stale tile for stale-if-error (or waiting for failing hosts is off)
+  void postpone(const QString& url);
+  void schedulePostponed(const QString& host);
+  void resendPostponed(const QString& host);
+  [[nodiscard]] TileDiskCache::Metadata metadata(const QNetworkReply& reply, const TileDiskCache::Metadata& previous) const;
+  CircuitBreaker& circuitBreaker(const QString& url);
+  void receiveFromDiskCache(const QString& layer, const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, const TileDiskCache::Metadata& metadata);
+  // loadReady, or imageReady after decoding it with decode on arrival. queued emits loadReady in the next event loop turn.
+  void ready(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data, bool queued = false);
+  void receiveDecodedTile(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image);
+
   std::shared_ptr<QNetworkAccessManager> m_network_manager;
-  QString m_base_url;
-  UrlPattern m_url_pattern;
-  QString m_file_ending;
+  TileUrlTemplate m_url_template;
+  std::shared_ptr<TileDiskCache> m_disk_cache;
+  QString m_disk_cache_layer;
+  std::unordered_map<srs::TileId, QNetworkRequest::Priority, srs::TileId::Hasher> m_disk_cache_reads; // priority for the download on a miss
+  std::chrono::seconds m_default_freshness_lifetime = std::chrono::hours(24 * 7);
+  bool m_stale_while_revalidate = true;
+  QHash<QString, Download> m_downloads; // by url, there is at most one download per tile
+  QHash<QNetworkReply*, Transfer> m_transfers;
+  TransferMonitor m_transfer_monitor;
+  bool m_decode_on_arrival = false;
+  std::unique_ptr<TileDecoder> m_decoder; // created, once decode on arrival is enabled
+  RetryPolicy m_retry_policy;
+  std::chrono::milliseconds m_transfer_timeout = std::chrono::milliseconds(0);
+  std::chrono::milliseconds m_hedge_delay = std::chrono::milliseconds(0);
+  bool m_http2_allowed = true;
+  unsigned m_connections_per_host = 0;
+  CircuitBreaker m_circuit_breaker_prototype;
+  QHash<QString, CircuitBreaker> m_circuit_breakers; // by host
+  bool m_wait_for_failing_hosts = true;
+  struct Postponed {
+    std::vector<QString> urls; // in the order they were postponed
+    bool resend_scheduled = false;
+  };
+  QHash<QString, Postponed> m_postponed; // by host
+  Statistics m_statistics;
 };
 
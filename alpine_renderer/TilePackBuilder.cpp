@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TilePackBuilder.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QDir>
+#include <QTimer>
+
+#include "alpine_renderer/TileArchive.h"
+#include "alpine_renderer/TileDiskCache.h"
+
+TilePackBuilder::TilePackBuilder(std::vector<Source> sources, const QString& staging_directory, unsigned max_concurrent_downloads)
+    : m_sources(std::move(sources)),
+      m_staging(std::make_shared<TileDiskCache>(staging_directory, std::numeric_limits<size_t>::max())),
+      m_max_concurrent_downloads(std::max(max_concurrent_downloads, 1u))
+{
+  for (size_t i = 0; i < m_sources.size(); ++i) {
+    const auto& source = m_sources[i];
+    auto service = std::make_unique<TileLoadService>(source.base_url, source.url_pattern, source.file_ending);
+    // a tile, that fails, is left for the next run, instead of waiting for the host
+    service->setWaitForFailingHosts(false);
+    connect(service.get(), &TileLoadService::loadReady, this, [this, i](srs::TileId tile_id, std::shared_ptr<QByteArray> data) { receiveTile(i, tile_id, data); });
+    connect(service.get(), &TileLoadService::tileUnavailable, this, [this, i](srs::TileId tile_id) { notifyAboutUnavailableTile(i, tile_id); });
+    m_services.push_back(std::move(service));
+  }
+}
+
+TilePackBuilder::~TilePackBuilder() = default;
+
+std::vector<srs::TileId> TilePackBuilder::tilesInRegion(const srs::Bounds& bounds, unsigned min_zoom_level, unsigned max_zoom_level)
+{
+  std::vector<srs::TileId> tiles;
+  for (auto zoom_level = min_zoom_level; zoom_level <= max_zoom_level; ++zoom_level) {
+    const auto level_tiles = srs::tiles_overlapping(bounds, zoom_level);
+    tiles.insert(tiles.end(), level_tiles.begin(), level_tiles.end());
+  }
+  return tiles;
+}
+
+void TilePackBuilder::download(const std::vector<srs::TileId>& tiles)
+{
+  m_progress = {};
+  m_queue.clear();
+  for (size_t i = 0; i < m_sources.size(); ++i) {
+    for (const auto& tile_id : tiles) {
+      m_progress.n_requested++;
+      if (m_staging->contains(m_sources[i].name, tile_id))
+        m_progress.n_staged_before++;
+      else
+        m_queue.push_back({i, tile_id});
+    }
+  }
+  emit progressChanged(m_progress);
+  if (m_queue.empty()) {
+    // after returning, like when something was downloaded
+    QTimer::singleShot(0, this, [this]() { emit downloadsFinished(m_progress); });
+    return;
+  }
+  startDownloads();
+}
+
+bool TilePackBuilder::pack(const std::vector<srs::TileId>& tiles, const QString& output_directory) const
+{
+  QDir().mkpath(output_directory);
+  for (const auto& source : m_sources) {
+    TileArchiveWriter writer(QDir(output_directory).filePath(source.name + ".atb"));
+    for (const auto& tile_id : tiles) {
+      const auto data = m_staging->read(source.name, tile_id);
+      if (data && !writer.add(tile_id, *data))
+        return false;
+    }
+    if (!writer.finish())
+      return false;
+  }
+  return true;
+}
+
+void TilePackBuilder::startDownloads()
+{
+  while (m_in_flight < m_max_concurrent_downloads && !m_queue.empty()) {
+    const auto download = m_queue.front();
+    m_queue.pop_front();
+    m_in_flight++;
+    m_max_observed_in_flight = std::max(m_max_observed_in_flight, m_in_flight);
+    m_services[download.source]->load(download.tile_id);
+  }
+}
+
+void TilePackBuilder::receiveTile(size_t source, const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data)
+{
+  // synchronous, so that the tile is staged when the download counts as done
+  if (m_staging->write(m_sources[source].name, tile_id, *data))
+    m_progress.n_downloaded++;
+  else
+    m_progress.n_failed_writes++;
+  finishDownload();
+}
+
+void TilePackBuilder::notifyAboutUnavailableTile(size_t, const srs::TileId&)
+{
+  // not staged, the next run tries again
+  m_progress.n_unavailable++;
+  finishDownload();
+}
+
+void TilePackBuilder::finishDownload()
+{
+  m_in_flight--;
+  emit progressChanged(m_progress);
+  if (m_in_flight == 0 && m_queue.empty()) {
+    emit downloadsFinished(m_progress);
+    return;
+  }
+  startDownloads();
+}
@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+
+#include "alpine_renderer/TileLoadService.h"
+#include "alpine_renderer/srs.h"
+
+class TileDiskCache;
+
+// downloads the tiles of a region from one or more sources and packs them into one TileArchive per source.
+// downloaded tiles are kept in a staging directory (a TileDiskCache without budget), tiles that are staged already
+// are not downloaded again, so that an interrupted build can be resumed.
+class TilePackBuilder : public QObject
+{
+  Q_OBJECT
+public:
+  struct Source {
+    QString name; // layer in the staging directory and name of the archive (<name>.atb)
+    QString base_url;
+    TileLoadService::UrlPattern url_pattern = TileLoadService::UrlPattern::ZXY;
+    QString file_ending;
+  };
+  // counted per tile and source
+  struct Progress {
+    size_t n_requested = 0;
+    size_t n_staged_before = 0; // from an earlier, interrupted build
+    size_t n_downloaded = 0;
+    size_t n_unavailable = 0;
+    size_t n_failed_writes = 0; // downloaded, but not staged. like unavailable tiles, they are retried by the next run.
+    [[nodiscard]] size_t nDone() const { return n_staged_before + n_downloaded + n_unavailable + n_failed_writes; }
+    [[nodiscard]] bool complete() const { return n_unavailable == 0 && n_failed_writes == 0; }
+  };
+
+  TilePackBuilder(std::vector<Source> sources, const QString& staging_directory, unsigned max_concurrent_downloads = 16);
+  ~TilePackBuilder() override;
+
+  // the tiles overlapping the bounds on all zoom levels in [min_zoom_level, max_zoom_level]
+  [[nodiscard]] static std::vector<srs::TileId> tilesInRegion(const srs::Bounds& bounds, unsigned min_zoom_level, unsigned max_zoom_level);
+
+  // downloads the tiles, that are not staged yet. downloadsFinished is emitted when all of them arrived or are unavailable.
+  void download(const std::vector<srs::TileId>& tiles);
+  // writes the staged tiles into <output_directory>/<source name>.atb. tiles, that are not staged (unavailable), are left out.
+  // false, if an archive couldn't be written completely.
+  bool pack(const std::vector<srs::TileId>& tiles, const QString& output_directory) const;
+
+  [[nodiscard]] const Progress& progress() const { return m_progress; }
+  [[nodiscard]] unsigned maxConcurrentDownloads() const { return m_max_concurrent_downloads; }
+  // the highest number of downloads, that were running at the same time
+  [[nodiscard]] unsigned maxObservedConcurrentDownloads() const { return m_max_observed_in_flight; }
+
+signals:
+  void progressChanged(const TilePackBuilder::Progress& progress);
+  void downloadsFinished(const TilePackBuilder::Progress& progress);
+
+private:
+  struct Download {
+    size_t source;
+    srs::TileId tile_id;
+  };
+  void startDownloads();
+  void receiveTile(size_t source, const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data);
+  void notifyAboutUnavailableTile(size_t source, const srs::TileId& tile_id);
+  void finishDownload();
+
+  std::vector<Source> m_sources;
+  std::vector<std::unique_ptr<TileLoadService>> m_services;
+  std::shared_ptr<TileDiskCache> m_staging;
+  std::deque<Download> m_queue;
+  unsigned m_max_concurrent_downloads;
+  unsigned m_in_flight = 0;
+  unsigned m_max_observed_in_flight = 0;
+  Progress m_progress;
+};
@@ -0,0 +1,435 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/TileScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/tile_scheduler/utils.h"
+#include "alpine_renderer/utils/tile_conversion.h"
+
+TileScheduler::TileScheduler()
+{
+  m_idle_timer.setSingleShot(true);
+  connect(&m_idle_timer, &QTimer::timeout, this, &TileScheduler::prefetchIdleRing);
+  m_settle_timer.setSingleShot(true);
+  connect(&m_settle_timer, &QTimer::timeout, this, &TileScheduler::settle);
+  m_refinement_timer.setSingleShot(true);
+  connect(&m_refinement_timer, &QTimer::timeout, this, &TileScheduler::continueRefinement);
+  m_statistics_timer.setSingleShot(true);
+  m_statistics_timer.setInterval(50);
+  connect(&m_statistics_timer, &QTimer::timeout, this, &TileScheduler::updateStatistics);
+  connect(this, &TileScheduler::tileRequested, this, &TileScheduler::scheduleStatisticsUpdate);
+  connect(this, &TileScheduler::tileReady, this, &TileScheduler::scheduleStatisticsUpdate);
+  connect(this, &TileScheduler::tileExpired, this, &TileScheduler::scheduleStatisticsUpdate);
+  m_delta_timer.setSingleShot(true);
+  m_delta_timer.setInterval(0);
+  connect(&m_delta_timer, &QTimer::timeout, this, &TileScheduler::emitDelta);
+  connect(this, &TileScheduler::tileRequested, this, &TileScheduler::addRequestedToDelta);
+  connect(this, &TileScheduler::tileReady, this, &TileScheduler::addReadyToDelta);
+  connect(this, &TileScheduler::tileExpired, this, &TileScheduler::addExpiredToDelta);
+}
+
+TileScheduler::Statistics TileScheduler::statistics() const
+{
+  Statistics statistics;
+  statistics.n_tiles_in_transit = numberOfTilesInTransit();
+  statistics.n_waiting_height_tiles = numberOfWaitingHeightTiles();
+  statistics.n_waiting_ortho_tiles = numberOfWaitingOrthoTiles();
+  statistics.n_gpu_tiles = m_gpu_memory.numberOfTiles();
+  statistics.gpu_residency = m_gpu_memory.residency();
+  statistics.lod = m_lod_controller.state();
+  statistics.enabled = enabled();
+  statistics.progressive = progressive();
+  return statistics;
+}
+
+void TileScheduler::postCamera(const Camera& camera)
+{
+  QMutexLocker locker(&m_posted_camera_mutex);
+  const auto delivery_pending = m_posted_camera.has_value();
+  m_posted_camera = camera;
+  if (!delivery_pending)
+    QMetaObject::invokeMethod(this, &TileScheduler::takePostedCamera, Qt::QueuedConnection);
+}
+
+void TileScheduler::takePostedCamera()
+{
+  std::optional<Camera> camera;
+  {
+    QMutexLocker locker(&m_posted_camera_mutex);
+    std::swap(camera, m_posted_camera);
+  }
+  if (camera)
+    updateCamera(*camera);
+}
+
+void TileScheduler::addFrameTime(AdaptiveLodController::Clock::duration frame_time)
+{
+  m_lod_controller.addFrameTime(frame_time);
+}
+
+void TileScheduler::updateTransferEstimate(unsigned layer, const TransferEstimate& estimate)
+{
+  m_lod_controller.setTransferEstimate(layer, estimate);
+}
+
+void TileScheduler::updateOrthoTransferEstimate(const TransferEstimate& estimate)
+{
+  updateTransferEstimate(TileLayerRegistry::ortho, estimate);
+}
+
+void TileScheduler::updateHeightTransferEstimate(const TransferEstimate& estimate)
+{
+  updateTransferEstimate(TileLayerRegistry::height, estimate);
+}
+
+void TileScheduler::updateStatistics()
+{
+  // the controller is updated while the camera rests as well, otherwise a coarsened lod would only relax with the next movement
+  if (m_lod_camera && enabled()) {
+    const auto threshold_scale = m_lod_policy->thresholdScale();
+    updateLodController(*m_lod_camera);
+    if (m_lod_policy->thresholdScale() != threshold_scale) {
+      m_lod_controller_updated = true;
+      updateCamera(*m_lod_camera);
+      m_lod_controller_updated = false;
+    }
+  }
+  emit statisticsUpdated(statistics());
+  // keeps ticking, until the lod is back at full detail
+  if (m_lod_controller.enabled() && m_lod_controller.state().threshold_scale > m_lod_controller.minThresholdScale())
+    scheduleStatisticsUpdate();
+}
+
+void TileScheduler::scheduleStatisticsUpdate()
+{
+  if (!m_statistics_timer.isActive())
+    m_statistics_timer.start();
+}
+
+void TileScheduler::addRequestedToDelta(const srs::TileId& tile_id)
+{
+  m_delta.requested.push_back(tile_id);
+  m_delta_timer.start();
+}
+
+void TileScheduler::addReadyToDelta(const std::shared_ptr<Tile>& tile)
+{
+  m_delta.ready.push_back(tile);
+  m_delta_timer.start();
+}
+
+void TileScheduler::addExpiredToDelta(const srs::TileId& tile_id)
+{
+  // shipped and expired within the same cycle: the consumer never has to know about it
+  const auto shipped = std::find_if(m_delta.ready.begin(), m_delta.ready.end(), [&tile_id](const auto& tile) { return tile->id == tile_id; });
+  if (shipped != m_delta.ready.end()) {
+    m_delta.ready.erase(shipped);
+    return;
+  }
+  m_delta.expired.push_back(tile_id);
+  m_delta_timer.start();
+}
+
+void TileScheduler::emitDelta()
+{
+  if (m_delta.empty())
+    return;
+  emit tileSetChanged(std::exchange(m_delta, {}));
+}
+
+srs::TileId TileScheduler::heightTileId(const srs::TileId& tile_id) const
+{
+  auto height_tile_id = tile_id;
+  for (unsigned i = 0; i < m_height_zoom_offset && height_tile_id.zoom_level > 0; ++i)
+    height_tile_id = srs::parent(height_tile_id);
+  return height_tile_id;
+}
+
+void TileScheduler::receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data)
+{
+  receiveTileLayer(tile_id, TileLayerRegistry::ortho, std::move(data));
+}
+
+void TileScheduler::receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data)
+{
+  receiveTileLayer(tile_id, TileLayerRegistry::height, std::move(data));
+}
+
+void TileScheduler::receiveDecodedOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image)
+{
+  receiveTileLayer(tile_id, TileLayerRegistry::ortho, std::move(data), std::move(image));
+}
+
+void TileScheduler::receiveDecodedHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image)
+{
+  receiveTileLayer(tile_id, TileLayerRegistry::height, std::move(data), std::move(image));
+}
+
+void TileScheduler::notifyAboutUnavailableOrthoTile(srs::TileId tile_id)
+{
+  notifyAboutUnavailableTileLayer(tile_id, TileLayerRegistry::ortho);
+}
+
+void TileScheduler::notifyAboutUnavailableHeightTile(srs::TileId tile_id)
+{
+  notifyAboutUnavailableTileLayer(tile_id, TileLayerRegistry::height);
+}
+
+bool TileScheduler::hasRequiredLayers(const srs::TileId& tile_id) const
+{
+  if (m_height_zoom_offset == 0)
+    return m_received_tiles.hasRequiredLayers(tile_id);
+  return m_received_tiles.hasRequiredLayers(tile_id, true) && m_shared_height_tiles.contains(heightTileId(tile_id));
+}
+
+std::shared_ptr<Tile> TileScheduler::takeTile(const srs::TileId& tile_id)
+{
+  assert(hasRequiredLayers(tile_id));
+  TileLayerBundles::Images images;
+  const auto bundle = m_received_tiles.take(tile_id, &images);
+  if (m_height_zoom_offset == 0) {
+    auto height_raster = tile_conversion::qImage2uint16Raster(TileLayerBundles::image(bundle, images, TileLayerRegistry::height));
+    return TileLayerBundles::makeTile(tile_id, std::move(height_raster), bundle, images);
+  }
+  const auto height_tile = m_shared_height_tiles.get(heightTileId(tile_id));
+  assert(height_tile);
+  const auto& height_map = height_tile->height_map;
+  auto height_raster = tile_conversion::resampleHeightRaster(height_map, height_tile->bounds, srs::tile_bounds(tile_id), height_map.width());
+  return TileLayerBundles::makeTile(tile_id, std::move(height_raster), bundle, images);
+}
+
+bool TileScheduler::receiveLateTileLayer(const srs::TileId& tile_id, TileLayerRegistry::LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  if (m_layers.isRequired(layer) || !m_tile_cache.contains(tile_id))
+    return false;
+  // a copy, the cache has to know the new size
+  const auto tile = std::make_shared<Tile>(*m_tile_cache.get(tile_id));
+  tile->layers[layer] = image.isNull() ? tile_conversion::toQImage(*data) : image;
+  m_tile_cache.insert(tile);
+  if (m_gpu_memory.bytesOf(tile_id) > 0)
+    emit tileLayerReady(tile_id, layer, tile->layers[layer]);
+  return true;
+}
+
+std::optional<srs::TileId> TileScheduler::requestSharedHeightTile(const srs::TileId& tile_id)
+{
+  if (m_height_zoom_offset == 0)
+    return {};
+  const auto height_tile_id = heightTileId(tile_id);
+  // get() marks it as recently used, so that it is still there when the ortho tile arrives
+  if (m_shared_height_tiles.get(height_tile_id) || !m_shared_height_tiles_in_transit.insert(height_tile_id).second)
+    return {};
+  return height_tile_id;
+}
+
+bool TileScheduler::receiveSharedHeightTile(const srs::TileId& height_tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  if (m_height_zoom_offset == 0)
+    return false;
+  m_shared_height_tiles_in_transit.erase(height_tile_id);
+  auto height_raster = tile_conversion::qImage2uint16Raster(image.isNull() ? tile_conversion::toQImage(*data) : image);
+  m_shared_height_tiles.insert(std::make_shared<Tile>(height_tile_id, srs::tile_bounds(height_tile_id), std::move(height_raster), QImage()));
+  return true;
+}
+
+bool TileScheduler::notifyAboutUnavailableSharedHeightTile(const srs::TileId& height_tile_id)
+{
+  if (m_height_zoom_offset == 0)
+    return false;
+  m_shared_height_tiles_in_transit.erase(height_tile_id);
+  return true;
+}
+
+std::vector<srs::TileId> TileScheduler::prefetchCandidates(const Camera& camera) const
+{
+  return tile_scheduler::visibleLeaves(camera, 1.0);
+}
+
+void TileScheduler::updatePrefetches(const Camera& camera)
+{
+  // the camera moved, the ring around the old view is not needed anymore
+  m_idle_camera = camera;
+  m_idle_ring.reset();
+  m_idle_ring_bytes = 0;
+  startIdleTimer();
+
+  const auto predicted_camera = m_prefetcher.update(camera);
+  if (!predicted_camera || !m_prefetcher.hasBudget() || m_height_zoom_offset > 0)
+    return;
+  std::vector<srs::TileId> prefetch_requests;
+  for (const auto& tile_id : prefetchCandidates(*predicted_camera)) {
+    if (!m_prefetcher.hasBudget())
+      break;
+    if (!needsPrefetch(tile_id))
+      continue;
+    m_prefetcher.request(tile_id);
+    prefetch_requests.push_back(tile_id);
+  }
+  for (const auto& tile_id : prefetch_requests)
+    emit tilePrefetchRequested(tile_id);
+}
+
+void TileScheduler::updateLodController(const Camera& camera)
+{
+  m_lod_camera = camera;
+  if (m_lod_controller_updated)
+    return; // by updateStatistics, right before it called updateCamera
+  m_lod_controller.update(m_gpu_memory.numberOfTiles(), numberOfTilesInTransit() * 2); // height and ortho
+  m_lod_policy->setThresholdScale(m_lod_controller.state().threshold_scale);
+  scheduleStatisticsUpdate();
+}
+
+bool TileScheduler::skipsLevels(const Camera& camera)
+{
+  if (m_lod_policy->levelSkip() <= 1)
+    return false;
+  // the update from settle(). the velocity is still the one from the last movement.
+  if (m_settled && m_settle_camera && m_settle_camera->position() == camera.position())
+    return false;
+  if (!m_lod_policy->isFastMovement(camera, m_prefetcher.cameraPredictor().velocity()))
+    return false;
+  m_settle_camera = camera;
+  m_settled = false;
+  m_settle_timer.start(int(std::chrono::duration_cast<std::chrono::milliseconds>(m_lod_policy->settleDelay()).count()));
+  return true;
+}
+
+void TileScheduler::settle()
+{
+  if (!m_settle_camera)
+    return;
+  m_settled = true;
+  updateCamera(*m_settle_camera);
+}
+
+void TileScheduler::startTimeSlicedRefinement(const Camera& camera, TimeSlicedRefinement::RefinePredicate refine)
+{
+  m_refinement_camera = camera;
+  m_refine = std::move(refine);
+  if (m_refinement.started() && !m_refinement.finished()) {
+    // the part of the tree that is left is refined for the new camera, the rest is redone afterwards
+    m_refinement.setCamera(camera);
+    m_restart_refinement = true;
+  } else {
+    m_refinement.start(camera, m_refine);
+    m_restart_refinement = false;
+  }
+  continueRefinement();
+}
+
+void TileScheduler::continueRefinement()
+{
+  if (!m_refinement.started() || m_refinement.finished())
+    return;
+  if (!m_refinement.run(TimeSlicedRefinement::Clock::now() + m_time_budget)) {
+    m_refinement_timer.start(0);
+    return;
+  }
+  // the upper part of the tree might have been refined for an older camera. use the result anyway (the camera keeps moving,
+  // waiting for an exact one could take forever), and refine again for the newest camera.
+  refinementFinished(*m_refinement_camera, m_refinement);
+  if (m_restart_refinement) {
+    m_restart_refinement = false;
+    m_refinement.start(*m_refinement_camera, m_refine);
+    m_refinement_timer.start(0);
+  }
+}
+
+bool TileScheduler::needsPrefetch(const srs::TileId& tile_id) const
+{
+  return !isScheduled(tile_id) && !m_prefetcher.isInFlight(tile_id) && !m_tile_cache.contains(tile_id) && !m_unavailable_tiles->contains(tile_id);
+}
+
+std::vector<srs::TileId> TileScheduler::idleRing(const Camera& camera) const
+{
+  const auto visible_tiles = prefetchCandidates(camera);
+  const auto camera_position = glm::dvec2(camera.position());
+  const auto distance = [&camera_position](const srs::TileId& tile_id) {
+    const auto bounds = srs::tile_bounds(tile_id);
+    return glm::length((bounds.min + bounds.max) * 0.5 - camera_position);
+  };
+
+  // the coarser versions of the visible tiles and their neighbours. one level coarser first, nearest first within a level.
+  std::vector<srs::TileId> ring;
+  TileSet ring_set;
+  for (unsigned levels = 1; levels <= m_prefetcher.idleRingLevels(); ++levels) {
+    std::vector<srs::TileId> level_ring;
+    for (const auto& tile_id : visible_tiles) {
+      if (tile_id.zoom_level < levels)
+        continue;
+      auto coarser_tile = tile_id;
+      for (unsigned i = 0; i < levels; ++i)
+        coarser_tile = srs::parent(coarser_tile);
+      if (ring_set.insert(coarser_tile).second)
+        level_ring.push_back(coarser_tile);
+      for (const auto& neighbour : srs::neighbours(coarser_tile)) {
+        if (ring_set.insert(neighbour).second)
+          level_ring.push_back(neighbour);
+      }
+    }
+    std::sort(level_ring.begin(), level_ring.end(), [&distance](const auto& a, const auto& b) { return distance(a) < distance(b); });
+    ring.insert(ring.end(), level_ring.begin(), level_ring.end());
+  }
+  return ring;
+}
+
+void TileScheduler::prefetchIdleRing()
+{
+  if (!m_prefetcher.idlePrefetchEnabled() || !m_idle_camera || !enabled() || m_height_zoom_offset > 0)
+    return;
+  // the visible tiles come first
+  if (numberOfTilesInTransit() > 0) {
+    startIdleTimer();
+    return;
+  }
+  if (!m_idle_ring) {
+    const auto ring = idleRing(*m_idle_camera);
+    m_idle_ring = std::deque<srs::TileId>(ring.begin(), ring.end());
+  }
+
+  // we don't know the size of a tile before it arrived, the cached tiles are a good guess
+  const auto tile_bytes = m_tile_cache.numberOfTiles() ? m_tile_cache.sizeInBytes() / m_tile_cache.numberOfTiles() : size_t(256 * 256 * (2 + 4));
+  std::vector<srs::TileId> prefetch_requests;
+  while (!m_idle_ring->empty() && m_prefetcher.hasBudget() && m_idle_ring_bytes + tile_bytes <= m_prefetcher.idleByteBudget()) {
+    const auto tile_id = m_idle_ring->front();
+    m_idle_ring->pop_front();
+    if (!needsPrefetch(tile_id))
+      continue;
+    m_prefetcher.request(tile_id);
+    m_idle_ring_bytes += tile_bytes;
+    prefetch_requests.push_back(tile_id);
+  }
+  for (const auto& tile_id : prefetch_requests)
+    emit tilePrefetchRequested(tile_id);
+
+  // continue, once the prefetches in flight made room
+  if (!m_idle_ring->empty() && m_idle_ring_bytes + tile_bytes <= m_prefetcher.idleByteBudget())
+    startIdleTimer();
+}
+
+void TileScheduler::startIdleTimer()
+{
+  if (!m_prefetcher.idlePrefetchEnabled())
+    return;
+  m_idle_timer.start(int(std::chrono::duration_cast<std::chrono::milliseconds>(m_prefetcher.idleDelay()).count()));
+}
@@ -18,13 +18,31 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
+#include <QImage>
+#include <QMutex>
 #include <QObject>
+#include <QTimer>
 
 #include "alpine_renderer/Camera.h"
+#include "alpine_renderer/Raster.h"
+#include "alpine_renderer/TileSetDelta.h"
 #include "alpine_renderer/srs.h"
+#include "alpine_renderer/tile_scheduler/AdaptiveLodController.h"
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+#include "alpine_renderer/tile_scheduler/TileLayers.h"
+#include "alpine_renderer/tile_scheduler/TilePrefetcher.h"
+#include "alpine_renderer/tile_scheduler/TimeSlicedRefinement.h"
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
 
 struct Tile;
 
@@ -34,28 +52,200 @@ class TileScheduler : public QObject
   Q_OBJECT
 public:
   using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
-  using Tile2DataMap = std::unordered_map<srs::TileId, std::shared_ptr<QByteArray>, srs::TileId::Hasher>;
-  TileScheduler() = default;
+  // snapshot of the scheduler state, e.g., for displaying it. unlike the getters, it can be used from other threads.
+  struct Statistics {
+    size_t n_tiles_in_transit = 0;
+    size_t n_waiting_height_tiles = 0;
+    size_t n_waiting_ortho_tiles = 0;
+    size_t n_gpu_tiles = 0;
+    GpuMemoryBudget::Residency gpu_residency;
+    AdaptiveLodController::State lod;
+    bool enabled = true;
+    bool progressive = false;
+  };
+  TileScheduler();
 
   [[nodiscard]] virtual size_t numberOfTilesInTransit() const = 0;
-  [[nodiscard]] virtual size_t numberOfWaitingHeightTiles() const = 0;
-  [[nodiscard]] virtual size_t numberOfWaitingOrthoTiles() const = 0;
+  // tiles in transit, for which the layer arrived already
+  [[nodiscard]] size_t numberOfWaitingTiles(TileLayerRegistry::LayerId layer) const { return m_received_tiles.numberOfTilesWith(layer); }
+  [[nodiscard]] size_t numberOfWaitingHeightTiles() const { return numberOfWaitingTiles(TileLayerRegistry::height); }
+  [[nodiscard]] size_t numberOfWaitingOrthoTiles() const { return numberOfWaitingTiles(TileLayerRegistry::ortho); }
   [[nodiscard]] virtual TileSet gpuTiles() const = 0;
+  [[nodiscard]] Statistics statistics() const;
 
   virtual bool enabled() const = 0;
   virtual void setEnabled(bool newEnabled) = 0;
 
+  // height and ortho, plus overlays. layers have to be added before the first tile is requested.
+  // every layer is loaded for every requested tile (tileRequested) and delivered through receiveTileLayer.
+  [[nodiscard]] TileLayerRegistry& layers() { return m_layers; }
+  [[nodiscard]] const TileLayerRegistry& layers() const { return m_layers; }
+  // decoded tiles are kept in here after they were shipped, requests for cached tiles are served without going to the network.
+  [[nodiscard]] TileCache& tileCache() { return m_tile_cache; }
+  [[nodiscard]] const TileCache& tileCache() const { return m_tile_cache; }
+  // tiles reported as unavailable (and their descendants) are not requested again until the entry expires.
+  // the cache can be shared between several schedulers.
+  [[nodiscard]] const std::shared_ptr<UnavailableTileCache>& unavailableTileCache() const { return m_unavailable_tiles; }
+  void setUnavailableTileCache(const std::shared_ptr<UnavailableTileCache>& cache) { assert(cache); m_unavailable_tiles = cache; }
+  // refine / coarsen thresholds and min residency time of tiles. the policy can be shared between several schedulers.
+  [[nodiscard]] const std::shared_ptr<LodPolicy>& lodPolicy() const { return m_lod_policy; }
+  void setLodPolicy(const std::shared_ptr<LodPolicy>& policy) { assert(policy); m_lod_policy = policy; }
+  // scales the thresholds of the lod policy depending on frame time, number of tiles and download throughput (disabled by default).
+  // the frame times have to be reported by the renderer.
+  [[nodiscard]] AdaptiveLodController& lodController() { return m_lod_controller; }
+  [[nodiscard]] const AdaptiveLodController& lodController() const { return m_lod_controller; }
+  // estimated gpu memory of the shipped tiles. when the budget would be exceeded, the schedulers coarsen the least important tiles.
+  [[nodiscard]] GpuMemoryBudget& gpuMemory() { return m_gpu_memory; }
+  [[nodiscard]] const GpuMemoryBudget& gpuMemory() const { return m_gpu_memory; }
+  // in progressive mode, coarser tiles stay on the gpu until the finer tiles covering them have arrived,
+  // and tiles are shipped as soon as their sibling group is complete (instead of waiting for all requested tiles).
+  [[nodiscard]] bool progressive() const { return m_progressive; }
+  void setProgressive(bool progressive) { m_progressive = progressive; }
+  // tiles for the camera extrapolated from the recent movement, and a ring of coarser tiles around the view when idle,
+  // are requested through tilePrefetchRequested (both disabled by default).
+  [[nodiscard]] TilePrefetcher& prefetcher() { return m_prefetcher; }
+  [[nodiscard]] const TilePrefetcher& prefetcher() const { return m_prefetcher; }
+  // height tiles are loaded this many levels coarser than the ortho tiles, and one height tile is used for several tiles.
+  // with an offset, tileRequested only refers to the ortho tile and the height tiles are requested through heightTileRequested.
+  // prefetching is not done with an offset. default is 0 (ortho and height on the same level).
+  [[nodiscard]] unsigned heightZoomOffset() const { return m_height_zoom_offset; }
+  void setHeightZoomOffset(unsigned offset) { m_height_zoom_offset = offset; }
+  // the height tile, that is used for the tile (an ancestor, if there is a height zoom offset)
+  [[nodiscard]] srs::TileId heightTileId(const srs::TileId& tile_id) const;
+  // maximum time updateCamera spends on traversing the tile tree, the rest is done in the following event loop turns
+  // (nearest tiles first, always for the newest camera). zero disables time slicing (default).
+  [[nodiscard]] std::chrono::microseconds timeBudget() const { return m_time_budget; }
+  void setTimeBudget(std::chrono::microseconds budget) { m_time_budget = budget; }
+
+  // thread safe. the scheduler can live in another thread than the renderer, the camera is then delivered in the scheduler's thread.
+  // cameras posted before the scheduler got to them are dropped, updateCamera is called only with the newest one.
+  void postCamera(const Camera& camera);
+
 public slots:
   virtual void updateCamera(const Camera& camera) = 0;
-  virtual void receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) = 0;
-  virtual void receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) = 0;
-  virtual void notifyAboutUnavailableOrthoTile(srs::TileId tile_id) = 0;
-  virtual void notifyAboutUnavailableHeightTile(srs::TileId tile_id) = 0;
+  // forwarded to the lod controller
+  void addFrameTime(AdaptiveLodController::Clock::duration frame_time);
+  // forwarded to the lod controller, one estimate per layer (e.g., from TileLoadService::transferEstimateUpdated).
+  // with the controller enabled, the lod gets coarser, when the tiles in transit can't be downloaded within its max download backlog.
+  void updateTransferEstimate(unsigned layer, const TransferEstimate& estimate);
+  void updateOrthoTransferEstimate(const TransferEstimate& estimate);
+  void updateHeightTransferEstimate(const TransferEstimate& estimate);
+  // the image is the decoded data, if the tile source decoded it on arrival (null otherwise, the scheduler decodes the data then)
+  virtual void receiveTileLayer(srs::TileId tile_id, unsigned layer, std::shared_ptr<QByteArray> data, QImage image = {}) = 0;
+  // a missing required layer makes the tile unavailable, a missing optional layer is ignored
+  virtual void notifyAboutUnavailableTileLayer(srs::TileId tile_id, unsigned layer) = 0;
+  void receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data);
+  void receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data);
+  // for TileSource::imageReady
+  void receiveDecodedOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image);
+  void receiveDecodedHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image);
+  void notifyAboutUnavailableOrthoTile(srs::TileId tile_id);
+  void notifyAboutUnavailableHeightTile(srs::TileId tile_id);
 
 signals:
   void tileRequested(const srs::TileId& tile_id);
+  // only with a height zoom offset
+  void heightTileRequested(const srs::TileId& height_tile_id);
+  // should be loaded at low priority. the data is delivered through the same slots as for tileRequested.
+  void tilePrefetchRequested(const srs::TileId& tile_id);
   void tileReady(const std::shared_ptr<Tile>& tile);
+  // an optional layer, that arrived after its tile was shipped
+  void tileLayerReady(const srs::TileId& tile_id, unsigned layer, const QImage& image);
   void tileExpired(const srs::TileId& tile_id);
   void cancelTileRequest(const srs::TileId& tile_id);
+  // tileRequested, tileReady and tileExpired batched into one signal, emitted once the current update / shipping cycle is done.
+  // cheaper than the single tile signals over queued connections.
+  void tileSetChanged(const TileSetDelta& delta);
+  // emitted (at most every 50ms), when tiles were requested, shipped or expired and when the camera changed.
+  // every 50ms, while the adaptive lod controller has coarsened the lod.
+  void statisticsUpdated(const TileScheduler::Statistics& statistics);
+
+protected:
+  // true for tiles, that are on the gpu, in transit or waiting to be shipped
+  [[nodiscard]] virtual bool isScheduled(const srs::TileId& tile_id) const = 0;
+  // the tiles, the scheduler would want for the camera (only the visible ones)
+  [[nodiscard]] virtual std::vector<srs::TileId> prefetchCandidates(const Camera& camera) const;
+  // to be called at the end of updateCamera. requests the tiles of the predicted camera and restarts waiting for idle time.
+  void updatePrefetches(const Camera& camera);
+  // to be called at the beginning of updateCamera. updates the controller and applies its threshold scale to the lod policy.
+  // also schedules a statisticsUpdated. the controller is updated with it while the camera rests, and if the threshold scale
+  // changes, updateCamera is called again with the last camera.
+  void updateLodController(const Camera& camera);
+  // true, if the camera moves fast and the lod policy skips levels. restarts waiting for the camera to settle, then updateCamera
+  // is called again with the last camera (and without skipping levels) to fill in the skipped levels.
+  [[nodiscard]] bool skipsLevels(const Camera& camera);
+  // true, if all required layers of the tile are in m_received_tiles. with a height zoom offset, the height comes from the shared height tile.
+  [[nodiscard]] bool hasRequiredLayers(const srs::TileId& tile_id) const;
+  // decodes the received layers of the tile (and cuts the height out of the shared height tile). the received data is erased.
+  [[nodiscard]] std::shared_ptr<Tile> takeTile(const srs::TileId& tile_id);
+  // optional layers of tiles, that were shipped already, are put into the cached tile and emitted through tileLayerReady.
+  // returns false, if the layer is required or the tile is not in the cache (it's still to be built then).
+  bool receiveLateTileLayer(const srs::TileId& tile_id, TileLayerRegistry::LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image = {});
+  // with a height zoom offset: returns the id of the shared height tile, if it needs to be requested (it's marked as in transit then)
+  [[nodiscard]] std::optional<srs::TileId> requestSharedHeightTile(const srs::TileId& tile_id);
+  // with a height zoom offset: decodes and keeps the shared height tile and returns true. returns false without offset.
+  bool receiveSharedHeightTile(const srs::TileId& height_tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image = {});
+  // with a height zoom offset: returns true, the tiles using the height tile have to be marked unavailable by the caller
+  bool notifyAboutUnavailableSharedHeightTile(const srs::TileId& height_tile_id);
+  // runs the refinement for at most timeBudget() now and continues in the next event loop turns.
+  // if a refinement is still running, it continues with the new camera and is restarted once finished.
+  void startTimeSlicedRefinement(const Camera& camera, TimeSlicedRefinement::RefinePredicate refine);
+  // called once a time sliced refinement is finished, with the newest camera
+  virtual void refinementFinished(const Camera& camera, const TimeSlicedRefinement& refinement) = 0;
+
+  TileLayerRegistry m_layers;
+  TileLayerBundles m_received_tiles { &m_layers };
+  TileCache m_tile_cache;
+  std::shared_ptr<UnavailableTileCache> m_unavailable_tiles = std::make_shared<UnavailableTileCache>();
+  std::shared_ptr<LodPolicy> m_lod_policy = std::make_shared<LodPolicy>();
+  AdaptiveLodController m_lod_controller;
+  GpuMemoryBudget m_gpu_memory;
+  TilePrefetcher m_prefetcher { &m_tile_cache, &m_layers };
+  bool m_progressive = false;
+  std::chrono::microseconds m_time_budget = std::chrono::microseconds::zero();
+  unsigned m_height_zoom_offset = 0;
+  TileCache m_shared_height_tiles { 64 * 1024 * 1024 }; // tiles without ortho texture
+  TileSet m_shared_height_tiles_in_transit;
+
+private:
+  [[nodiscard]] bool needsPrefetch(const srs::TileId& tile_id) const;
+  [[nodiscard]] std::vector<srs::TileId> idleRing(const Camera& camera) const;
+  void prefetchIdleRing();
+  void startIdleTimer();
+  void continueRefinement();
+  void settle();
+  void takePostedCamera();
+  void updateStatistics();
+  void scheduleStatisticsUpdate();
+  void addRequestedToDelta(const srs::TileId& tile_id);
+  void addReadyToDelta(const std::shared_ptr<Tile>& tile);
+  void addExpiredToDelta(const srs::TileId& tile_id);
+  void emitDelta();
+
+  // all timers are children, so that they move to the scheduler's thread with it
+  QTimer m_idle_timer { this };
+  std::optional<Camera> m_idle_camera;
+  std::optional<std::deque<srs::TileId>> m_idle_ring; // not planned yet, if empty
+  size_t m_idle_ring_bytes = 0;
+
+  QTimer m_settle_timer { this };
+  std::optional<Camera> m_settle_camera;
+  bool m_settled = false;
+
+  QTimer m_refinement_timer { this };
+  TimeSlicedRefinement m_refinement;
+  TimeSlicedRefinement::RefinePredicate m_refine;
+  std::optional<Camera> m_refinement_camera;
+  bool m_restart_refinement = false;
+
+  QTimer m_statistics_timer { this };
+  std::optional<Camera> m_lod_camera; // the last camera of updateCamera
+  bool m_lod_controller_updated = false;
+
+  QTimer m_delta_timer { this };
+  TileSetDelta m_delta;
+
+  QMutex m_posted_camera_mutex;
+  std::optional<Camera> m_posted_camera; // guarded by m_posted_camera_mutex
 };
 
@@ -0,0 +1,37 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "alpine_renderer/srs.h"
+
+struct Tile;
+
+// everything that happened to the tile set during one update / shipping cycle of a scheduler.
+// one queued signal per cycle instead of one per tile, when the scheduler runs in another thread.
+// consumers apply expired before ready (a tile can expire and be shipped again within one delta).
+struct TileSetDelta {
+  std::vector<srs::TileId> requested;
+  std::vector<std::shared_ptr<Tile>> ready;
+  std::vector<srs::TileId> expired;
+
+  [[nodiscard]] bool empty() const { return requested.empty() && ready.empty() && expired.empty(); }
+};
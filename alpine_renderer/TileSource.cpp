@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileSource.h"
+
+QString TileSource::tileAddress(const srs::TileId& tile_id, UrlPattern url_pattern)
+{
+  const auto n_y_tiles = srs::number_of_vertical_tiles_for_zoom_level(tile_id.zoom_level);
+  switch (url_pattern) {
+  case UrlPattern::ZXY:
+    return QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
+  case UrlPattern::ZYX:
+    return QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(tile_id.coords.y);
+  case UrlPattern::ZXY_yPointingSouth:
+    return QString("%1/%2/%3").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
+  case UrlPattern::ZYX_yPointingSouth:
+    return QString("%1/%3/%2").arg(tile_id.zoom_level).arg(tile_id.coords.x).arg(n_y_tiles - tile_id.coords.y - 1);
+  }
+  return {};
+}
+
+void TileSource::store(const srs::TileId&, const std::shared_ptr<QByteArray>&)
+{
+}
+
+void TileSource::loadBatch(const TileSetDelta& delta)
+{
+  for (const auto& tile_id : delta.requested)
+    load(tile_id);
+}
+
+void TileSource::prefetch(const srs::TileId& tile_id)
+{
+  load(tile_id);
+}
+
+void TileSource::deliver(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data)
+{
+  QMetaObject::invokeMethod(this, [this, tile_id, data = std::move(data)]() { emit loadReady(tile_id, data); }, Qt::QueuedConnection);
+}
+
+void TileSource::deliverUnavailable(const srs::TileId& tile_id)
+{
+  QMetaObject::invokeMethod(this, [this, tile_id]() { emit tileUnavailable(tile_id); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QImage>
+#include <QObject>
+#include <QString>
+
+#include "alpine_renderer/TileSetDelta.h"
+#include "alpine_renderer/srs.h"
+
+// where the encoded tiles come from (network, directory, archive, memory, or a fallback chain of those).
+// every load is answered with loadReady (or imageReady) or tileUnavailable, always asynchronously (never from within load).
+class TileSource : public QObject
+{
+  Q_OBJECT
+public:
+  // layout of the tiles below a base url or directory
+  enum class UrlPattern {
+    ZXY, ZYX,                              // y=0 is southern most tile
+    ZXY_yPointingSouth, ZYX_yPointingSouth // y=0 is the northern most tile
+  };
+  // z/x/y (or z/y/x), without base and file ending
+  [[nodiscard]] static QString tileAddress(const srs::TileId& tile_id, UrlPattern url_pattern);
+
+  // writable sources keep the tile, e.g., tiles loaded from a later source of a fallback chain. does nothing by default.
+  virtual void store(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data);
+
+public slots:
+  virtual void load(const srs::TileId& tile_id) = 0;
+  // loads the requested tiles of the delta (for TileScheduler::tileSetChanged)
+  void loadBatch(const TileSetDelta& delta);
+  // same as load, but it shouldn't hold up the tiles, that are needed right now. same as load by default.
+  virtual void prefetch(const srs::TileId& tile_id);
+
+signals:
+  void loadReady(srs::TileId tile_id, std::shared_ptr<QByteArray> data);
+  // instead of loadReady, if the source decoded the tile already (see TileLoadService::setDecodeOnArrival). the image is never null.
+  void imageReady(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image);
+  void tileUnavailable(srs::TileId tile_id);
+
+protected:
+  // emit loadReady / tileUnavailable in the next event loop turn
+  void deliver(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data);
+  void deliverUnavailable(const srs::TileId& tile_id);
+};
@@ -18,6 +18,9 @@
 
 #include "srs.h"
 
+#include <algorithm>
+#include <cmath>
+
 constexpr unsigned int cSemiMajorAxis = 6378137;
 constexpr double cEarthCircumference = 2 * M_PI * cSemiMajorAxis;
 constexpr double cOriginShift = cEarthCircumference / 2.0;
@@ -43,6 +46,34 @@ std::array<TileId, 4> subtiles(const TileId& tile)
     TileId{tile.zoom_level + 1, tile.coords * 2u + glm::uvec2(1, 1)}};
 }
 
+TileId parent(const TileId& tile)
+{
+  if (tile.zoom_level == 0)
+    return tile;
+  return {tile.zoom_level - 1, tile.coords / 2u};
+}
+
+std::vector<TileId> neighbours(const TileId& tile)
+{
+  const auto n_x_tiles = int(number_of_horizontal_tiles_for_zoom_level(tile.zoom_level));
+  const auto n_y_tiles = int(number_of_vertical_tiles_for_zoom_level(tile.zoom_level));
+  std::vector<TileId> neighbours;
+  neighbours.reserve(8);
+  for (int dy = -1; dy <= 1; ++dy) {
+    const auto y = int(tile.coords.y) + dy;
+    if (y < 0 || y >= n_y_tiles)
+      continue;
+    for (int dx = -1; dx <= 1; ++dx) {
+      const auto x = (int(tile.coords.x) + dx + n_x_tiles) % n_x_tiles;
+      const auto neighbour = TileId{tile.zoom_level, {unsigned(x), unsigned(y)}};
+      // on low zoom levels, wrapping around can yield the same tile several times
+      if (neighbour != tile && std::find(neighbours.begin(), neighbours.end(), neighbour) == neighbours.end())
+        neighbours.push_back(neighbour);
+    }
+  }
+  return neighbours;
+}
+
 bool overlap(const TileId& a, const TileId& b) {
   const auto& smaller_zoom_tile = (a.zoom_level < b.zoom_level) ? a : b;
   auto other = (a.zoom_level >= b.zoom_level) ? a : b;
@@ -55,4 +86,25 @@ bool overlap(const TileId& a, const TileId& b) {
   return smaller_zoom_tile == other;
 }
 
+std::vector<TileId> tiles_overlapping(const Bounds& bounds, unsigned zoom_level)
+{
+  const auto tile_range = [](double min, double max, unsigned n_tiles) {
+    const auto tile_size = cEarthCircumference / n_tiles;
+    const auto clamp = [n_tiles](double v) { return unsigned(std::clamp(v, 0.0, double(n_tiles - 1))); };
+    const auto first = clamp(std::floor((min + cOriginShift) / tile_size));
+    // a max on the edge of a tile doesn't reach into it
+    const auto last = std::max(first, clamp(std::ceil((max + cOriginShift) / tile_size) - 1.0));
+    return std::make_pair(first, last);
+  };
+  const auto [min_x, max_x] = tile_range(bounds.min.x, bounds.max.x, number_of_horizontal_tiles_for_zoom_level(zoom_level));
+  const auto [min_y, max_y] = tile_range(bounds.min.y, bounds.max.y, number_of_vertical_tiles_for_zoom_level(zoom_level));
+  std::vector<TileId> tiles;
+  tiles.reserve(size_t(max_x - min_x + 1) * size_t(max_y - min_y + 1));
+  for (auto y = min_y; y <= max_y; ++y) {
+    for (auto x = min_x; x <= max_x; ++x)
+      tiles.push_back(TileId{zoom_level, glm::uvec2(x, y)});
+  }
+  return tiles;
+}
+
 }
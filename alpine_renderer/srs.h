@@ -20,6 +20,7 @@
 
 #include <array>
 #include <functional>
+#include <vector>
 
 #include <glm/glm.hpp>
 
@@ -77,7 +78,13 @@ inline unsigned number_of_vertical_tiles_for_zoom_level(unsigned z) { return 1 <
 
 Bounds tile_bounds(const TileId& tile);
 std::array<TileId, 4> subtiles(const TileId& tile);
+// the parent of the root tile is the root tile itself
+TileId parent(const TileId& tile);
+// the up to 8 tiles around the given one on the same zoom level. wraps around in x direction (the antimeridian), but not in y direction.
+std::vector<TileId> neighbours(const TileId& tile);
 bool overlap(const TileId& a, const TileId& b);
+// the tiles on the zoom level, that overlap the bounds (with an area, not only along an edge). clamped to the valid tiles.
+std::vector<TileId> tiles_overlapping(const Bounds& bounds, unsigned zoom_level);
 
 inline geometry::AABB<3, double> aabb(const srs::TileId& tile_id, double min_height, double max_height)
 {
@@ -0,0 +1,210 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/AdaptiveLodController.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+// weight of a new sample in the exponential moving averages
+constexpr double frame_time_smoothing = 0.1;
+constexpr double throughput_smoothing = 0.3;
+// the scale changes by at most this factor per update
+constexpr double max_scale_up = 1.25;
+constexpr double scale_down = 1.1;
+// below this pressure, there is enough headroom to add detail again
+constexpr double headroom = 0.75;
+}
+
+bool AdaptiveLodController::enabled() const
+{
+  return m_enabled;
+}
+
+void AdaptiveLodController::setEnabled(bool new_enabled)
+{
+  m_enabled = new_enabled;
+  if (!m_enabled)
+    m_state.threshold_scale = 1.0;
+}
+
+AdaptiveLodController::Clock::duration AdaptiveLodController::frameTimeBudget() const
+{
+  return m_frame_time_budget;
+}
+
+void AdaptiveLodController::setFrameTimeBudget(Clock::duration new_frame_time_budget)
+{
+  m_frame_time_budget = new_frame_time_budget;
+}
+
+size_t AdaptiveLodController::maxNumberOfTiles() const
+{
+  return m_max_number_of_tiles;
+}
+
+void AdaptiveLodController::setMaxNumberOfTiles(size_t new_max_number_of_tiles)
+{
+  m_max_number_of_tiles = new_max_number_of_tiles;
+}
+
+AdaptiveLodController::Clock::duration AdaptiveLodController::maxDownloadBacklog() const
+{
+  return m_max_download_backlog;
+}
+
+void AdaptiveLodController::setMaxDownloadBacklog(Clock::duration new_max_download_backlog)
+{
+  m_max_download_backlog = new_max_download_backlog;
+}
+
+AdaptiveLodController::Clock::duration AdaptiveLodController::maxTransferEstimateAge() const
+{
+  return m_max_transfer_estimate_age;
+}
+
+void AdaptiveLodController::setMaxTransferEstimateAge(Clock::duration new_max_transfer_estimate_age)
+{
+  m_max_transfer_estimate_age = new_max_transfer_estimate_age;
+}
+
+double AdaptiveLodController::minThresholdScale() const
+{
+  return m_min_threshold_scale;
+}
+
+double AdaptiveLodController::maxThresholdScale() const
+{
+  return m_max_threshold_scale;
+}
+
+void AdaptiveLodController::setThresholdScaleBounds(double min_scale, double max_scale)
+{
+  assert(min_scale > 0 && min_scale <= max_scale);
+  m_min_threshold_scale = min_scale;
+  m_max_threshold_scale = max_scale;
+  if (m_enabled)
+    m_state.threshold_scale = std::clamp(m_state.threshold_scale, m_min_threshold_scale, m_max_threshold_scale);
+}
+
+const AdaptiveLodController::State& AdaptiveLodController::state() const
+{
+  return m_state;
+}
+
+void AdaptiveLodController::addFrameTime(Clock::duration frame_time)
+{
+  if (m_state.frame_time == Clock::duration::zero()) {
+    m_state.frame_time = frame_time;
+    return;
+  }
+  const auto smoothed = (1.0 - frame_time_smoothing) * double(m_state.frame_time.count()) + frame_time_smoothing * double(frame_time.count());
+  m_state.frame_time = Clock::duration(Clock::rep(smoothed));
+}
+
+void AdaptiveLodController::addReceivedBytes(size_t bytes, Clock::time_point now)
+{
+  m_received_bytes_since_update += bytes;
+  m_n_received_downloads_since_update++;
+  m_last_received = now;
+  m_received_bytes += bytes;
+  m_n_received_downloads++;
+}
+
+void AdaptiveLodController::setTransferEstimate(unsigned source, const TransferEstimate& estimate, Clock::time_point now)
+{
+  m_transfer_estimates[source] = {estimate, now};
+}
+
+void AdaptiveLodController::update(size_t n_tiles, size_t n_downloads_in_transit, Clock::time_point now)
+{
+  // everything, that was in transit at the last update, arrived. what is in transit now was requested after the last download.
+  const auto drained = m_last_update && m_last_received && *m_last_received > *m_last_update
+      && m_n_received_downloads_since_update >= m_n_downloads_in_transit;
+  // the throughput is only measured while something was downloading, otherwise idle time would count as a slow network
+  const auto transfers_end = drained ? *m_last_received : now;
+  if (m_last_update && transfers_end > *m_last_update && (m_n_downloads_in_transit > 0 || m_received_bytes_since_update > 0)) {
+    const auto seconds = std::chrono::duration<double>(transfers_end - *m_last_update).count();
+    const auto sample = double(m_received_bytes_since_update) / seconds;
+    m_received_throughput = m_received_throughput > 0 ? (1.0 - throughput_smoothing) * m_received_throughput + throughput_smoothing * sample : sample;
+  }
+  m_last_update = now;
+  if (n_downloads_in_transit == 0)
+    m_in_transit_since.reset();
+  else if (!m_in_transit_since || drained)
+    m_in_transit_since = now;
+  m_n_downloads_in_transit = n_downloads_in_transit;
+  m_received_bytes_since_update = 0;
+  m_n_received_downloads_since_update = 0;
+
+  m_state.n_tiles = n_tiles;
+  m_state.throughput = m_received_throughput;
+  m_state.latency = Clock::duration::zero();
+  auto bytes_per_download = m_n_received_downloads > 0 ? double(m_received_bytes) / double(m_n_received_downloads) : 0.0;
+  double estimated_throughput = 0;
+  double estimated_bytes_per_download = 0;
+  size_t n_estimates = 0;
+  std::optional<Clock::time_point> last_estimate;
+  for (const auto& [source, received_estimate] : m_transfer_estimates) {
+    const auto& estimate = received_estimate.estimate;
+    last_estimate = std::max(last_estimate.value_or(received_estimate.received), received_estimate.received);
+    if (estimate.n_transfers == 0 || estimate.throughput <= 0 || now - received_estimate.received > m_max_transfer_estimate_age)
+      continue;
+    estimated_throughput += estimate.throughput;
+    estimated_bytes_per_download += estimate.bytes_per_transfer;
+    m_state.latency = std::max(m_state.latency, estimate.latency);
+    n_estimates++;
+  }
+  if (n_estimates > 0) {
+    m_state.throughput = estimated_throughput;
+    bytes_per_download = estimated_bytes_per_download / double(n_estimates);
+  }
+  m_state.download_backlog = Clock::duration::zero();
+  if (m_state.throughput > 0 && bytes_per_download > 0 && n_downloads_in_transit > 0) {
+    const auto seconds = double(n_downloads_in_transit) * bytes_per_download / m_state.throughput;
+    m_state.download_backlog = m_state.latency + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+  }
+  // nothing finished for that long, although there were downloads in transit. the estimates are from before the link stalled.
+  if (last_estimate && m_in_transit_since)
+    m_state.download_backlog = std::max(m_state.download_backlog, now - std::max(*last_estimate, *m_in_transit_since));
+
+  const auto ratio = [](auto value, auto limit) { return limit > decltype(limit) {} ? double(value) / double(limit) : 0.0; };
+  const auto frame_pressure = ratio(m_state.frame_time.count(), m_frame_time_budget.count());
+  const auto tile_pressure = ratio(n_tiles, m_max_number_of_tiles);
+  const auto bandwidth_pressure = ratio(m_state.download_backlog.count(), m_max_download_backlog.count());
+  m_state.pressure = std::max({frame_pressure, tile_pressure, bandwidth_pressure});
+  m_state.limit = Limit::None;
+  if (m_state.pressure > 1.0) {
+    if (m_state.pressure == frame_pressure)
+      m_state.limit = Limit::FrameTime;
+    else if (m_state.pressure == tile_pressure)
+      m_state.limit = Limit::TileCount;
+    else
+      m_state.limit = Limit::Bandwidth;
+  }
+
+  if (!m_enabled)
+    return;
+  if (m_state.pressure > 1.0)
+    m_state.threshold_scale *= std::min(m_state.pressure, max_scale_up);
+  else if (m_state.pressure < headroom)
+    m_state.threshold_scale /= scale_down;
+  m_state.threshold_scale = std::clamp(m_state.threshold_scale, m_min_threshold_scale, m_max_threshold_scale);
+}
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+
+#include "alpine_renderer/tile_source/TransferMonitor.h"
+
+// feedback controller for the level of detail. scales the screen space error thresholds of the lod policy up, when
+// - the frames take longer than the frame time budget,
+// - there are more tiles on the gpu than max number of tiles, or
+// - downloading the tiles in transit would take longer than max download backlog (the target time to complete the view)
+//   at the observed throughput and latency,
+// and down again (to min threshold scale), when there is headroom on all of them. disabled by default, it only observes then.
+class AdaptiveLodController
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  enum class Limit {
+    None,
+    FrameTime,
+    TileCount,
+    Bandwidth
+  };
+  struct State {
+    double threshold_scale = 1.0;
+    Clock::duration frame_time = Clock::duration::zero(); // smoothed
+    double throughput = 0; // bytes per second, from the transfer estimates if there are any, from the received bytes (smoothed) otherwise
+    Clock::duration latency = Clock::duration::zero(); // the highest of the transfer estimates
+    Clock::duration download_backlog = Clock::duration::zero();
+    size_t n_tiles = 0;
+    double pressure = 0; // the highest ratio of measurement to limit
+    Limit limit = Limit::None;
+  };
+
+  [[nodiscard]] bool enabled() const;
+  void setEnabled(bool new_enabled);
+  [[nodiscard]] Clock::duration frameTimeBudget() const;
+  void setFrameTimeBudget(Clock::duration new_frame_time_budget);
+  [[nodiscard]] size_t maxNumberOfTiles() const;
+  void setMaxNumberOfTiles(size_t new_max_number_of_tiles);
+  [[nodiscard]] Clock::duration maxDownloadBacklog() const;
+  void setMaxDownloadBacklog(Clock::duration new_max_download_backlog);
+  // older transfer estimates are ignored (the window of TransferMonitor by default)
+  [[nodiscard]] Clock::duration maxTransferEstimateAge() const;
+  void setMaxTransferEstimateAge(Clock::duration new_max_transfer_estimate_age);
+  [[nodiscard]] double minThresholdScale() const;
+  [[nodiscard]] double maxThresholdScale() const;
+  void setThresholdScaleBounds(double min_scale, double max_scale);
+  [[nodiscard]] const State& state() const;
+
+  void addFrameTime(Clock::duration frame_time);
+  // to be called for every received download (e.g., height or ortho part of a tile). once the downloads, that were in transit
+  // at the last update, arrived, the link might have been idle after the last of them. the throughput is measured up to it then.
+  void addReceivedBytes(size_t bytes, Clock::time_point now = Clock::now());
+  // measured by the tile sources (e.g., TileLoadService::transferEstimate), one per source. the sources download in parallel.
+  // with estimates, the backlog is the highest latency plus the bytes in transit over the summed throughput. unlike the received bytes,
+  // they don't count memory and disk cache hits as network throughput, and they see the latency of high latency links.
+  // the sources send estimates only when a download finishes. if none arrives while downloads are in transit (e.g., the link stalled),
+  // the backlog is at least the time since the last one.
+  void setTransferEstimate(unsigned source, const TransferEstimate& estimate, Clock::time_point now = Clock::now());
+  // measures the throughput since the last update and adjusts the threshold scale
+  void update(size_t n_tiles, size_t n_downloads_in_transit, Clock::time_point now = Clock::now());
+
+private:
+  State m_state;
+  std::optional<Clock::time_point> m_last_update;
+  size_t m_n_downloads_in_transit = 0;
+  size_t m_received_bytes_since_update = 0;
+  size_t m_n_received_downloads_since_update = 0;
+  std::optional<Clock::time_point> m_last_received;
+  double m_received_throughput = 0; // smoothed
+  struct ReceivedTransferEstimate {
+    TransferEstimate estimate;
+    Clock::time_point received;
+  };
+  std::map<unsigned, ReceivedTransferEstimate> m_transfer_estimates;
+  std::optional<Clock::time_point> m_in_transit_since; // downloads were in transit at every update since then
+  size_t m_received_bytes = 0;
+  size_t m_n_received_downloads = 0;
+  Clock::duration m_frame_time_budget = std::chrono::milliseconds(16);
+  size_t m_max_number_of_tiles = 2048;
+  Clock::duration m_max_download_backlog = std::chrono::seconds(2);
+  Clock::duration m_max_transfer_estimate_age = std::chrono::seconds(10);
+  double m_min_threshold_scale = 1.0;
+  double m_max_threshold_scale = 8.0;
+  bool m_enabled = false;
+};
@@ -0,0 +1,507 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/BasicTreeSchedulerCore.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
+#include "alpine_renderer/tile_scheduler/utils.h"
+
+BasicTreeSchedulerCore::BasicTreeSchedulerCore()
+{
+  m_root_node = std::make_unique<Node>(NodeData{.id = {0, {0, 0}}, .status = TileStatus::Uninitialised});
+}
+
+TileSetDelta BasicTreeSchedulerCore::updateCamera(const Context& context, const Camera& camera)
+{
+  refine(context, camera);
+  return updateTiles(context, camera);
+}
+
+void BasicTreeSchedulerCore::refine(const Context& context, const Camera& camera)
+{
+  const auto clean_up = [this](const NodeData& v) { cleanUpRemovedNode(v); };
+
+  { // reduce tree (only inner nodes are visited)
+    const auto refine_data = [&](const NodeData& v) {
+      return context.lod_policy.shouldRefine(v.id, tile_scheduler::screenSpaceError(camera, v.id), true);
+    };
+    quad_tree::reduce(m_root_node.get(), refine_data, clean_up);
+  }
+
+  { // refine tree
+    const auto refine_data = [&](const NodeData& v) {
+      return context.lod_policy.shouldRefine(v.id, tile_scheduler::screenSpaceError(camera, v.id), false);
+    };
+    quad_tree::refine(m_root_node.get(), refine_data, generateChildren);
+  }
+}
+
+void BasicTreeSchedulerCore::refine(const TileSet& inner_nodes)
+{
+  const auto is_inner_node = [&inner_nodes](const NodeData& v) { return inner_nodes.contains(v.id); };
+  quad_tree::reduce(m_root_node.get(), is_inner_node, [this](const NodeData& v) { cleanUpRemovedNode(v); });
+  quad_tree::refine(m_root_node.get(), is_inner_node, generateChildren);
+}
+
+std::array<BasicTreeSchedulerCore::NodeData, 4> BasicTreeSchedulerCore::generateChildren(const NodeData& v)
+{
+  std::array<NodeData, 4> dta;
+  const auto ids = srs::subtiles(v.id);
+  for (unsigned i = 0; i < 4; ++i) {
+    dta[i].id = ids[i];
+  }
+  return dta;
+}
+
+void BasicTreeSchedulerCore::cleanUpRemovedNode(const NodeData& v)
+{
+  switch (v.status) {
+  case TileStatus::Unavailable:
+  case TileStatus::WaitingForSiblings:
+  case TileStatus::Uninitialised:
+    break;
+  case TileStatus::InTransit:
+    // todo: cancel request and make sure it doesn't end up in the received tiles.
+    // see also todo in ship
+    break;
+  case TileStatus::OnGpu:
+    m_gpu_tiles_to_be_expired.insert(v.id);
+    break;
+  }
+}
+
+TileSetDelta BasicTreeSchedulerCore::updateTiles(const Context& context, const Camera& camera, bool skip_levels)
+{
+  context.unavailable_tiles.removeExpired();
+  const auto clean_up = [this](const NodeData& v) { cleanUpRemovedNode(v); };
+
+  { // coarsen the least important parts of the tree, if the leaves wouldn't fit into the gpu memory budget
+    std::vector<srs::TileId> leaves;
+    quad_tree::visitLeaves(m_root_node.get(), [&leaves](const NodeData& v) { leaves.push_back(v.id); });
+    const auto max_n_tiles = context.gpu_memory.maxNumberOfTiles();
+    if (leaves.size() > max_n_tiles) {
+      const auto importance = [&camera](const srs::TileId& id) { return tile_scheduler::screenSpaceError(camera, id); };
+      const auto coarsened_leaves = tile_scheduler::coarsenLeaves(leaves, max_n_tiles, importance);
+      const TileSet coarsened_leaf_set(coarsened_leaves.begin(), coarsened_leaves.end());
+      const auto keep_children = [&](const NodeData& v) {
+        return !coarsened_leaf_set.contains(v.id);
+      };
+      quad_tree::reduce(m_root_node.get(), keep_children, clean_up);
+    }
+  }
+
+  if (skip_levels) { // load only every level skip-th level. parts of the tree, that have data already, are kept.
+    std::vector<srs::TileId> leaves;
+    TileSet nodes_with_data_below;
+    quad_tree::visit(m_root_node.get(), [&](const NodeData& v) {
+      if (v.status == TileStatus::Uninitialised)
+        return;
+      for (auto ancestor = v.id; ancestor.zoom_level > 0;) {
+        ancestor = srs::parent(ancestor);
+        if (!nodes_with_data_below.insert(ancestor).second)
+          break; // the ones above are in already
+      }
+    });
+    quad_tree::visitLeaves(m_root_node.get(), [&leaves](const NodeData& v) { leaves.push_back(v.id); });
+    const auto skipped_leaves = tile_scheduler::skipLevels(leaves, [&context](const srs::TileId& tile_id) { return context.lod_policy.skipLevels(tile_id); });
+    const TileSet skipped_leaf_set(skipped_leaves.begin(), skipped_leaves.end());
+    const auto keep_children = [&](const NodeData& v) {
+      return !skipped_leaf_set.contains(v.id) || nodes_with_data_below.contains(v.id);
+    };
+    quad_tree::reduce(m_root_node.get(), keep_children, clean_up);
+  }
+
+  // collect tile requests
+  std::vector<srs::TileId> tile_requests;
+  const auto visitor = [&](NodeData& tile) {
+    switch (tile.status) {
+    case TileStatus::OnGpu:
+    case TileStatus::Unavailable:
+    case TileStatus::WaitingForSiblings:
+      break;
+    case TileStatus::InTransit:
+      // the tile arrived while the node was refined, and went to the cache
+      if (const auto cached_tile = context.tile_cache.get(tile.id)) {
+        tile.status = TileStatus::WaitingForSiblings;
+        m_tiles_waiting_for_siblings[tile.id] = cached_tile;
+      }
+      break;
+    case TileStatus::Uninitialised:
+      if (m_gpu_tiles_to_be_expired.contains(tile.id)) {
+        // the node was removed by a reduction and created again before its tile was expired, so it's still on the gpu
+        m_gpu_tiles_to_be_expired.erase(tile.id);
+        tile.status = TileStatus::OnGpu;
+        break;
+      }
+      if (context.unavailable_tiles.contains(tile.id)) {
+        tile.status = TileStatus::Unavailable;
+        break;
+      }
+      context.lod_policy.tileRequested(tile.id);
+      if (const auto cached_tile = context.tile_cache.get(tile.id)) {
+        tile.status = TileStatus::WaitingForSiblings;
+        m_tiles_waiting_for_siblings[tile.id] = cached_tile;
+        break;
+      }
+      tile.status = TileStatus::InTransit;
+      tile_requests.push_back(tile.id);
+      break;
+    }
+  };
+  quad_tree::visitLeaves(m_root_node.get(), visitor);
+
+  // cached tiles will not arrive through receiveTile, so we have to check whether we can ship them now.
+  // in progressive mode, the tiles of reduced nodes can possibly be expired right away (if a parent is still on the gpu).
+  TileSetDelta delta;
+  if (!m_tiles_waiting_for_siblings.empty() || (context.progressive && !m_gpu_tiles_to_be_expired.empty()))
+    delta = ship(context);
+  delta.requested = std::move(tile_requests);
+  return delta;
+}
+
+TileSetDelta BasicTreeSchedulerCore::receiveTile(const Context& context, const std::shared_ptr<Tile>& tile)
+{
+  auto* node = findNode(tile->id);
+  if (!node || node->hasChildren() || node->data().status != TileStatus::InTransit)
+    return {};
+  node->data().status = TileStatus::WaitingForSiblings;
+  m_tiles_waiting_for_siblings[tile->id] = tile;
+  return ship(context);
+}
+
+TileSetDelta BasicTreeSchedulerCore::markTileUnavailable(const Context& context, const srs::TileId& unavailable_tile_id)
+{
+  context.unavailable_tiles.insert(unavailable_tile_id);
+  const auto visitor = [&](NodeData& tile) {
+    if (tile.id != unavailable_tile_id)
+      return;
+    switch (tile.status) {
+    case TileStatus::InTransit:
+      tile.status = TileStatus::Unavailable;
+      break;
+    case TileStatus::Uninitialised:
+    case TileStatus::Unavailable:
+      break;
+    case TileStatus::OnGpu:
+    case TileStatus::WaitingForSiblings:
+      assert(false);
+      break;
+    }
+  };
+  quad_tree::visit(m_root_node.get(), visitor);
+  // the unavailable tile might have been the last one, the siblings were waiting for
+  return ship(context);
+}
+
+std::vector<srs::TileId> BasicTreeSchedulerCore::tilesInTransit() const
+{
+  // inner nodes, that were refined while in transit, are not waited for anymore
+  std::vector<srs::TileId> tiles;
+  quad_tree::visitLeaves(m_root_node.get(), [&tiles](const NodeData& tile) { if (tile.status == TileStatus::InTransit) tiles.push_back(tile.id); });
+  return tiles;
+}
+
+BasicTreeSchedulerCore::TileSet BasicTreeSchedulerCore::gpuTiles() const
+{
+  // traverse tree and find all gpu nodes
+  TileSet gpu_tiles;
+  const auto visitor = [&](const NodeData& tile) {
+    switch (tile.status) {
+    case TileStatus::InTransit:
+    case TileStatus::Unavailable:
+    case TileStatus::WaitingForSiblings:
+    case TileStatus::Uninitialised:
+      break;
+    case TileStatus::OnGpu:
+      gpu_tiles.insert(tile.id);
+      break;
+    }
+  };
+  quad_tree::visit(m_root_node.get(), visitor);
+  return gpu_tiles;
+}
+
+bool BasicTreeSchedulerCore::isInTransit(const srs::TileId& tile_id) const
+{
+  const auto* node = findNode(tile_id);
+  return node && !node->hasChildren() && node->data().status == TileStatus::InTransit;
+}
+
+bool BasicTreeSchedulerCore::isScheduled(const srs::TileId& tile_id) const
+{
+  const auto* node = findNode(tile_id);
+  return node && node->data().status != TileStatus::Uninitialised;
+}
+
+bool BasicTreeSchedulerCore::isRefined(const srs::TileId& tile_id) const
+{
+  const auto* node = findNode(tile_id);
+  return node && node->hasChildren();
+}
+
+BasicTreeSchedulerCore::Node* BasicTreeSchedulerCore::findNode(const srs::TileId& tile_id)
+{
+  return const_cast<Node*>(std::as_const(*this).findNode(tile_id));
+}
+
+const BasicTreeSchedulerCore::Node* BasicTreeSchedulerCore::findNode(const srs::TileId& tile_id) const
+{
+  const Node* node = m_root_node.get();
+  while (node->data().id.zoom_level < tile_id.zoom_level) {
+    if (!node->hasChildren())
+      return nullptr;
+    const auto child = std::find_if(node->begin(), node->end(), [&tile_id](const auto& child) { return srs::overlap(child->data().id, tile_id); });
+    assert(child != node->end());
+    node = child->get();
+  }
+  return node;
+}
+
+void BasicTreeSchedulerCore::checkConsistency(const Context& context) const
+{
+#ifndef NDEBUG
+  {
+    bool no_leaf_is_Uninitialised = true;
+    // setting received tiles to waiting
+    const auto visitor = [&](const NodeData& tile) {
+      switch (tile.status) {
+      case TileStatus::InTransit:
+      case TileStatus::OnGpu:
+      case TileStatus::Unavailable:
+      case TileStatus::WaitingForSiblings:
+        break;
+      case TileStatus::Uninitialised:
+        no_leaf_is_Uninitialised = false;
+      }
+    };
+    quad_tree::visitLeaves(m_root_node.get(), visitor);
+    assert(no_leaf_is_Uninitialised);
+  }
+  {
+    bool no_inner_node_is_on_the_gpu = true;
+    // setting received tiles to waiting
+    const auto visitor = [&](const NodeData& tile) {
+      switch (tile.status) {
+      case TileStatus::InTransit:
+      case TileStatus::Unavailable:
+      case TileStatus::WaitingForSiblings:
+      case TileStatus::Uninitialised:
+        break;
+      case TileStatus::OnGpu:
+        no_inner_node_is_on_the_gpu = false;
+      }
+    };
+    quad_tree::visitInnerNodes(m_root_node.get(), visitor);
+    // in progressive mode, parents stay on the gpu until their children arrived
+    assert(no_inner_node_is_on_the_gpu || context.progressive);
+  }
+#else
+  (void)context;
+#endif
+}
+
+TileSetDelta BasicTreeSchedulerCore::ship(const Context& context)
+{
+  if (context.progressive)
+    return shipProgressively(context);
+
+  // the tiles are shipped, when none of the leaves is in transit anymore
+  auto ready_to_ship = true;
+  quad_tree::visitLeaves(m_root_node.get(), [&](const NodeData& tile) {
+    assert(tile.status != TileStatus::Uninitialised);
+    if (tile.status == TileStatus::InTransit)
+      ready_to_ship = false;
+  });
+  if (!ready_to_ship)
+    return {};
+
+  std::vector<srs::TileId> tile_expiries;
+  for (const auto& id : m_gpu_tiles_to_be_expired)
+    tile_expiries.push_back(id);
+  m_gpu_tiles_to_be_expired = {};
+  std::vector<std::shared_ptr<Tile>> tiles_ready;
+
+  { // remove old tiles
+    const auto visitor = [&](NodeData& tile) {
+      switch (tile.status) {
+      case TileStatus::InTransit:
+      case TileStatus::WaitingForSiblings:
+        // todo: temporary, we are not cancelling yet
+//        assert(false);
+        break;
+      case TileStatus::Uninitialised:
+      case TileStatus::Unavailable:
+        break;
+      case TileStatus::OnGpu:
+        tile.status = TileStatus::Uninitialised;
+        tile_expiries.push_back(tile.id);
+        break;
+      }
+    };
+    quad_tree::visitInnerNodes(m_root_node.get(), visitor);
+  }
+  { // add new tiles
+    const auto visitor = [&](NodeData& tile) {
+      switch (tile.status) {
+      case TileStatus::InTransit:
+      case TileStatus::Uninitialised:
+        assert(false);
+        break;
+      case TileStatus::OnGpu:
+      case TileStatus::Unavailable:
+        break;
+      case TileStatus::WaitingForSiblings:
+        tile.status = TileStatus::OnGpu;
+        tiles_ready.push_back(takeWaitingTile(tile.id));
+        break;
+      }
+    };
+    quad_tree::visitLeaves(m_root_node.get(), visitor);
+  }
+  dropStaleWaitingTiles();
+  checkConsistency(context);
+  return makeShipment(context, std::move(tile_expiries), std::move(tiles_ready));
+}
+
+TileSetDelta BasicTreeSchedulerCore::shipProgressively(const Context& context)
+{
+  std::vector<std::shared_ptr<Tile>> tiles_ready;
+  if (!m_root_node->hasChildren() && m_root_node->data().status == TileStatus::WaitingForSiblings) {
+    m_root_node->data().status = TileStatus::OnGpu;
+    tiles_ready.push_back(takeWaitingTile(m_root_node->data().id));
+  }
+  shipCompleteSiblingGroups(m_root_node.get(), tiles_ready);
+
+  std::vector<srs::TileId> tile_expiries;
+  expireCoveredParents(m_root_node.get(), tile_expiries);
+  // tiles of reduced nodes stay until their area is covered by other tiles (usually the new parent)
+  for (auto iter = m_gpu_tiles_to_be_expired.begin(); iter != m_gpu_tiles_to_be_expired.end();) {
+    if (isAreaCovered(*iter)) {
+      tile_expiries.push_back(*iter);
+      iter = m_gpu_tiles_to_be_expired.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  dropStaleWaitingTiles();
+  checkConsistency(context);
+  return makeShipment(context, std::move(tile_expiries), std::move(tiles_ready));
+}
+
+void BasicTreeSchedulerCore::shipCompleteSiblingGroups(Node* node, std::vector<std::shared_ptr<Tile>>& tiles_ready)
+{
+  if (!node->hasChildren())
+    return;
+  // the group is complete, if none of the leaves is still in transit. children with children of their own are handled by the recursion.
+  const auto group_is_complete = std::none_of(node->begin(), node->end(), [](const auto& child) {
+    return !child->hasChildren() && child->data().status == TileStatus::InTransit;
+  });
+  for (auto& child : *node) {
+    if (child->hasChildren()) {
+      shipCompleteSiblingGroups(child.get(), tiles_ready);
+      continue;
+    }
+    if (group_is_complete && child->data().status == TileStatus::WaitingForSiblings) {
+      child->data().status = TileStatus::OnGpu;
+      tiles_ready.push_back(takeWaitingTile(child->data().id));
+    }
+  }
+}
+
+void BasicTreeSchedulerCore::expireCoveredParents(Node* node, std::vector<srs::TileId>& tile_expiries)
+{
+  if (!node->hasChildren())
+    return;
+  for (auto& child : *node)
+    expireCoveredParents(child.get(), tile_expiries);
+
+  const auto child_is_covered = [](const auto& child) { return isCovered(*child); };
+  if (node->data().status == TileStatus::OnGpu && std::all_of(node->begin(), node->end(), child_is_covered)) {
+    node->data().status = TileStatus::Uninitialised;
+    tile_expiries.push_back(node->data().id);
+  }
+}
+
+bool BasicTreeSchedulerCore::isCovered(const Node& node)
+{
+  // unavailable tiles will never arrive, there is nothing to wait for
+  if (node.data().status == TileStatus::OnGpu || node.data().status == TileStatus::Unavailable)
+    return true;
+  if (!node.hasChildren())
+    return false;
+  return std::all_of(node.begin(), node.end(), [](const auto& child) { return isCovered(*child); });
+}
+
+bool BasicTreeSchedulerCore::isAreaCovered(const srs::TileId& tile_id) const
+{
+  const Node* node = m_root_node.get();
+  while (node->data().id.zoom_level < tile_id.zoom_level) {
+    if (node->data().status == TileStatus::OnGpu)
+      return true;
+    if (!node->hasChildren())
+      return node->data().status == TileStatus::Unavailable;
+    const auto child = std::find_if(node->begin(), node->end(), [&tile_id](const auto& child) { return srs::overlap(child->data().id, tile_id); });
+    assert(child != node->end());
+    node = child->get();
+  }
+  // the node was created again and refined further (otherwise it would have been taken off the expiry list when requesting tiles)
+  return isCovered(*node);
+}
+
+void BasicTreeSchedulerCore::dropStaleWaitingTiles()
+{
+  // nodes, that were refined while waiting, keep their tile. they might become leaves again.
+  TileSet waiting_nodes;
+  quad_tree::visit(m_root_node.get(), [&waiting_nodes](const NodeData& tile) {
+    if (tile.status == TileStatus::WaitingForSiblings)
+      waiting_nodes.insert(tile.id);
+  });
+  std::erase_if(m_tiles_waiting_for_siblings, [&waiting_nodes](const auto& entry) { return !waiting_nodes.contains(entry.first); });
+}
+
+std::shared_ptr<Tile> BasicTreeSchedulerCore::takeWaitingTile(const srs::TileId& tile_id)
+{
+  const auto waiting_tile = m_tiles_waiting_for_siblings.find(tile_id);
+  assert(waiting_tile != m_tiles_waiting_for_siblings.end());
+  const auto tile = waiting_tile->second;
+  m_tiles_waiting_for_siblings.erase(waiting_tile);
+  return tile;
+}
+
+TileSetDelta BasicTreeSchedulerCore::makeShipment(const Context& context, std::vector<srs::TileId> tile_expiries, std::vector<std::shared_ptr<Tile>> tiles_ready)
+{
+  for (const auto& id : tile_expiries)
+    context.gpu_memory.remove(id);
+  for (const auto& tile : tiles_ready) {
+    context.gpu_memory.add(*tile);
+    context.lod_policy.tileShipped(tile->id);
+  }
+  TileSetDelta delta;
+  delta.expired = std::move(tile_expiries);
+  delta.ready = std::move(tiles_ready);
+  return delta;
+}
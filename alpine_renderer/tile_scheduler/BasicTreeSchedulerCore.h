@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "alpine_renderer/Camera.h"
+#include "alpine_renderer/TileSetDelta.h"
+#include "alpine_renderer/srs.h"
+#include "alpine_renderer/utils/QuadTree.h"
+
+class GpuMemoryBudget;
+class LodPolicy;
+class TileCache;
+class UnavailableTileCache;
+struct Tile;
+
+// the tile tree of the BasicTreeTileScheduler, without QObject, signals or timers (see SimplisticSchedulerCore).
+// tiles are shipped in complete sibling groups, in progressive mode parents stay on the gpu until their children arrived.
+// network, decoding, prefetching, shared height tiles and time slicing are left to the caller.
+class BasicTreeSchedulerCore
+{
+  enum class TileStatus {
+    Uninitialised,
+    Unavailable,
+    InTransit,
+    WaitingForSiblings,
+    OnGpu
+  };
+  struct NodeData {
+    srs::TileId id = {};
+    TileStatus status = TileStatus::Uninitialised;
+  };
+  using Node = QuadTreeNode<NodeData>;
+
+public:
+  using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+  // the components are owned by the caller (they can be shared with other schedulers) and passed to every call
+  struct Context {
+    LodPolicy& lod_policy;
+    GpuMemoryBudget& gpu_memory;
+    UnavailableTileCache& unavailable_tiles;
+    TileCache& tile_cache;
+    bool progressive = false;
+  };
+
+  BasicTreeSchedulerCore();
+
+  // refine and updateTiles in one go
+  [[nodiscard]] TileSetDelta updateCamera(const Context& context, const Camera& camera);
+  // reduces and refines the tree with the thresholds of the lod policy. the current tree is the hysteresis.
+  void refine(const Context& context, const Camera& camera);
+  // makes the tree match the cut found by a time sliced refinement
+  void refine(const TileSet& inner_nodes);
+  // coarsens the tree to the gpu budget and ships the cached tiles of new leaves (once their siblings are there).
+  // the other new leaves are in transit and returned in delta.requested.
+  [[nodiscard]] TileSetDelta updateTiles(const Context& context, const Camera& camera, bool skip_levels = false);
+  // a tile with all required layers. it is ignored, unless its node is a leaf in transit.
+  [[nodiscard]] TileSetDelta receiveTile(const Context& context, const std::shared_ptr<Tile>& tile);
+  // the tile is not requested again until the entry in the unavailable tile cache expires. its siblings might be shipped now.
+  [[nodiscard]] TileSetDelta markTileUnavailable(const Context& context, const srs::TileId& tile_id);
+
+  [[nodiscard]] std::vector<srs::TileId> tilesInTransit() const;
+  [[nodiscard]] TileSet gpuTiles() const;
+  [[nodiscard]] bool isInTransit(const srs::TileId& tile_id) const;
+  // true if the tree has a node for the tile, that is in use (requested, on the gpu etc.)
+  [[nodiscard]] bool isScheduled(const srs::TileId& tile_id) const;
+  // true if the tile is an inner node of the tree
+  [[nodiscard]] bool isRefined(const srs::TileId& tile_id) const;
+
+private:
+  [[nodiscard]] static std::array<NodeData, 4> generateChildren(const NodeData& v);
+  // collects the gpu tiles of nodes removed from the tree for expiry
+  void cleanUpRemovedNode(const NodeData& v);
+  void checkConsistency(const Context& context) const;
+  // the node with the given id, or nullptr if the tree is not refined that far at its location
+  Node* findNode(const srs::TileId& tile_id);
+  const Node* findNode(const srs::TileId& tile_id) const;
+  [[nodiscard]] TileSetDelta ship(const Context& context);
+  [[nodiscard]] TileSetDelta shipProgressively(const Context& context);
+  void shipCompleteSiblingGroups(Node* node, std::vector<std::shared_ptr<Tile>>& tiles_ready);
+  void expireCoveredParents(Node* node, std::vector<srs::TileId>& tile_expiries);
+  // true if the area of the node is drawn without holes by the node itself or its descendants
+  [[nodiscard]] static bool isCovered(const Node& node);
+  // true if the area of the tile is drawn by an ancestor or by the descendants of the tile
+  [[nodiscard]] bool isAreaCovered(const srs::TileId& tile_id) const;
+  // drops the tiles of nodes, that were removed from the tree before they could be shipped
+  void dropStaleWaitingTiles();
+  std::shared_ptr<Tile> takeWaitingTile(const srs::TileId& tile_id);
+  [[nodiscard]] static TileSetDelta makeShipment(const Context& context, std::vector<srs::TileId> tile_expiries, std::vector<std::shared_ptr<Tile>> tiles_ready);
+
+  std::unique_ptr<Node> m_root_node;
+  TileSet m_gpu_tiles_to_be_expired;
+  // received and cached tiles of leaves, that are waiting for their siblings
+  std::unordered_map<srs::TileId, std::shared_ptr<Tile>, srs::TileId::Hasher> m_tiles_waiting_for_siblings;
+};
@@ -21,46 +21,27 @@
 #include <QObject>
 
 #include "alpine_renderer/TileScheduler.h"
-#include "alpine_renderer/utils/QuadTree.h"
+#include "alpine_renderer/tile_scheduler/BasicTreeSchedulerCore.h"
 
+// adapter between the qt world (signals, slots, decoding, timers) and the BasicTreeSchedulerCore
 class BasicTreeTileScheduler : public TileScheduler
 {
-  enum class TileStatus {
-    Uninitialised,
-    Unavailable,
-    InTransit,
-    WaitingForSiblings,
-    OnGpu
-  };
-  struct NodeData {
-    srs::TileId id = {};
-    TileStatus status = TileStatus::Uninitialised;
-  };
-  using Node = QuadTreeNode<NodeData>;
-
-  std::unique_ptr<Node> m_root_node;
-  Tile2DataMap m_received_ortho_tiles;
-  Tile2DataMap m_received_height_tiles;
-  TileSet m_gpu_tiles_to_be_expired;
-
-  bool m_enabled = true;
-
 public:
   BasicTreeTileScheduler();
 
   size_t numberOfTilesInTransit() const override;
-  size_t numberOfWaitingHeightTiles() const override;
-  size_t numberOfWaitingOrthoTiles() const override;
   TileSet gpuTiles() const override;
   bool enabled() const override;
   void setEnabled(bool newEnabled) override;
 
+protected:
+  bool isScheduled(const srs::TileId& tile_id) const override;
+  void refinementFinished(const Camera& camera, const TimeSlicedRefinement& refinement) override;
+
 public slots:
   void updateCamera(const Camera& camera) override;
-  void receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) override;
-  void receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) override;
-  void notifyAboutUnavailableOrthoTile(srs::TileId tile_id) override;
-  void notifyAboutUnavailableHeightTile(srs::TileId tile_id) override;
+  void receiveTileLayer(srs::TileId tile_id, unsigned layer, std::shared_ptr<QByteArray> data, QImage image = {}) override;
+  void notifyAboutUnavailableTileLayer(srs::TileId tile_id, unsigned layer) override;
 
 //signals:
 //  void tileRequested(const srs::TileId& tile_id);
@@ -69,8 +50,13 @@ public slots:
 //  void cancelTileRequest(const srs::TileId& tile_id);
 
 private:
-  void checkConsistency() const;
+  [[nodiscard]] BasicTreeSchedulerCore::Context context();
+  void updateTiles(const Camera& camera);
+  // emits the per tile signals (expired before ready). requests of tiles, that are prefetched already, are not emitted.
+  void emitTileSignals(const TileSetDelta& delta);
   void checkLoadedTile(const srs::TileId& tile_id);
   void markTileUnavailable(const srs::TileId& tile_id);
+  void receivePrefetchedTile(const std::shared_ptr<Tile>& tile);
+  BasicTreeSchedulerCore m_core;
+  bool m_enabled = true;
 };
-
@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/CameraPredictor.h"
+
+CameraPredictor::CameraPredictor(Clock::duration window) : m_window(window)
+{
+}
+
+void CameraPredictor::addSample(const Camera& camera, Clock::time_point time)
+{
+  m_samples.push_back({camera.position(), time});
+  m_last_camera = camera;
+  while (m_samples.size() > 2 && m_samples.front().time < time - m_window)
+    m_samples.pop_front();
+}
+
+void CameraPredictor::clear()
+{
+  m_samples.clear();
+  m_last_camera.reset();
+}
+
+CameraPredictor::Clock::duration CameraPredictor::window() const
+{
+  return m_window;
+}
+
+void CameraPredictor::setWindow(Clock::duration new_window)
+{
+  m_window = new_window;
+}
+
+glm::dvec3 CameraPredictor::velocity() const
+{
+  if (m_samples.size() < 2)
+    return {0, 0, 0};
+  const auto& newest = m_samples.back();
+  const auto& oldest = m_samples.front();
+  // the camera was still in between, the new update starts a new movement
+  if (newest.time - m_samples[m_samples.size() - 2].time > m_window)
+    return {0, 0, 0};
+  const auto seconds = std::chrono::duration<double>(newest.time - oldest.time).count();
+  if (seconds <= 0)
+    return {0, 0, 0};
+  return (newest.position - oldest.position) / seconds;
+}
+
+std::optional<Camera> CameraPredictor::predict(Clock::duration horizon) const
+{
+  if (!m_last_camera)
+    return {};
+  auto predicted_camera = *m_last_camera;
+  predicted_camera.move(velocity() * std::chrono::duration<double>(horizon).count());
+  return predicted_camera;
+}
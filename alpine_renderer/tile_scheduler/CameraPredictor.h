@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+
+#include <glm/glm.hpp>
+
+#include "alpine_renderer/Camera.h"
+
+// estimates the camera velocity from the recent camera updates and extrapolates the camera into the future.
+// only the position is extrapolated, the orientation of the last camera is kept.
+class CameraPredictor
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit CameraPredictor(Clock::duration window = std::chrono::milliseconds(250));
+
+  void addSample(const Camera& camera, Clock::time_point time = Clock::now());
+  void clear();
+
+  // samples older than the window (relative to the newest one) are not used for the velocity estimation
+  [[nodiscard]] Clock::duration window() const;
+  void setWindow(Clock::duration new_window);
+  // in webmercator units (~meters) per second. zero, if there are less than two samples within the window.
+  [[nodiscard]] glm::dvec3 velocity() const;
+  // the last camera moved along the velocity for the given time. std::nullopt, if there is no sample yet.
+  [[nodiscard]] std::optional<Camera> predict(Clock::duration horizon) const;
+
+private:
+  struct Sample {
+    glm::dvec3 position;
+    Clock::time_point time;
+  };
+  std::deque<Sample> m_samples;
+  std::optional<Camera> m_last_camera;
+  Clock::duration m_window;
+};
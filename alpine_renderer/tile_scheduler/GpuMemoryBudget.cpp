@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+
+#include <algorithm>
+
+#include "alpine_renderer/Tile.h"
+
+namespace {
+size_t textureBytesWithMipMaps(size_t width, size_t height, size_t bytes_per_pixel)
+{
+  size_t bytes = 0;
+  while (true) {
+    bytes += width * height * bytes_per_pixel;
+    if (width <= 1 && height <= 1)
+      break;
+    width = std::max<size_t>(1, width / 2);
+    height = std::max<size_t>(1, height / 2);
+  }
+  return bytes;
+}
+}
+
+GpuMemoryBudget::GpuMemoryBudget(size_t budget) : m_budget(budget)
+{
+}
+
+void GpuMemoryBudget::add(const Tile& tile)
+{
+  remove(tile.id);
+  const auto bytes = estimatedBytes(tile);
+  m_tile_bytes[tile.id] = bytes;
+  m_bytes += bytes;
+}
+
+void GpuMemoryBudget::remove(const srs::TileId& tile_id)
+{
+  const auto found = m_tile_bytes.find(tile_id);
+  if (found == m_tile_bytes.end())
+    return;
+  m_bytes -= found->second;
+  m_tile_bytes.erase(found);
+}
+
+void GpuMemoryBudget::clear()
+{
+  m_tile_bytes.clear();
+  m_bytes = 0;
+}
+
+size_t GpuMemoryBudget::budget() const
+{
+  return m_budget;
+}
+
+void GpuMemoryBudget::setBudget(size_t new_budget)
+{
+  m_budget = new_budget;
+}
+
+size_t GpuMemoryBudget::bytes() const
+{
+  return m_bytes;
+}
+
+size_t GpuMemoryBudget::bytesOf(const srs::TileId& tile_id) const
+{
+  const auto found = m_tile_bytes.find(tile_id);
+  return found == m_tile_bytes.end() ? 0 : found->second;
+}
+
+size_t GpuMemoryBudget::numberOfTiles() const
+{
+  return m_tile_bytes.size();
+}
+
+GpuMemoryBudget::Residency GpuMemoryBudget::residency() const
+{
+  return {.n_tiles = numberOfTiles(), .bytes = bytes(), .budget = budget()};
+}
+
+bool GpuMemoryBudget::fits(size_t additional_bytes) const
+{
+  return m_bytes + additional_bytes <= m_budget;
+}
+
+size_t GpuMemoryBudget::bytesPerTile() const
+{
+  if (m_tile_bytes.empty())
+    return estimatedBytes(256, 256);
+  return std::max<size_t>(1, m_bytes / m_tile_bytes.size());
+}
+
+size_t GpuMemoryBudget::maxNumberOfTiles() const
+{
+  return m_budget / bytesPerTile();
+}
+
+size_t GpuMemoryBudget::estimatedBytes(const Tile& tile)
+{
+  // GLTileManager uploads the height map as it is (uint16) and the ortho texture as rgba8 with mip maps.
+  return tile.height_map.bufferLength() * sizeof(uint16_t)
+      + textureBytesWithMipMaps(size_t(tile.orthotexture.width()), size_t(tile.orthotexture.height()), 4);
+}
+
+size_t GpuMemoryBudget::estimatedBytes(size_t height_map_side_length, size_t ortho_side_length)
+{
+  return height_map_side_length * height_map_side_length * sizeof(uint16_t)
+      + textureBytesWithMipMaps(ortho_side_length, ortho_side_length, 4);
+}
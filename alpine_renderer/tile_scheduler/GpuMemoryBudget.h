@@ -0,0 +1,64 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <unordered_map>
+
+#include "alpine_renderer/srs.h"
+
+struct Tile;
+
+// tracks the estimated gpu memory of the tiles, that were shipped to the gpu, against a budget.
+// the estimate covers the height buffer and the ortho texture including its mip maps, the mesh index buffers are shared and not counted.
+class GpuMemoryBudget
+{
+public:
+  struct Residency {
+    size_t n_tiles = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+  };
+
+  explicit GpuMemoryBudget(size_t budget = 512 * 1024 * 1024);
+
+  void add(const Tile& tile);
+  void remove(const srs::TileId& tile_id);
+  void clear();
+
+  [[nodiscard]] size_t budget() const;
+  void setBudget(size_t new_budget);
+  [[nodiscard]] size_t bytes() const;
+  // returns 0 for tiles, that are not tracked
+  [[nodiscard]] size_t bytesOf(const srs::TileId& tile_id) const;
+  [[nodiscard]] size_t numberOfTiles() const;
+  [[nodiscard]] Residency residency() const;
+  [[nodiscard]] bool fits(size_t additional_bytes) const;
+  // the average size of the resident tiles, or estimatedBytes(256, 256) if there are none.
+  [[nodiscard]] size_t bytesPerTile() const;
+  // the number of (average) tiles, that fit into the budget. used by the schedulers to plan, before tiles are loaded.
+  [[nodiscard]] size_t maxNumberOfTiles() const;
+
+  [[nodiscard]] static size_t estimatedBytes(const Tile& tile);
+  [[nodiscard]] static size_t estimatedBytes(size_t height_map_side_length, size_t ortho_side_length);
+
+private:
+  std::unordered_map<srs::TileId, size_t, srs::TileId::Hasher> m_tile_bytes;
+  size_t m_bytes = 0;
+  size_t m_budget = 0;
+};
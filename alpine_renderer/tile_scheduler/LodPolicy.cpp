@@ -0,0 +1,184 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+
+#include <algorithm>
+#include <cassert>
+
+LodPolicy::LodPolicy(double refine_threshold, double coarsen_threshold, Clock::duration min_residency)
+    : m_refine_threshold(refine_threshold), m_coarsen_threshold(coarsen_threshold), m_min_residency(min_residency)
+{
+  assert(coarsen_threshold <= refine_threshold);
+}
+
+bool LodPolicy::shouldRefine(const srs::TileId& tile_id, double screen_space_error, bool is_refined, Clock::time_point now) const
+{
+  if (tile_id.zoom_level >= m_max_zoom_level)
+    return false;
+  if (screen_space_error >= m_refine_threshold * m_threshold_scale)
+    return true;
+  if (!is_refined)
+    return false;
+  if (screen_space_error >= m_coarsen_threshold * m_threshold_scale)
+    return true;
+  const auto found = m_descendant_ship_times.find(tile_id);
+  return found != m_descendant_ship_times.end() && now - found->second < m_min_residency;
+}
+
+bool LodPolicy::isFastMovement(const Camera& camera, const glm::dvec3& velocity) const
+{
+  return glm::length(velocity) >= m_fast_movement_speed * std::max(camera.position().z, 1.0);
+}
+
+srs::TileId LodPolicy::skipLevels(const srs::TileId& tile_id) const
+{
+  auto ancestor = tile_id;
+  while (ancestor.zoom_level % m_level_skip != 0)
+    ancestor = srs::parent(ancestor);
+  return ancestor;
+}
+
+void LodPolicy::tileShipped(const srs::TileId& tile_id, Clock::time_point now)
+{
+  if (m_min_residency <= Clock::duration::zero())
+    return;
+  auto ancestor = tile_id;
+  while (ancestor.zoom_level > 0) {
+    ancestor = srs::parent(ancestor);
+    m_descendant_ship_times[ancestor] = now;
+  }
+}
+
+void LodPolicy::tileRequested(const srs::TileId& tile_id, Clock::time_point now)
+{
+  m_statistics.requests++;
+  const auto found = m_request_times.find(tile_id);
+  if (found != m_request_times.end() && now - found->second < m_churn_window)
+    m_statistics.re_requests++;
+  m_request_times[tile_id] = now;
+}
+
+void LodPolicy::removeExpired(Clock::time_point now)
+{
+  std::erase_if(m_descendant_ship_times, [&](const auto& entry) { return now - entry.second >= m_min_residency; });
+  std::erase_if(m_request_times, [&](const auto& entry) { return now - entry.second >= m_churn_window; });
+}
+
+double LodPolicy::refineThreshold() const
+{
+  return m_refine_threshold;
+}
+
+void LodPolicy::setRefineThreshold(double new_refine_threshold)
+{
+  m_refine_threshold = new_refine_threshold;
+}
+
+double LodPolicy::coarsenThreshold() const
+{
+  return m_coarsen_threshold;
+}
+
+void LodPolicy::setCoarsenThreshold(double new_coarsen_threshold)
+{
+  m_coarsen_threshold = new_coarsen_threshold;
+}
+
+double LodPolicy::thresholdScale() const
+{
+  return m_threshold_scale;
+}
+
+void LodPolicy::setThresholdScale(double new_threshold_scale)
+{
+  assert(new_threshold_scale > 0);
+  m_threshold_scale = new_threshold_scale;
+}
+
+LodPolicy::Clock::duration LodPolicy::minResidency() const
+{
+  return m_min_residency;
+}
+
+void LodPolicy::setMinResidency(Clock::duration new_min_residency)
+{
+  m_min_residency = new_min_residency;
+}
+
+unsigned LodPolicy::maxZoomLevel() const
+{
+  return m_max_zoom_level;
+}
+
+void LodPolicy::setMaxZoomLevel(unsigned new_max_zoom_level)
+{
+  m_max_zoom_level = new_max_zoom_level;
+}
+
+unsigned LodPolicy::levelSkip() const
+{
+  return m_level_skip;
+}
+
+void LodPolicy::setLevelSkip(unsigned new_level_skip)
+{
+  assert(new_level_skip >= 1);
+  m_level_skip = new_level_skip;
+}
+
+double LodPolicy::fastMovementSpeed() const
+{
+  return m_fast_movement_speed;
+}
+
+void LodPolicy::setFastMovementSpeed(double new_fast_movement_speed)
+{
+  m_fast_movement_speed = new_fast_movement_speed;
+}
+
+LodPolicy::Clock::duration LodPolicy::settleDelay() const
+{
+  return m_settle_delay;
+}
+
+void LodPolicy::setSettleDelay(Clock::duration new_settle_delay)
+{
+  m_settle_delay = new_settle_delay;
+}
+
+LodPolicy::Clock::duration LodPolicy::churnWindow() const
+{
+  return m_churn_window;
+}
+
+void LodPolicy::setChurnWindow(Clock::duration new_churn_window)
+{
+  m_churn_window = new_churn_window;
+}
+
+const LodPolicy::Statistics& LodPolicy::statistics() const
+{
+  return m_statistics;
+}
+
+void LodPolicy::resetStatistics()
+{
+  m_statistics = {};
+}
@@ -0,0 +1,102 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "alpine_renderer/Camera.h"
+#include "alpine_renderer/srs.h"
+
+// decides how far the tile tree is refined. tiles are split when their screen space error reaches the refine threshold,
+// but children are only removed again when the error drops below the (lower) coarsen threshold. in addition, children are kept
+// for the min residency time after a tile below them was shipped. both avoid loading and expiring the same tiles over and over
+// again when the camera moves back and forth a little.
+// while the camera moves fast (e.g., zoom animations), only every level skip-th zoom level is loaded, most of the other tiles
+// would be replaced before they arrive. the skipped levels are filled in once the camera settled.
+// the policy also counts tiles, that are requested again within the churn window, to tune the settings against recorded camera paths.
+// the policy can be shared between several schedulers.
+class LodPolicy
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  struct Statistics {
+    size_t requests = 0;
+    size_t re_requests = 0; // requests of tiles, that were requested within the churn window already
+    [[nodiscard]] double churnRate() const { return requests ? double(re_requests) / double(requests) : 0.0; }
+  };
+
+  explicit LodPolicy(double refine_threshold = 1.0, double coarsen_threshold = 0.5, Clock::duration min_residency = Clock::duration::zero());
+
+  // is_refined: whether the tile has children at the moment
+  [[nodiscard]] bool shouldRefine(const srs::TileId& tile_id, double screen_space_error, bool is_refined, Clock::time_point now = Clock::now()) const;
+  // true if the camera moves more than fast movement speed times its altitude per second
+  [[nodiscard]] bool isFastMovement(const Camera& camera, const glm::dvec3& velocity) const;
+  // the ancestor of the tile on the closest coarser level, that is loaded while moving fast
+  [[nodiscard]] srs::TileId skipLevels(const srs::TileId& tile_id) const;
+  // to be called for tiles going to the gpu, starts the residency time of their ancestors' children
+  void tileShipped(const srs::TileId& tile_id, Clock::time_point now = Clock::now());
+  // to be called for tiles, that are requested from the network or the cache
+  void tileRequested(const srs::TileId& tile_id, Clock::time_point now = Clock::now());
+  // entries are not removed automatically, call this from time to time to free the memory
+  void removeExpired(Clock::time_point now = Clock::now());
+
+  [[nodiscard]] double refineThreshold() const;
+  void setRefineThreshold(double new_refine_threshold);
+  // must not be larger than the refine threshold
+  [[nodiscard]] double coarsenThreshold() const;
+  void setCoarsenThreshold(double new_coarsen_threshold);
+  // both thresholds are multiplied by the scale, e.g., by the adaptive lod controller to drop detail under load
+  [[nodiscard]] double thresholdScale() const;
+  void setThresholdScale(double new_threshold_scale);
+  [[nodiscard]] Clock::duration minResidency() const;
+  void setMinResidency(Clock::duration new_min_residency);
+  [[nodiscard]] unsigned maxZoomLevel() const;
+  void setMaxZoomLevel(unsigned new_max_zoom_level);
+  // 1 disables skipping levels (default)
+  [[nodiscard]] unsigned levelSkip() const;
+  void setLevelSkip(unsigned new_level_skip);
+  [[nodiscard]] double fastMovementSpeed() const;
+  void setFastMovementSpeed(double new_fast_movement_speed);
+  // the camera is considered settled, when it wasn't updated for this long
+  [[nodiscard]] Clock::duration settleDelay() const;
+  void setSettleDelay(Clock::duration new_settle_delay);
+  [[nodiscard]] Clock::duration churnWindow() const;
+  void setChurnWindow(Clock::duration new_churn_window);
+  [[nodiscard]] const Statistics& statistics() const;
+  void resetStatistics();
+
+private:
+  using TimeMap = std::unordered_map<srs::TileId, Clock::time_point, srs::TileId::Hasher>;
+  TimeMap m_descendant_ship_times; // per tile, when a tile below it was shipped last
+  TimeMap m_request_times;
+  double m_refine_threshold;
+  double m_coarsen_threshold;
+  double m_threshold_scale = 1.0;
+  Clock::duration m_min_residency;
+  unsigned m_max_zoom_level = 16;
+  unsigned m_level_skip = 1;
+  double m_fast_movement_speed = 0.5; // ~ one zoom level per second when zooming straight down
+  Clock::duration m_settle_delay = std::chrono::milliseconds(300);
+  Clock::duration m_churn_window = std::chrono::seconds(10);
+  Statistics m_statistics;
+};
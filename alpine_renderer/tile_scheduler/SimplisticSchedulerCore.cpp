@@ -0,0 +1,190 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/SimplisticSchedulerCore.h"
+
+#include <algorithm>
+
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
+#include "alpine_renderer/tile_scheduler/utils.h"
+#include "alpine_renderer/utils/QuadTree.h"
+
+TileSetDelta SimplisticSchedulerCore::updateCamera(const Context& context, const Camera& camera)
+{
+  return updateTiles(context, camera, refineCandidates(context, camera));
+}
+
+std::vector<srs::TileId> SimplisticSchedulerCore::refineCandidates(const Context& context, const Camera& camera)
+{
+  // the tiles refined last time are the tree for the hysteresis
+  TileSet refined_tiles;
+  const auto refine = [&](const srs::TileId& tile_id) {
+    const auto needs_refinement = context.lod_policy.shouldRefine(tile_id, tile_scheduler::screenSpaceError(camera, tile_id), m_refined_tiles.contains(tile_id));
+    if (needs_refinement)
+      refined_tiles.insert(tile_id);
+    return needs_refinement;
+  };
+  const auto all_leaves = quad_tree::onTheFlyTraverse(srs::TileId{0, {0, 0}}, refine, [](const auto& v) { return srs::subtiles(v); });
+  m_refined_tiles = std::move(refined_tiles);
+
+  std::vector<srs::TileId> visible_leaves;
+  visible_leaves.reserve(all_leaves.size());
+  std::copy_if(all_leaves.begin(), all_leaves.end(), std::back_inserter(visible_leaves), [&camera](const srs::TileId& tile) {
+    return tile_scheduler::cameraFrustumContainsTile(camera, tile);
+  });
+  return visible_leaves;
+}
+
+TileSetDelta SimplisticSchedulerCore::updateTiles(const Context& context, const Camera& camera, std::vector<srs::TileId> tiles, bool skip_levels)
+{
+  TileSetDelta delta;
+  const auto outside_camera_frustum = [&camera](const auto& gpu_tile_id) { return !tile_scheduler::cameraFrustumContainsTile(camera, gpu_tile_id); };
+  removeGpuTileIf(context, outside_camera_frustum, &delta);
+
+  context.unavailable_tiles.removeExpired();
+  const auto max_n_tiles = context.gpu_memory.maxNumberOfTiles();
+  if (tiles.size() > max_n_tiles) {
+    const auto importance = [&camera](const srs::TileId& id) { return tile_scheduler::screenSpaceError(camera, id); };
+    tiles = tile_scheduler::coarsenLeaves(tiles, max_n_tiles, importance);
+  }
+  if (skip_levels)
+    tiles = tile_scheduler::skipLevels(tiles, [&context](const srs::TileId& tile_id) { return context.lod_policy.skipLevels(tile_id); });
+  m_camera = camera;
+  m_current_tiles = TileSet(tiles.begin(), tiles.end());
+
+  for (const auto& t : tiles) {
+    if (context.unavailable_tiles.contains(t))
+      continue;
+    if (m_pending_tile_requests.contains(t))    // todo cancel current requests
+      continue;
+    if (m_gpu_tiles.contains(t))
+      continue;
+    context.lod_policy.tileRequested(t);
+    if (const auto cached_tile = context.tile_cache.get(t)) {
+      shipTile(context, cached_tile, &delta);
+      continue;
+    }
+    m_pending_tile_requests.insert(t);
+    delta.requested.push_back(t);
+  }
+  return delta;
+}
+
+TileSetDelta SimplisticSchedulerCore::receiveTile(const Context& context, const std::shared_ptr<Tile>& tile)
+{
+  TileSetDelta delta;
+  m_pending_tile_requests.erase(tile->id);
+  shipTile(context, tile, &delta);
+  return delta;
+}
+
+void SimplisticSchedulerCore::markTileUnavailable(const Context& context, const srs::TileId& tile_id)
+{
+  context.unavailable_tiles.insert(tile_id);
+  m_pending_tile_requests.erase(tile_id);
+}
+
+void SimplisticSchedulerCore::shipTile(const Context& context, const std::shared_ptr<Tile>& tile, TileSetDelta* delta)
+{
+  if (context.progressive) {
+    // finer tiles are covered completely by the new one, coarser ones only when all of their area is covered.
+    const auto covered_by_tile = [&tile](const auto& gpu_tile_id) { return gpu_tile_id.zoom_level >= tile->id.zoom_level && srs::overlap(gpu_tile_id, tile->id); };
+    removeGpuTileIf(context, covered_by_tile, delta);
+    // the coverage test has to see the new tile already. it is taken out again, so that makeRoomOnGpu doesn't expire it.
+    m_gpu_tiles.insert(tile->id);
+    const auto coarser_and_covered = [&](const auto& gpu_tile_id) {
+      if (gpu_tile_id.zoom_level >= tile->id.zoom_level || !srs::overlap(gpu_tile_id, tile->id))
+        return false;
+      const auto children = srs::subtiles(gpu_tile_id);
+      return std::all_of(children.begin(), children.end(), [&](const auto& child) { return isAreaCovered(context, child); });
+    };
+    removeGpuTileIf(context, coarser_and_covered, delta);
+    m_gpu_tiles.erase(tile->id);
+  } else {
+    const auto overlaps = [&tile](const auto& gpu_tile_id) { return srs::overlap(gpu_tile_id, tile->id); };
+    removeGpuTileIf(context, overlaps, delta);
+  }
+  makeRoomOnGpu(context, GpuMemoryBudget::estimatedBytes(*tile), delta);
+
+  m_gpu_tiles.insert(tile->id);
+  context.gpu_memory.add(*tile);
+  context.lod_policy.tileShipped(tile->id);
+  delta->ready.push_back(tile);
+}
+
+bool SimplisticSchedulerCore::isAreaCovered(const Context& context, const srs::TileId& tile_id) const
+{
+  if (m_gpu_tiles.contains(tile_id))
+    return true;
+  // we'll never get tiles for areas, that are not visible or not available. there is nothing to wait for.
+  if (context.unavailable_tiles.contains(tile_id) || (m_camera && !tile_scheduler::cameraFrustumContainsTile(*m_camera, tile_id)))
+    return true;
+  const auto finer_tile_on_gpu = std::any_of(m_gpu_tiles.begin(), m_gpu_tiles.end(), [&tile_id](const auto& gpu_tile_id) {
+    return gpu_tile_id.zoom_level > tile_id.zoom_level && srs::overlap(gpu_tile_id, tile_id);
+  });
+  if (!finer_tile_on_gpu)
+    return false;
+  const auto children = srs::subtiles(tile_id);
+  return std::all_of(children.begin(), children.end(), [&](const auto& child) { return isAreaCovered(context, child); });
+}
+
+void SimplisticSchedulerCore::makeRoomOnGpu(const Context& context, size_t bytes, TileSetDelta* delta)
+{
+  if (context.gpu_memory.fits(bytes) || !m_camera)
+    return;
+
+  // tiles, that are not wanted by the current camera, are expired first, least important first.
+  std::vector<std::pair<double, srs::TileId>> expiry_candidates;
+  for (const auto& id : m_gpu_tiles) {
+    if (!m_current_tiles.contains(id))
+      expiry_candidates.emplace_back(tile_scheduler::screenSpaceError(*m_camera, id), id);
+  }
+  std::sort(expiry_candidates.begin(), expiry_candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  TileSet tiles_to_expire;
+  auto freed_bytes = size_t(0);
+  for (const auto& candidate : expiry_candidates) {
+    if (context.gpu_memory.bytes() - freed_bytes + bytes <= context.gpu_memory.budget())
+      break;
+    tiles_to_expire.insert(candidate.second);
+    freed_bytes += context.gpu_memory.bytesOf(candidate.second);
+  }
+  removeGpuTileIf(context, [&tiles_to_expire](const auto& id) { return tiles_to_expire.contains(id); }, delta);
+}
+
+template<typename Predicate>
+void SimplisticSchedulerCore::removeGpuTileIf(const Context& context, Predicate condition, TileSetDelta* delta)
+{
+  std::vector<srs::TileId> overlapping_tiles;
+  overlapping_tiles.reserve(4);
+  std::copy_if(m_gpu_tiles.cbegin(), m_gpu_tiles.cend(), std::back_inserter(overlapping_tiles), condition);
+  for (const auto& gpu_tile_id : overlapping_tiles) {
+    context.gpu_memory.remove(gpu_tile_id);
+    m_gpu_tiles.erase(gpu_tile_id);
+    // shipped and expired within the same call: the consumer never has to know about it
+    const auto shipped = std::find_if(delta->ready.begin(), delta->ready.end(), [&gpu_tile_id](const auto& tile) { return tile->id == gpu_tile_id; });
+    if (shipped != delta->ready.end())
+      delta->ready.erase(shipped);
+    else
+      delta->expired.push_back(gpu_tile_id);
+  }
+}
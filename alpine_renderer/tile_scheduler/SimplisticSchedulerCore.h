@@ -0,0 +1,87 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "alpine_renderer/Camera.h"
+#include "alpine_renderer/TileSetDelta.h"
+#include "alpine_renderer/srs.h"
+
+class GpuMemoryBudget;
+class LodPolicy;
+class TileCache;
+class UnavailableTileCache;
+struct Tile;
+
+// the tile bookkeeping of the SimplisticTileScheduler, without QObject, signals or timers. everything is done synchronously,
+// the results are returned as deltas (tiles to request, tiles to ship, tiles to expire), so that it can be driven
+// and profiled in tight loops without an event loop. the scheduler is an adapter, that turns the deltas into signals.
+// network, decoding, prefetching, time slicing and waiting for the camera to settle are left to the caller.
+class SimplisticSchedulerCore
+{
+public:
+  using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+  // the components are owned by the caller (they can be shared with other schedulers) and passed to every call
+  struct Context {
+    LodPolicy& lod_policy;
+    GpuMemoryBudget& gpu_memory;
+    UnavailableTileCache& unavailable_tiles;
+    TileCache& tile_cache;
+    bool progressive = false;
+  };
+
+  // refineCandidates and updateTiles in one go
+  [[nodiscard]] TileSetDelta updateCamera(const Context& context, const Camera& camera);
+  // the visible leaves of the tile tree refined with the thresholds of the lod policy. the inner nodes are remembered
+  // for the hysteresis of the next refinement.
+  [[nodiscard]] std::vector<srs::TileId> refineCandidates(const Context& context, const Camera& camera);
+  // expires the tiles outside of the camera, coarsens the tiles to the gpu budget and ships the cached ones.
+  // the others are marked pending and returned in delta.requested.
+  [[nodiscard]] TileSetDelta updateTiles(const Context& context, const Camera& camera, std::vector<srs::TileId> tiles, bool skip_levels = false);
+  // a tile with all required layers. it's not pending anymore and shipped (together with the tiles it replaces).
+  [[nodiscard]] TileSetDelta receiveTile(const Context& context, const std::shared_ptr<Tile>& tile);
+  // the tile is not pending anymore and not requested again until the entry in the unavailable tile cache expires
+  void markTileUnavailable(const Context& context, const srs::TileId& tile_id);
+
+  [[nodiscard]] const TileSet& pendingTiles() const { return m_pending_tile_requests; }
+  [[nodiscard]] const TileSet& gpuTiles() const { return m_gpu_tiles; }
+  [[nodiscard]] bool isPending(const srs::TileId& tile_id) const { return m_pending_tile_requests.contains(tile_id); }
+  // inner nodes of the last refinement
+  [[nodiscard]] const TileSet& refinedTiles() const { return m_refined_tiles; }
+  void setRefinedTiles(TileSet refined_tiles) { m_refined_tiles = std::move(refined_tiles); }
+
+private:
+  void shipTile(const Context& context, const std::shared_ptr<Tile>& tile, TileSetDelta* delta);
+  void makeRoomOnGpu(const Context& context, size_t bytes, TileSetDelta* delta);
+  // true if the area of the tile is drawn by the tile itself or by finer tiles (or if no tiles are expected there)
+  [[nodiscard]] bool isAreaCovered(const Context& context, const srs::TileId& tile_id) const;
+  template <typename Predicate>
+  void removeGpuTileIf(const Context& context, Predicate condition, TileSetDelta* delta);
+
+  TileSet m_pending_tile_requests;
+  TileSet m_gpu_tiles;
+  TileSet m_current_tiles;
+  TileSet m_refined_tiles;
+  std::optional<Camera> m_camera;
+};
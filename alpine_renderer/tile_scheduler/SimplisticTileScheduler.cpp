@@ -21,114 +21,151 @@
 
 #include "alpine_renderer/Tile.h"
 #include "alpine_renderer/srs.h"
-#include "alpine_renderer/utils/geometry.h"
-#include "alpine_renderer/utils/QuadTree.h"
-#include "alpine_renderer/utils/tile_conversion.h"
 
 
-SimplisticTileScheduler::SimplisticTileScheduler() = default;
+SimplisticTileScheduler::SimplisticTileScheduler()
+{
+  m_lod_policy = std::make_shared<LodPolicy>(4.0, 4.0);
+}
 
 std::vector<srs::TileId> SimplisticTileScheduler::loadCandidates(const Camera& camera)
 {
 //  return quad_tree::onTheFlyTraverse(srs::TileId{0, {0, 0}}, tile_scheduler::refineFunctor(camera, 1.0), [](const auto& v) { return srs::subtiles(v); });
-  const auto all_leaves = quad_tree::onTheFlyTraverse(srs::TileId{0, {0, 0}}, tile_scheduler::refineFunctor(camera, 4.0), [](const auto& v) { return srs::subtiles(v); });
-  std::vector<srs::TileId> visible_leaves;
-  visible_leaves.reserve(all_leaves.size());
-
-  const auto is_visible = [&camera](const srs::TileId& tile) {
-    return tile_scheduler::cameraFrustumContainsTile(camera, tile);
-  };
-
-  std::copy_if(all_leaves.begin(), all_leaves.end(), std::back_inserter(visible_leaves), is_visible);
-  return visible_leaves;
+  return tile_scheduler::visibleLeaves(camera, 4.0);
 }
 
 size_t SimplisticTileScheduler::numberOfTilesInTransit() const
 {
-  return m_pending_tile_requests.size();
+  return m_core.pendingTiles().size();
 }
 
-size_t SimplisticTileScheduler::numberOfWaitingHeightTiles() const
+SimplisticTileScheduler::TileSet SimplisticTileScheduler::gpuTiles() const
 {
-  return m_received_height_tiles.size();
+  return m_core.gpuTiles();
 }
 
-size_t SimplisticTileScheduler::numberOfWaitingOrthoTiles() const
+SimplisticSchedulerCore::Context SimplisticTileScheduler::context()
 {
-  return m_received_ortho_tiles.size();
+  return { *m_lod_policy, m_gpu_memory, *m_unavailable_tiles, m_tile_cache, progressive() };
 }
 
-SimplisticTileScheduler::TileSet SimplisticTileScheduler::gpuTiles() const
+void SimplisticTileScheduler::updateCamera(const Camera& camera)
 {
-  return m_gpu_tiles;
+  if (!enabled())
+    return;
+
+  updateLodController(camera);
+  m_lod_policy->removeExpired();
+  if (m_time_budget.count() > 0) {
+    const auto refine = [this](const srs::TileId& tile_id, double screen_space_error) {
+      return m_lod_policy->shouldRefine(tile_id, screen_space_error, m_core.refinedTiles().contains(tile_id));
+    };
+    startTimeSlicedRefinement(camera, refine);
+    return;
+  }
+  updateTiles(camera, m_core.refineCandidates(context(), camera));
 }
 
-void SimplisticTileScheduler::updateCamera(const Camera& camera)
+void SimplisticTileScheduler::refinementFinished(const Camera& camera, const TimeSlicedRefinement& refinement)
 {
   if (!enabled())
     return;
+  m_core.setRefinedTiles(refinement.innerNodes());
+  // nearest tiles first
+  updateTiles(camera, refinement.visibleLeaves());
+}
 
-  const auto outside_camera_frustum = [&camera](const auto& gpu_tile_id) { return !tile_scheduler::cameraFrustumContainsTile(camera, gpu_tile_id); };
-  removeGpuTileIf(outside_camera_frustum);
+void SimplisticTileScheduler::updateTiles(const Camera& camera, std::vector<srs::TileId> tiles)
+{
+  emitTileSignals(m_core.updateTiles(context(), camera, std::move(tiles), skipsLevels(camera)));
+  updatePrefetches(camera);
+}
 
-  const auto tiles = loadCandidates(camera);
-  for (const auto& t : tiles) {
-    if (m_unavaliable_tiles.contains(t))
-      continue;
-    if (m_pending_tile_requests.contains(t))    // todo cancel current requests
-      continue;
-    if (m_gpu_tiles.contains(t)) {
+void SimplisticTileScheduler::emitTileSignals(const TileSetDelta& delta)
+{
+  for (const auto& tile_id : delta.expired)
+    emit tileExpired(tile_id);
+  for (const auto& tile : delta.ready)
+    emit tileReady(tile);
+  for (const auto& tile_id : delta.requested) {
+    if (m_prefetcher.isInFlight(tile_id))  // will be shipped when the prefetch arrives
       continue;
-    }
-    m_pending_tile_requests.insert(t);
-    emit tileRequested(t);
+    emit tileRequested(tile_id);
+    if (const auto height_tile_id = requestSharedHeightTile(tile_id))
+      emit heightTileRequested(*height_tile_id);
   }
 }
 
-void SimplisticTileScheduler::receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data)
+void SimplisticTileScheduler::receiveTileLayer(srs::TileId tile_id, unsigned layer, std::shared_ptr<QByteArray> data, QImage image)
 {
-  m_received_ortho_tiles[tile_id] = data;
+  m_lod_controller.addReceivedBytes(size_t(data->size()));
+  if (layer == TileLayerRegistry::height && receiveSharedHeightTile(tile_id, data, image)) {
+    std::vector<srs::TileId> tiles_using_height_tile;
+    for (const auto& id : m_received_tiles.tiles()) {
+      if (heightTileId(id) == tile_id)
+        tiles_using_height_tile.push_back(id);
+    }
+    for (const auto& id : tiles_using_height_tile)
+      checkLoadedTile(id);
+    return;
+  }
+  if (m_prefetcher.isInFlight(tile_id)) {
+    receivePrefetchedTile(m_prefetcher.receiveTileLayer(tile_id, layer, data, image));
+    return;
+  }
+  if (!m_core.isPending(tile_id) && receiveLateTileLayer(tile_id, layer, data, image))
+    return;
+  m_received_tiles.insert(tile_id, layer, data, image);
   checkLoadedTile(tile_id);
 }
 
-void SimplisticTileScheduler::receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data)
+void SimplisticTileScheduler::notifyAboutUnavailableTileLayer(srs::TileId tile_id, unsigned layer)
 {
-  m_received_height_tiles[tile_id] = data;
-  checkLoadedTile(tile_id);
+  if (!m_layers.isRequired(layer))
+    return;
+  if (layer == TileLayerRegistry::height && notifyAboutUnavailableSharedHeightTile(tile_id)) {
+    std::vector<srs::TileId> tiles_using_height_tile;
+    std::copy_if(m_core.pendingTiles().begin(), m_core.pendingTiles().end(), std::back_inserter(tiles_using_height_tile), [&](const auto& id) {
+      return heightTileId(id) == tile_id;
+    });
+    for (const auto& id : tiles_using_height_tile)
+      markTileUnavailable(id);
+    return;
+  }
+  markTileUnavailable(tile_id);
 }
 
-void SimplisticTileScheduler::notifyAboutUnavailableOrthoTile(srs::TileId tile_id)
+void SimplisticTileScheduler::markTileUnavailable(const srs::TileId& tile_id)
 {
-  m_unavaliable_tiles.insert(tile_id);
-  m_pending_tile_requests.erase(tile_id);
-  m_received_ortho_tiles.erase(tile_id);
-  m_received_height_tiles.erase(tile_id);
+  m_prefetcher.notifyAboutUnavailableTile(tile_id);
+  m_core.markTileUnavailable(context(), tile_id);
+  m_received_tiles.erase(tile_id);
 }
 
-void SimplisticTileScheduler::notifyAboutUnavailableHeightTile(srs::TileId tile_id)
+void SimplisticTileScheduler::checkLoadedTile(const srs::TileId& tile_id)
 {
-  m_unavaliable_tiles.insert(tile_id);
-  m_pending_tile_requests.erase(tile_id);
-  m_received_ortho_tiles.erase(tile_id);
-  m_received_height_tiles.erase(tile_id);
+  if (hasRequiredLayers(tile_id)) {
+    const auto tile = takeTile(tile_id);
+    m_tile_cache.insert(tile);
+    emitTileSignals(m_core.receiveTile(context(), tile));
+  }
 }
 
-void SimplisticTileScheduler::checkLoadedTile(const srs::TileId& tile_id)
+void SimplisticTileScheduler::receivePrefetchedTile(const std::shared_ptr<Tile>& tile)
 {
-  if (m_received_height_tiles.contains(tile_id) &m_received_ortho_tiles.contains(tile_id)) {
-    m_pending_tile_requests.erase(tile_id);
-    auto heightraster = tile_conversion::qImage2uint16Raster(tile_conversion::toQImage(*m_received_height_tiles[tile_id]));
-    auto ortho = tile_conversion::toQImage(*m_received_ortho_tiles[tile_id]);
-    const auto tile = std::make_shared<Tile>(tile_id, srs::tile_bounds(tile_id), std::move(heightraster), std::move(ortho));
-    m_received_ortho_tiles.erase(tile_id);
-    m_received_height_tiles.erase(tile_id);
+  // the tile is in the cache now. it's shipped only if it was requested in the meantime.
+  if (tile && m_core.isPending(tile->id))
+    emitTileSignals(m_core.receiveTile(context(), tile));
+}
 
-    const auto overlaps = [&tile_id](const auto& gpu_tile_id) { return srs::overlap(gpu_tile_id, tile_id); };
-    removeGpuTileIf(overlaps);
+bool SimplisticTileScheduler::isScheduled(const srs::TileId& tile_id) const
+{
+  return m_core.isPending(tile_id) || m_core.gpuTiles().contains(tile_id);
+}
 
-    m_gpu_tiles.insert(tile_id);
-    emit tileReady(tile);
-  }
+std::vector<srs::TileId> SimplisticTileScheduler::prefetchCandidates(const Camera& camera) const
+{
+  return tile_scheduler::visibleLeaves(camera, m_lod_policy->refineThreshold() * m_lod_policy->thresholdScale());
 }
 
 bool SimplisticTileScheduler::enabled() const
@@ -140,15 +177,3 @@ void SimplisticTileScheduler::setEnabled(bool newEnabled)
 {
   m_enabled = newEnabled;
 }
-
-template<typename Predicate>
-void SimplisticTileScheduler::removeGpuTileIf(Predicate condition)
-{
-  std::vector<srs::TileId> overlapping_tiles;
-  overlapping_tiles.reserve(4);
-  std::copy_if(m_gpu_tiles.cbegin(), m_gpu_tiles.cend(), std::back_inserter(overlapping_tiles), condition);
-  for (const auto& gpu_tile_id : overlapping_tiles) {
-    emit tileExpired(gpu_tile_id);
-    m_gpu_tiles.erase(gpu_tile_id);
-  }
-}
@@ -19,7 +19,9 @@
 #pragma once
 
 #include "alpine_renderer/TileScheduler.h"
+#include "alpine_renderer/tile_scheduler/SimplisticSchedulerCore.h"
 
+// adapter between the qt world (signals, slots, decoding, timers) and the SimplisticSchedulerCore
 class SimplisticTileScheduler : public TileScheduler
 {
   Q_OBJECT
@@ -28,28 +30,29 @@ public:
 
   [[nodiscard]] static std::vector<srs::TileId> loadCandidates(const Camera& camera) ;
   [[nodiscard]] size_t numberOfTilesInTransit() const override;
-  [[nodiscard]] size_t numberOfWaitingHeightTiles() const override;
-  [[nodiscard]] size_t numberOfWaitingOrthoTiles() const override;
   [[nodiscard]] TileSet gpuTiles() const override;
 
   bool enabled() const override;
   void setEnabled(bool newEnabled) override;
 
+protected:
+  bool isScheduled(const srs::TileId& tile_id) const override;
+  std::vector<srs::TileId> prefetchCandidates(const Camera& camera) const override;
+  void refinementFinished(const Camera& camera, const TimeSlicedRefinement& refinement) override;
+
 public slots:
   void updateCamera(const Camera& camera) override;
-  void receiveOrthoTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) override;
-  void receiveHeightTile(srs::TileId tile_id, std::shared_ptr<QByteArray> data) override;
-  void notifyAboutUnavailableOrthoTile(srs::TileId tile_id) override;
-  void notifyAboutUnavailableHeightTile(srs::TileId tile_id) override;
+  void receiveTileLayer(srs::TileId tile_id, unsigned layer, std::shared_ptr<QByteArray> data, QImage image = {}) override;
+  void notifyAboutUnavailableTileLayer(srs::TileId tile_id, unsigned layer) override;
 
 private:
+  [[nodiscard]] SimplisticSchedulerCore::Context context();
+  void updateTiles(const Camera& camera, std::vector<srs::TileId> tiles);
+  // emits the per tile signals (expired before ready). requests of tiles, that are prefetched already, are not emitted.
+  void emitTileSignals(const TileSetDelta& delta);
   void checkLoadedTile(const srs::TileId& tile_id);
-  template <typename Predicate>
-  void removeGpuTileIf(Predicate condition);
-  TileSet m_unavaliable_tiles;
-  TileSet m_pending_tile_requests;
-  TileSet m_gpu_tiles;
-  Tile2DataMap m_received_ortho_tiles;
-  Tile2DataMap m_received_height_tiles;
+  void markTileUnavailable(const srs::TileId& tile_id);
+  void receivePrefetchedTile(const std::shared_ptr<Tile>& tile);
+  SimplisticSchedulerCore m_core;
   bool m_enabled = true;
 };
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+
+#include "alpine_renderer/Tile.h"
+
+TileCache::TileCache(size_t byte_budget) : m_byte_budget(byte_budget)
+{
+}
+
+std::shared_ptr<Tile> TileCache::get(const srs::TileId& tile_id)
+{
+  const auto found = m_index.find(tile_id);
+  if (found == m_index.end()) {
+    m_statistics.misses++;
+    return {};
+  }
+  m_statistics.hits++;
+  m_tiles.splice(m_tiles.begin(), m_tiles, found->second);
+  return *found->second;
+}
+
+bool TileCache::contains(const srs::TileId& tile_id) const
+{
+  return m_index.contains(tile_id);
+}
+
+void TileCache::insert(const std::shared_ptr<Tile>& tile)
+{
+  assert(tile);
+  erase(tile->id);
+  m_tiles.push_front(tile);
+  m_index[tile->id] = m_tiles.begin();
+  m_size_in_bytes += sizeInBytes(*tile);
+  evict();
+}
+
+void TileCache::erase(const srs::TileId& tile_id)
+{
+  const auto found = m_index.find(tile_id);
+  if (found == m_index.end())
+    return;
+  m_size_in_bytes -= sizeInBytes(**found->second);
+  m_tiles.erase(found->second);
+  m_index.erase(found);
+}
+
+void TileCache::clear()
+{
+  m_tiles.clear();
+  m_index.clear();
+  m_size_in_bytes = 0;
+}
+
+size_t TileCache::byteBudget() const
+{
+  return m_byte_budget;
+}
+
+void TileCache::setByteBudget(size_t new_byte_budget)
+{
+  m_byte_budget = new_byte_budget;
+  evict();
+}
+
+size_t TileCache::sizeInBytes() const
+{
+  return m_size_in_bytes;
+}
+
+size_t TileCache::numberOfTiles() const
+{
+  return m_tiles.size();
+}
+
+const TileCache::Statistics& TileCache::statistics() const
+{
+  return m_statistics;
+}
+
+void TileCache::resetStatistics()
+{
+  m_statistics = {};
+}
+
+size_t TileCache::sizeInBytes(const Tile& tile)
+{
+  auto bytes = tile.height_map.bufferLength() * sizeof(uint16_t) + size_t(tile.orthotexture.sizeInBytes());
+  for (const auto& layer : tile.layers)
+    bytes += size_t(layer.second.sizeInBytes());
+  return bytes;
+}
+
+void TileCache::evict()
+{
+  while (m_size_in_bytes > m_byte_budget && !m_tiles.empty()) {
+    const auto& least_recently_used = m_tiles.back();
+    m_size_in_bytes -= sizeInBytes(*least_recently_used);
+    m_index.erase(least_recently_used->id);
+    m_tiles.pop_back();
+    m_statistics.evictions++;
+  }
+}
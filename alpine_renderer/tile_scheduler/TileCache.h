@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "alpine_renderer/srs.h"
+
+struct Tile;
+
+// least recently used cache for decoded tiles (height raster + ortho image).
+// the schedulers put every tile they decode in here and look it up before requesting a tile,
+// so that panning back and forth doesn't download and decode the same tiles over and over again.
+// the cache is bounded by the (cpu) memory of the held tiles, the least recently used tiles are dropped first.
+class TileCache
+{
+public:
+  struct Statistics {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    [[nodiscard]] double hitRate() const { return (hits + misses) ? double(hits) / double(hits + misses) : 0.0; }
+  };
+
+  explicit TileCache(size_t byte_budget = 256 * 1024 * 1024);
+
+  // returns nullptr, if the tile is not in the cache. counts towards the hit / miss statistics and marks the tile as recently used.
+  [[nodiscard]] std::shared_ptr<Tile> get(const srs::TileId& tile_id);
+  [[nodiscard]] bool contains(const srs::TileId& tile_id) const;
+  void insert(const std::shared_ptr<Tile>& tile);
+  void erase(const srs::TileId& tile_id);
+  void clear();
+
+  [[nodiscard]] size_t byteBudget() const;
+  void setByteBudget(size_t new_byte_budget);
+  [[nodiscard]] size_t sizeInBytes() const;
+  [[nodiscard]] size_t numberOfTiles() const;
+  [[nodiscard]] const Statistics& statistics() const;
+  void resetStatistics();
+
+  [[nodiscard]] static size_t sizeInBytes(const Tile& tile);
+
+private:
+  using TileList = std::list<std::shared_ptr<Tile>>;
+  void evict();
+
+  TileList m_tiles; // front is the most recently used tile
+  std::unordered_map<srs::TileId, TileList::iterator, srs::TileId::Hasher> m_index;
+  size_t m_byte_budget = 0;
+  size_t m_size_in_bytes = 0;
+  Statistics m_statistics;
+};
@@ -0,0 +1,160 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/TileLayers.h"
+
+#include <algorithm>
+
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/utils/tile_conversion.h"
+
+TileLayerRegistry::TileLayerRegistry()
+{
+  m_layers.push_back({"height", true});
+  m_layers.push_back({"ortho", true});
+}
+
+TileLayerRegistry::LayerId TileLayerRegistry::add(std::string name, bool required)
+{
+  m_layers.push_back({std::move(name), required});
+  return LayerId(m_layers.size() - 1);
+}
+
+const TileLayerRegistry::Layer& TileLayerRegistry::layer(LayerId id) const
+{
+  assert(id < m_layers.size());
+  return m_layers[id];
+}
+
+bool TileLayerRegistry::isRequired(LayerId id) const
+{
+  return layer(id).required;
+}
+
+size_t TileLayerRegistry::size() const
+{
+  return m_layers.size();
+}
+
+TileLayerBundles::TileLayerBundles(const TileLayerRegistry* registry) : m_registry(registry)
+{
+  assert(m_registry);
+}
+
+void TileLayerBundles::insert(const srs::TileId& tile_id, LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  assert(data);
+  assert(layer < m_registry->size());
+  auto& entry = m_bundles[tile_id];
+  // layers can be registered after the first tiles arrived
+  if (entry.bundle.size() < m_registry->size())
+    entry.bundle.resize(m_registry->size());
+  entry.bundle[layer] = data;
+  if (entry.images.size() < entry.bundle.size())
+    entry.images.resize(entry.bundle.size());
+  entry.images[layer] = image;
+}
+
+bool TileLayerBundles::contains(const srs::TileId& tile_id) const
+{
+  return m_bundles.contains(tile_id);
+}
+
+bool TileLayerBundles::contains(const srs::TileId& tile_id, LayerId layer) const
+{
+  const auto found = m_bundles.find(tile_id);
+  return found != m_bundles.end() && layer < found->second.bundle.size() && found->second.bundle[layer];
+}
+
+bool TileLayerBundles::hasRequiredLayers(const srs::TileId& tile_id, bool ignore_height) const
+{
+  const auto found = m_bundles.find(tile_id);
+  if (found == m_bundles.end())
+    return false;
+  const auto& bundle = found->second.bundle;
+  for (LayerId layer = 0; layer < m_registry->size(); ++layer) {
+    if (!m_registry->isRequired(layer) || (ignore_height && layer == TileLayerRegistry::height))
+      continue;
+    if (layer >= bundle.size() || !bundle[layer])
+      return false;
+  }
+  return true;
+}
+
+TileLayerBundles::Bundle TileLayerBundles::take(const srs::TileId& tile_id, Images* images)
+{
+  const auto found = m_bundles.find(tile_id);
+  if (found == m_bundles.end())
+    return {};
+  auto bundle = std::move(found->second.bundle);
+  if (images)
+    *images = std::move(found->second.images);
+  m_bundles.erase(found);
+  return bundle;
+}
+
+void TileLayerBundles::erase(const srs::TileId& tile_id)
+{
+  m_bundles.erase(tile_id);
+}
+
+void TileLayerBundles::clear()
+{
+  m_bundles.clear();
+}
+
+size_t TileLayerBundles::numberOfTiles() const
+{
+  return m_bundles.size();
+}
+
+size_t TileLayerBundles::numberOfTilesWith(LayerId layer) const
+{
+  return size_t(std::count_if(m_bundles.begin(), m_bundles.end(), [layer](const auto& entry) {
+    return layer < entry.second.bundle.size() && entry.second.bundle[layer];
+  }));
+}
+
+std::vector<srs::TileId> TileLayerBundles::tiles() const
+{
+  std::vector<srs::TileId> tiles;
+  tiles.reserve(m_bundles.size());
+  for (const auto& entry : m_bundles)
+    tiles.push_back(entry.first);
+  return tiles;
+}
+
+std::shared_ptr<Tile> TileLayerBundles::makeTile(const srs::TileId& tile_id, Raster<uint16_t> height_raster, const Bundle& bundle, const Images& images)
+{
+  assert(bundle.size() > TileLayerRegistry::ortho && bundle[TileLayerRegistry::ortho]);
+  auto ortho = image(bundle, images, TileLayerRegistry::ortho);
+  auto tile = std::make_shared<Tile>(tile_id, srs::tile_bounds(tile_id), std::move(height_raster), std::move(ortho));
+  for (LayerId layer = TileLayerRegistry::ortho + 1; layer < bundle.size(); ++layer) {
+    if (bundle[layer])
+      tile->layers[layer] = image(bundle, images, layer);
+  }
+  return tile;
+}
+
+QImage TileLayerBundles::image(const Bundle& bundle, const Images& images, LayerId layer)
+{
+  assert(layer < bundle.size() && bundle[layer]);
+  if (layer < images.size() && !images[layer].isNull())
+    return images[layer];
+  return tile_conversion::toQImage(*bundle[layer]);
+}
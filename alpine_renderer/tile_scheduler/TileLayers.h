@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+
+#include "alpine_renderer/Raster.h"
+#include "alpine_renderer/srs.h"
+
+struct Tile;
+
+// the data layers a tile is made of. height and ortho are always there (and required), further layers
+// (overlays like hillshade or snow cover) can be added. a tile is complete, when all required layers have arrived.
+// optional layers don't block shipping, they are shipped with the tile if they are there in time, or later on their own.
+class TileLayerRegistry
+{
+public:
+  using LayerId = unsigned;
+  static constexpr LayerId height = 0;
+  static constexpr LayerId ortho = 1;
+  struct Layer {
+    std::string name;
+    bool required = true;
+  };
+
+  TileLayerRegistry();
+
+  // returns the id of the new layer
+  LayerId add(std::string name, bool required);
+  [[nodiscard]] const Layer& layer(LayerId id) const;
+  [[nodiscard]] bool isRequired(LayerId id) const;
+  [[nodiscard]] size_t size() const;
+
+private:
+  std::vector<Layer> m_layers;
+};
+
+// data of the tiles, that are not complete yet. one entry per tile, holding all of its layers.
+class TileLayerBundles
+{
+public:
+  using LayerId = TileLayerRegistry::LayerId;
+  using Bundle = std::vector<std::shared_ptr<QByteArray>>; // indexed by layer id, nullptr for layers that didn't arrive (yet)
+  // layers, that were decoded already on arrival (e.g., by the tile source), indexed by layer id. null images for the others.
+  using Images = std::vector<QImage>;
+
+  explicit TileLayerBundles(const TileLayerRegistry* registry);
+
+  // the image has to be decoded from the data, if it is not null
+  void insert(const srs::TileId& tile_id, LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image = {});
+  [[nodiscard]] bool contains(const srs::TileId& tile_id) const;
+  [[nodiscard]] bool contains(const srs::TileId& tile_id, LayerId layer) const;
+  // true, if all required layers are there. ignore_height is for schedulers, that take the height from elsewhere.
+  [[nodiscard]] bool hasRequiredLayers(const srs::TileId& tile_id, bool ignore_height = false) const;
+  // removes the tile and returns its data (an empty bundle, if there was none). the images decoded on arrival go to images.
+  [[nodiscard]] Bundle take(const srs::TileId& tile_id, Images* images = nullptr);
+  void erase(const srs::TileId& tile_id);
+  void clear();
+  [[nodiscard]] size_t numberOfTiles() const;
+  [[nodiscard]] size_t numberOfTilesWith(LayerId layer) const;
+  [[nodiscard]] std::vector<srs::TileId> tiles() const;
+
+  // decodes ortho and the optional layers of the bundle. the height raster has to be decoded by the caller (it may come from another tile).
+  // layers, that were decoded on arrival, are not decoded again.
+  [[nodiscard]] static std::shared_ptr<Tile> makeTile(const srs::TileId& tile_id, Raster<uint16_t> height_raster, const Bundle& bundle, const Images& images = {});
+  // the image decoded on arrival, or the decoded data
+  [[nodiscard]] static QImage image(const Bundle& bundle, const Images& images, LayerId layer);
+
+private:
+  struct Entry {
+    Bundle bundle;
+    Images images;
+  };
+  const TileLayerRegistry* m_registry = nullptr;
+  std::unordered_map<srs::TileId, Entry, srs::TileId::Hasher> m_bundles;
+};
@@ -0,0 +1,184 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/TilePrefetcher.h"
+
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+#include "alpine_renderer/utils/tile_conversion.h"
+
+TilePrefetcher::TilePrefetcher(TileCache* tile_cache, const TileLayerRegistry* layers) : m_tile_cache(tile_cache), m_received_tiles(layers)
+{
+  assert(m_tile_cache);
+}
+
+bool TilePrefetcher::enabled() const
+{
+  return m_enabled;
+}
+
+void TilePrefetcher::setEnabled(bool new_enabled)
+{
+  m_enabled = new_enabled;
+}
+
+TilePrefetcher::Clock::duration TilePrefetcher::horizon() const
+{
+  return m_horizon;
+}
+
+void TilePrefetcher::setHorizon(Clock::duration new_horizon)
+{
+  m_horizon = new_horizon;
+}
+
+size_t TilePrefetcher::maxNumberOfTilesInFlight() const
+{
+  return m_max_number_of_tiles_in_flight;
+}
+
+void TilePrefetcher::setMaxNumberOfTilesInFlight(size_t new_max_number_of_tiles_in_flight)
+{
+  m_max_number_of_tiles_in_flight = new_max_number_of_tiles_in_flight;
+}
+
+bool TilePrefetcher::idlePrefetchEnabled() const
+{
+  return m_idle_prefetch_enabled;
+}
+
+void TilePrefetcher::setIdlePrefetchEnabled(bool new_enabled)
+{
+  m_idle_prefetch_enabled = new_enabled;
+}
+
+TilePrefetcher::Clock::duration TilePrefetcher::idleDelay() const
+{
+  return m_idle_delay;
+}
+
+void TilePrefetcher::setIdleDelay(Clock::duration new_idle_delay)
+{
+  m_idle_delay = new_idle_delay;
+}
+
+unsigned TilePrefetcher::idleRingLevels() const
+{
+  return m_idle_ring_levels;
+}
+
+void TilePrefetcher::setIdleRingLevels(unsigned new_idle_ring_levels)
+{
+  m_idle_ring_levels = new_idle_ring_levels;
+}
+
+size_t TilePrefetcher::idleByteBudget() const
+{
+  return m_idle_byte_budget;
+}
+
+void TilePrefetcher::setIdleByteBudget(size_t new_idle_byte_budget)
+{
+  m_idle_byte_budget = new_idle_byte_budget;
+}
+
+void TilePrefetcher::setTimeSource(TimeSource time_source)
+{
+  assert(time_source);
+  m_time_source = std::move(time_source);
+}
+
+CameraPredictor& TilePrefetcher::cameraPredictor()
+{
+  return m_camera_predictor;
+}
+
+const CameraPredictor& TilePrefetcher::cameraPredictor() const
+{
+  return m_camera_predictor;
+}
+
+const TilePrefetcher::Statistics& TilePrefetcher::statistics() const
+{
+  return m_statistics;
+}
+
+std::optional<Camera> TilePrefetcher::update(const Camera& camera)
+{
+  m_camera_predictor.addSample(camera, m_time_source());
+  if (!m_enabled)
+    return {};
+  // moving less than a metre within the horizon is standing still
+  const auto distance = glm::length(m_camera_predictor.velocity()) * std::chrono::duration<double>(m_horizon).count();
+  if (distance < 1.0)
+    return {};
+  return m_camera_predictor.predict(m_horizon);
+}
+
+bool TilePrefetcher::hasBudget() const
+{
+  return m_tiles_in_flight.size() < m_max_number_of_tiles_in_flight;
+}
+
+bool TilePrefetcher::request(const srs::TileId& tile_id)
+{
+  if (!hasBudget() || !m_tiles_in_flight.insert(tile_id).second)
+    return false;
+  m_statistics.requested++;
+  return true;
+}
+
+bool TilePrefetcher::isInFlight(const srs::TileId& tile_id) const
+{
+  return m_tiles_in_flight.contains(tile_id);
+}
+
+size_t TilePrefetcher::numberOfTilesInFlight() const
+{
+  return m_tiles_in_flight.size();
+}
+
+std::shared_ptr<Tile> TilePrefetcher::receiveTileLayer(const srs::TileId& tile_id, TileLayerRegistry::LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  assert(data);
+  m_received_tiles.insert(tile_id, layer, data, image);
+  return checkLoadedTile(tile_id);
+}
+
+void TilePrefetcher::notifyAboutUnavailableTile(const srs::TileId& tile_id)
+{
+  if (!m_tiles_in_flight.erase(tile_id))
+    return;
+  m_received_tiles.erase(tile_id);
+  m_statistics.unavailable++;
+}
+
+std::shared_ptr<Tile> TilePrefetcher::checkLoadedTile(const srs::TileId& tile_id)
+{
+  if (!m_received_tiles.hasRequiredLayers(tile_id))
+    return {};
+  TileLayerBundles::Images images;
+  const auto bundle = m_received_tiles.take(tile_id, &images);
+  auto heightraster = tile_conversion::qImage2uint16Raster(TileLayerBundles::image(bundle, images, TileLayerRegistry::height));
+  const auto tile = TileLayerBundles::makeTile(tile_id, std::move(heightraster), bundle, images);
+  m_tiles_in_flight.erase(tile_id);
+  m_tile_cache->insert(tile);
+  m_statistics.received++;
+  return tile;
+}
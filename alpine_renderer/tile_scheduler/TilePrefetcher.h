@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_set>
+
+#include <QByteArray>
+
+#include "alpine_renderer/srs.h"
+#include "alpine_renderer/tile_scheduler/CameraPredictor.h"
+#include "alpine_renderer/tile_scheduler/TileLayers.h"
+
+struct Tile;
+class TileCache;
+
+// bookkeeping for tiles, that are requested ahead of time for the camera predicted from the recent camera movement.
+// prefetches have their own budget (number of tiles in flight) and are requested at low priority.
+// prefetched tiles are decoded into the tile cache and not shipped. if a scheduler wants a tile, that is still in flight,
+// it doesn't request it a second time, but takes the decoded tile from receiveTileLayer.
+class TilePrefetcher
+{
+public:
+  using Clock = CameraPredictor::Clock;
+  using TimeSource = std::function<Clock::time_point()>;
+  using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+  struct Statistics {
+    size_t requested = 0;
+    size_t received = 0;
+    size_t unavailable = 0;
+  };
+
+  TilePrefetcher(TileCache* tile_cache, const TileLayerRegistry* layers);
+
+  [[nodiscard]] bool enabled() const;
+  void setEnabled(bool new_enabled);
+  // how far the camera movement is extrapolated
+  [[nodiscard]] Clock::duration horizon() const;
+  void setHorizon(Clock::duration new_horizon);
+  [[nodiscard]] size_t maxNumberOfTilesInFlight() const;
+  void setMaxNumberOfTilesInFlight(size_t new_max_number_of_tiles_in_flight);
+  // when the camera is still and no tiles are in transit (for the idle delay), a ring of tiles around the view is requested.
+  // the ring contains the tiles one or more levels coarser than the visible ones, and their neighbours. it's bounded by a byte budget.
+  [[nodiscard]] bool idlePrefetchEnabled() const;
+  void setIdlePrefetchEnabled(bool new_enabled);
+  [[nodiscard]] Clock::duration idleDelay() const;
+  void setIdleDelay(Clock::duration new_idle_delay);
+  [[nodiscard]] unsigned idleRingLevels() const;
+  void setIdleRingLevels(unsigned new_idle_ring_levels);
+  [[nodiscard]] size_t idleByteBudget() const;
+  void setIdleByteBudget(size_t new_idle_byte_budget);
+  // replaces the clock, e.g., for replaying recorded camera paths
+  void setTimeSource(TimeSource time_source);
+  [[nodiscard]] CameraPredictor& cameraPredictor();
+  [[nodiscard]] const CameraPredictor& cameraPredictor() const;
+  [[nodiscard]] const Statistics& statistics() const;
+
+  // records the camera. returns the predicted camera, if prefetching is enabled and the camera is moving.
+  [[nodiscard]] std::optional<Camera> update(const Camera& camera);
+  [[nodiscard]] bool hasBudget() const;
+  // marks the tile as in flight. returns false, if the budget is used up or the tile is in flight already.
+  bool request(const srs::TileId& tile_id);
+  [[nodiscard]] bool isInFlight(const srs::TileId& tile_id) const;
+  [[nodiscard]] size_t numberOfTilesInFlight() const;
+
+  // returns the decoded tile, once all required layers arrived (nullptr otherwise). the tile is put into the cache as well.
+  std::shared_ptr<Tile> receiveTileLayer(const srs::TileId& tile_id, TileLayerRegistry::LayerId layer, const std::shared_ptr<QByteArray>& data, const QImage& image = {});
+  void notifyAboutUnavailableTile(const srs::TileId& tile_id);
+
+private:
+  std::shared_ptr<Tile> checkLoadedTile(const srs::TileId& tile_id);
+
+  TileCache* m_tile_cache = nullptr;
+  CameraPredictor m_camera_predictor;
+  TimeSource m_time_source = []() { return Clock::now(); };
+  TileSet m_tiles_in_flight;
+  TileLayerBundles m_received_tiles;
+  Clock::duration m_horizon = std::chrono::milliseconds(300);
+  size_t m_max_number_of_tiles_in_flight = 32;
+  Clock::duration m_idle_delay = std::chrono::milliseconds(500);
+  unsigned m_idle_ring_levels = 2;
+  size_t m_idle_byte_budget = 32 * 1024 * 1024;
+  bool m_enabled = false;
+  bool m_idle_prefetch_enabled = false;
+  Statistics m_statistics;
+};
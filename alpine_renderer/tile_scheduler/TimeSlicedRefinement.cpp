@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/TimeSlicedRefinement.h"
+
+#include "alpine_renderer/tile_scheduler/utils.h"
+
+void TimeSlicedRefinement::start(const Camera& camera, RefinePredicate refine)
+{
+  assert(refine);
+  m_camera = camera;
+  m_camera_generation++;
+  m_refine = std::move(refine);
+  m_queue = {};
+  m_leaves.clear();
+  m_visible_leaves.clear();
+  m_inner_nodes.clear();
+  m_n_processed_tiles = 0;
+  push({0, {0, 0}});
+}
+
+void TimeSlicedRefinement::setCamera(const Camera& camera)
+{
+  assert(m_camera);
+  m_camera = camera;
+  m_camera_generation++;
+}
+
+bool TimeSlicedRefinement::run(Clock::time_point deadline)
+{
+  assert(started());
+  if (finished())
+    return true;
+  do {
+    processNext();
+  } while (!finished() && Clock::now() < deadline);
+  return finished();
+}
+
+void TimeSlicedRefinement::run()
+{
+  assert(started());
+  while (!finished())
+    processNext();
+}
+
+bool TimeSlicedRefinement::started() const
+{
+  return m_camera.has_value();
+}
+
+bool TimeSlicedRefinement::finished() const
+{
+  return started() && m_queue.empty();
+}
+
+size_t TimeSlicedRefinement::numberOfProcessedTiles() const
+{
+  return m_n_processed_tiles;
+}
+
+const std::vector<srs::TileId>& TimeSlicedRefinement::leaves() const
+{
+  return m_leaves;
+}
+
+const std::vector<srs::TileId>& TimeSlicedRefinement::visibleLeaves() const
+{
+  return m_visible_leaves;
+}
+
+const TimeSlicedRefinement::TileSet& TimeSlicedRefinement::innerNodes() const
+{
+  return m_inner_nodes;
+}
+
+void TimeSlicedRefinement::push(const srs::TileId& tile_id)
+{
+  m_queue.push({tile_scheduler::screenSpaceError(*m_camera, tile_id), tile_id, m_camera_generation});
+}
+
+void TimeSlicedRefinement::processNext()
+{
+  auto entry = m_queue.top();
+  m_queue.pop();
+  m_n_processed_tiles++;
+  // the error was computed for an older camera
+  if (entry.camera_generation != m_camera_generation)
+    entry.screen_space_error = tile_scheduler::screenSpaceError(*m_camera, entry.id);
+
+  if (m_refine(entry.id, entry.screen_space_error)) {
+    m_inner_nodes.insert(entry.id);
+    for (const auto& child : srs::subtiles(entry.id))
+      push(child);
+    return;
+  }
+  m_leaves.push_back(entry.id);
+  if (entry.screen_space_error > 0)
+    m_visible_leaves.push_back(entry.id);
+}
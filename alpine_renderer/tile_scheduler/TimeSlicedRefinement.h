@@ -0,0 +1,80 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "alpine_renderer/Camera.h"
+#include "alpine_renderer/srs.h"
+
+// refines the tile quad tree from the root for a camera, the tiles with the highest screen space error (closest to the view) first.
+// the traversal can be run in slices with a deadline, it resumes where it stopped. the camera can be replaced in between,
+// the remaining tiles are then refined for the new camera.
+class TimeSlicedRefinement
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+  // returns true, if the tile should be split into its children
+  using RefinePredicate = std::function<bool(const srs::TileId& tile_id, double screen_space_error)>;
+
+  // starts over at the root tile
+  void start(const Camera& camera, RefinePredicate refine);
+  void setCamera(const Camera& camera);
+  // processes tiles until the deadline passed (at least one). returns true, if the traversal is finished.
+  bool run(Clock::time_point deadline);
+  // runs until finished
+  void run();
+
+  [[nodiscard]] bool started() const;
+  [[nodiscard]] bool finished() const;
+  [[nodiscard]] size_t numberOfProcessedTiles() const;
+  // leaves in the order they were found, including those outside of the camera frustum
+  [[nodiscard]] const std::vector<srs::TileId>& leaves() const;
+  // leaves inside the camera frustum (screen space error > 0)
+  [[nodiscard]] const std::vector<srs::TileId>& visibleLeaves() const;
+  [[nodiscard]] const TileSet& innerNodes() const;
+
+private:
+  struct Entry {
+    double screen_space_error = 0;
+    srs::TileId id;
+    unsigned camera_generation = 0;
+  };
+  struct LowerError {
+    bool operator()(const Entry& a, const Entry& b) const { return a.screen_space_error < b.screen_space_error; }
+  };
+  void push(const srs::TileId& tile_id);
+  void processNext();
+
+  std::optional<Camera> m_camera;
+  unsigned m_camera_generation = 0;
+  RefinePredicate m_refine;
+  std::priority_queue<Entry, std::vector<Entry>, LowerError> m_queue;
+  std::vector<srs::TileId> m_leaves;
+  std::vector<srs::TileId> m_visible_leaves;
+  TileSet m_inner_nodes;
+  size_t m_n_processed_tiles = 0;
+};
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
+
+UnavailableTileCache::UnavailableTileCache(Clock::duration time_to_live, unsigned min_inheriting_zoom_level)
+    : m_time_to_live(time_to_live),
+      m_min_inheriting_zoom_level(min_inheriting_zoom_level)
+{
+}
+
+void UnavailableTileCache::insert(const srs::TileId& tile_id, Clock::time_point now)
+{
+  m_insertion_times[tile_id] = now;
+}
+
+bool UnavailableTileCache::contains(const srs::TileId& tile_id, Clock::time_point now) const
+{
+  if (m_insertion_times.empty())
+    return false;
+
+  const auto is_fresh = [&](const srs::TileId& id) {
+    const auto found = m_insertion_times.find(id);
+    return found != m_insertion_times.end() && now - found->second < m_time_to_live;
+  };
+  if (is_fresh(tile_id))
+    return true;
+
+  auto ancestor = tile_id;
+  while (ancestor.zoom_level > m_min_inheriting_zoom_level) {
+    ancestor = srs::parent(ancestor);
+    if (is_fresh(ancestor))
+      return true;
+  }
+  return false;
+}
+
+void UnavailableTileCache::removeExpired(Clock::time_point now)
+{
+  std::erase_if(m_insertion_times, [&](const auto& entry) { return now - entry.second >= m_time_to_live; });
+}
+
+void UnavailableTileCache::clear()
+{
+  m_insertion_times.clear();
+}
+
+size_t UnavailableTileCache::size() const
+{
+  return m_insertion_times.size();
+}
+
+UnavailableTileCache::Clock::duration UnavailableTileCache::timeToLive() const
+{
+  return m_time_to_live;
+}
+
+void UnavailableTileCache::setTimeToLive(Clock::duration new_time_to_live)
+{
+  m_time_to_live = new_time_to_live;
+}
+
+unsigned UnavailableTileCache::minInheritingZoomLevel() const
+{
+  return m_min_inheriting_zoom_level;
+}
+
+void UnavailableTileCache::setMinInheritingZoomLevel(unsigned new_min_inheriting_zoom_level)
+{
+  m_min_inheriting_zoom_level = new_min_inheriting_zoom_level;
+}
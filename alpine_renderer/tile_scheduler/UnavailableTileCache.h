@@ -0,0 +1,54 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <unordered_map>
+
+#include "alpine_renderer/srs.h"
+
+// remembers tiles, that the tile servers reported as unavailable, for a limited time (the time to live).
+// descendants of unavailable tiles are treated as unavailable as well, a query walks up the ancestors and is therefore O(depth).
+// tile servers often don't serve the coarsest zoom levels although they serve the finer ones, therefore
+// only unavailable tiles on or above min_inheriting_zoom_level are inherited by their descendants.
+// the cache lives outside of the scheduler trees, so the information survives reductions of the tree.
+class UnavailableTileCache
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit UnavailableTileCache(Clock::duration time_to_live = std::chrono::minutes(10), unsigned min_inheriting_zoom_level = 8);
+
+  void insert(const srs::TileId& tile_id, Clock::time_point now = Clock::now());
+  [[nodiscard]] bool contains(const srs::TileId& tile_id, Clock::time_point now = Clock::now()) const;
+  // entries are not removed on expiry automatically, call this from time to time to free the memory
+  void removeExpired(Clock::time_point now = Clock::now());
+  void clear();
+  [[nodiscard]] size_t size() const;
+
+  [[nodiscard]] Clock::duration timeToLive() const;
+  void setTimeToLive(Clock::duration new_time_to_live);
+  [[nodiscard]] unsigned minInheritingZoomLevel() const;
+  void setMinInheritingZoomLevel(unsigned new_min_inheriting_zoom_level);
+
+private:
+  std::unordered_map<srs::TileId, Clock::time_point, srs::TileId::Hasher> m_insertion_times;
+  Clock::duration m_time_to_live;
+  unsigned m_min_inheriting_zoom_level;
+};
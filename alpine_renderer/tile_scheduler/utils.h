@@ -18,9 +18,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "alpine_renderer/Camera.h"
 #include "alpine_renderer/srs.h"
 #include "alpine_renderer/utils/geometry.h"
+#include "alpine_renderer/utils/QuadTree.h"
 
 
 namespace tile_scheduler {
@@ -51,30 +58,126 @@ inline auto cameraFrustumContainsTile(const Camera& camera, const srs::TileId& t
   return true;
 }
 
+// size of a tile pixel on screen (in screen pixels) at the point of the tile, that is nearest to the camera.
+// tiles outside of the camera frustum have an error of 0.
+inline double screenSpaceError(const Camera& camera, const srs::TileId& tile, double tile_size = 256) {
+  const auto tile_aabb = srs::aabb(tile, 100, 4000);
+  const auto triangles = geometry::clip(geometry::triangulise(tile_aabb), camera.clippingPlanes());
+  if (triangles.empty())
+    return 0;
+  const auto nearest_point = glm::dvec4(nearestVertex(camera, triangles), 1);
+  const auto aabb_width = tile_aabb.max.x - tile_aabb.min.x;
+  const auto other_point_axis = camera.xAxis();
+  const auto other_point = nearest_point + glm::dvec4(other_point_axis * aabb_width / tile_size, 0);
+  const auto vp_mat = camera.worldViewProjectionMatrix();
+
+  auto nearest_screenspace = vp_mat * nearest_point;
+  nearest_screenspace /= nearest_screenspace.w;
+  auto other_screenspace = vp_mat * other_point;
+  other_screenspace /= other_screenspace.w;
+  const auto clip_space_difference = length((nearest_screenspace - other_screenspace).xy());
+
+  return clip_space_difference * 0.5 * camera.viewportSize().x;
+}
+
 inline auto refineFunctor(const Camera& camera, double error_threshold_px = 4.0, double tile_size = 256) {
   const auto refine = [&camera, error_threshold_px, tile_size](const srs::TileId& tile) {
     if (tile.zoom_level >= 16)
       return false;
-
-    const auto tile_aabb = srs::aabb(tile, 100, 4000);
-    const auto triangles = geometry::clip(geometry::triangulise(tile_aabb), camera.clippingPlanes());
-    if (triangles.empty())
-      return false;
-    const auto nearest_point = glm::dvec4(nearestVertex(camera, triangles), 1);
-    const auto aabb_width = tile_aabb.max.x - tile_aabb.min.x;
-    const auto other_point_axis = camera.xAxis();
-    const auto other_point = nearest_point + glm::dvec4(other_point_axis * aabb_width / tile_size, 0);
-    const auto vp_mat = camera.worldViewProjectionMatrix();
-
-    auto nearest_screenspace = vp_mat * nearest_point;
-    nearest_screenspace /= nearest_screenspace.w;
-    auto other_screenspace = vp_mat * other_point;
-    other_screenspace /= other_screenspace.w;
-    const auto clip_space_difference = length((nearest_screenspace - other_screenspace).xy());
-
-    return clip_space_difference * 0.5 * camera.viewportSize().x >= error_threshold_px;
+    return screenSpaceError(camera, tile, tile_size) >= error_threshold_px;
   };
   return refine;
 }
 
+// leaves of the refinement for the camera, that are inside the camera frustum
+inline std::vector<srs::TileId> visibleLeaves(const Camera& camera, double error_threshold_px) {
+  const auto all_leaves = quad_tree::onTheFlyTraverse(srs::TileId{0, {0, 0}}, refineFunctor(camera, error_threshold_px), [](const auto& v) { return srs::subtiles(v); });
+  std::vector<srs::TileId> visible_leaves;
+  visible_leaves.reserve(all_leaves.size());
+  std::copy_if(all_leaves.begin(), all_leaves.end(), std::back_inserter(visible_leaves), [&camera](const srs::TileId& tile) {
+    return cameraFrustumContainsTile(camera, tile);
+  });
+  return visible_leaves;
+}
+
+// replaces the leaves by their ancestors on the levels, that are not skipped (see LodPolicy::skipLevels). the order is kept.
+// duplicates are removed, and so are tiles, that are covered by a coarser one in the result (the leaves were on different levels).
+template <typename SkipFunction>
+std::vector<srs::TileId> skipLevels(const std::vector<srs::TileId>& leaves, const SkipFunction& skip_levels) {
+  std::unordered_set<srs::TileId, srs::TileId::Hasher> tile_set;
+  std::vector<srs::TileId> tiles;
+  tiles.reserve(leaves.size());
+  for (const auto& leaf : leaves) {
+    const auto tile = skip_levels(leaf);
+    if (tile_set.insert(tile).second)
+      tiles.push_back(tile);
+  }
+  const auto covered_by_coarser_tile = [&tile_set](const srs::TileId& tile) {
+    for (auto ancestor = tile; ancestor.zoom_level > 0;) {
+      ancestor = srs::parent(ancestor);
+      if (tile_set.contains(ancestor))
+        return true;
+    }
+    return false;
+  };
+  tiles.erase(std::remove_if(tiles.begin(), tiles.end(), covered_by_coarser_tile), tiles.end());
+  return tiles;
+}
+
+// merges leaves into their parents until there are at most max_n_tiles leaves left (or the root is reached).
+// parents with a lower importance are merged first, e.g., use the screen space error as importance.
+// leaves must not overlap. not all siblings need to be present (e.g., when leaves outside the view were culled).
+template <typename ImportanceFunction>
+std::vector<srs::TileId> coarsenLeaves(const std::vector<srs::TileId>& leaves, size_t max_n_tiles, const ImportanceFunction& importance) {
+  using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+  TileSet current_leaves(leaves.begin(), leaves.end());
+  if (current_leaves.size() <= max_n_tiles)
+    return leaves;
+
+  // number of leaves below each inner node. a parent can be merged only if none of its children is an inner node.
+  std::unordered_map<srs::TileId, int, srs::TileId::Hasher> n_leaves_below;
+  const auto update_ancestors = [&](srs::TileId tile, int delta) {
+    while (tile.zoom_level > 0) {
+      tile = srs::parent(tile);
+      n_leaves_below[tile] += delta;
+    }
+  };
+  for (const auto& leaf : current_leaves)
+    update_ancestors(leaf, 1);
+  const auto is_inner_node = [&](const srs::TileId& tile) {
+    const auto found = n_leaves_below.find(tile);
+    return found != n_leaves_below.end() && found->second > 0;
+  };
+
+  using Candidate = std::pair<double, srs::TileId>;
+  const auto less_important_first = [](const Candidate& a, const Candidate& b) { return a.first > b.first; };
+  std::priority_queue<Candidate, std::vector<Candidate>, decltype(less_important_first)> candidates(less_important_first);
+  TileSet queued;
+  for (const auto& leaf : current_leaves) {
+    if (leaf.zoom_level == 0)
+      continue;
+    const auto parent = srs::parent(leaf);
+    if (queued.insert(parent).second)
+      candidates.emplace(importance(parent), parent);
+  }
+
+  while (current_leaves.size() > max_n_tiles && !candidates.empty()) {
+    const auto parent = candidates.top().second;
+    candidates.pop();
+    queued.erase(parent);
+    const auto children = srs::subtiles(parent);
+    if (std::any_of(children.begin(), children.end(), is_inner_node))
+      continue; // will be queued again, once the inner children are merged
+    for (const auto& child : children) {
+      if (current_leaves.erase(child))
+        update_ancestors(child, -1);
+    }
+    current_leaves.insert(parent);
+    update_ancestors(parent, 1);
+    if (parent.zoom_level > 0 && queued.insert(srs::parent(parent)).second)
+      candidates.emplace(importance(srs::parent(parent)), srs::parent(parent));
+  }
+  return {current_leaves.begin(), current_leaves.end()};
+}
+
 }
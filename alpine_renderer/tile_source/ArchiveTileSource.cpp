@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/ArchiveTileSource.h"
+
+#include "alpine_renderer/TileArchive.h"
+
+ArchiveTileSource::ArchiveTileSource(std::shared_ptr<const TileArchive> archive)
+    : m_archive(std::move(archive))
+{
+  assert(m_archive);
+}
+
+std::shared_ptr<QByteArray> ArchiveTileSource::tile(const std::shared_ptr<const TileArchive>& archive, const srs::TileId& tile_id)
+{
+  if (!archive->contains(tile_id))
+    return {};
+  return std::shared_ptr<QByteArray>(new QByteArray(archive->tile(tile_id)), [archive](QByteArray* data) { delete data; });
+}
+
+void ArchiveTileSource::load(const srs::TileId& tile_id)
+{
+  if (auto data = tile(m_archive, tile_id)) {
+    deliver(tile_id, std::move(data));
+    return;
+  }
+  deliverUnavailable(tile_id);
+}
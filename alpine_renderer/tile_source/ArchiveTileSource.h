@@ -0,0 +1,41 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include "alpine_renderer/TileSource.h"
+
+class TileArchive;
+
+// tiles in a (memory mapped) TileArchive. read-only.
+class ArchiveTileSource : public TileSource
+{
+  Q_OBJECT
+public:
+  explicit ArchiveTileSource(std::shared_ptr<const TileArchive> archive);
+
+  [[nodiscard]] const std::shared_ptr<const TileArchive>& archive() const { return m_archive; }
+  // the tile without copying, the data keeps the archive alive. nullptr, if it is not in the archive.
+  [[nodiscard]] static std::shared_ptr<QByteArray> tile(const std::shared_ptr<const TileArchive>& archive, const srs::TileId& tile_id);
+
+public slots:
+  void load(const srs::TileId& tile_id) override;
+
+private:
+  std::shared_ptr<const TileArchive> m_archive;
+};
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/CircuitBreaker.h"
+
+CircuitBreaker::CircuitBreaker(unsigned failure_threshold, Clock::duration open_duration)
+    : m_failure_threshold(failure_threshold),
+      m_open_duration(open_duration)
+{
+}
+
+bool CircuitBreaker::allowRequest(Clock::time_point now)
+{
+  switch (state(now)) {
+  case State::Closed:
+    return true;
+  case State::Open:
+    return false;
+  case State::HalfOpen:
+    if (m_probe_in_flight)
+      return false;
+    m_probe_in_flight = true;
+    return true;
+  }
+  return true;
+}
+
+void CircuitBreaker::recordSuccess(Clock::time_point sent)
+{
+  if (isLate(sent))
+    return;
+  m_consecutive_failures = 0;
+  m_open = false;
+  m_probe_in_flight = false;
+}
+
+void CircuitBreaker::recordFailure(Clock::time_point sent, Clock::time_point now)
+{
+  if (isLate(sent))
+    return;
+  m_consecutive_failures++;
+  m_probe_in_flight = false;
+  // a failed probe opens it again
+  if (m_open || (m_failure_threshold > 0 && m_consecutive_failures >= m_failure_threshold)) {
+    m_open = true;
+    m_opened_at = now;
+  }
+}
+
+CircuitBreaker::Clock::duration CircuitBreaker::timeUntilHalfOpen(Clock::time_point now) const
+{
+  if (state(now) != State::Open)
+    return Clock::duration::zero();
+  return m_opened_at + m_open_duration - now;
+}
+
+bool CircuitBreaker::isLate(Clock::time_point sent) const
+{
+  // only the probe is sent while it is open, and not before the open duration has passed
+  return m_open && sent - m_opened_at < m_open_duration;
+}
+
+CircuitBreaker::State CircuitBreaker::state(Clock::time_point now) const
+{
+  if (!m_open)
+    return State::Closed;
+  if (now - m_opened_at < m_open_duration)
+    return State::Open;
+  return State::HalfOpen;
+}
@@ -0,0 +1,59 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+
+// stops sending requests to a server, that keeps failing (open), and tries again after a while with a single request (half open).
+// a success closes the breaker again, a failure in the half open state opens it for another period. while it is open, answers to
+// requests, that were sent before it opened, are ignored: only the probe decides.
+class CircuitBreaker
+{
+public:
+  using Clock = std::chrono::steady_clock;
+  enum class State { Closed, Open, HalfOpen };
+
+  // a failure threshold of 0 never opens the breaker
+  explicit CircuitBreaker(unsigned failure_threshold = 8, Clock::duration open_duration = std::chrono::seconds(15));
+
+  // false, if the request shouldn't be sent. in the half open state, only one request (the probe) is allowed until it is answered.
+  [[nodiscard]] bool allowRequest(Clock::time_point now = Clock::now());
+  // sent is the time, when the answered request was sent
+  void recordSuccess(Clock::time_point sent);
+  void recordFailure(Clock::time_point sent, Clock::time_point now = Clock::now());
+
+  [[nodiscard]] State state(Clock::time_point now = Clock::now()) const;
+  // 0, unless it is open
+  [[nodiscard]] Clock::duration timeUntilHalfOpen(Clock::time_point now = Clock::now()) const;
+  [[nodiscard]] bool probeInFlight() const { return m_probe_in_flight; }
+  [[nodiscard]] unsigned consecutiveFailures() const { return m_consecutive_failures; }
+  [[nodiscard]] unsigned failureThreshold() const { return m_failure_threshold; }
+  [[nodiscard]] Clock::duration openDuration() const { return m_open_duration; }
+
+private:
+  // the answer to a request, that was sent before it opened
+  [[nodiscard]] bool isLate(Clock::time_point sent) const;
+
+  unsigned m_failure_threshold;
+  Clock::duration m_open_duration;
+  unsigned m_consecutive_failures = 0;
+  bool m_open = false;
+  bool m_probe_in_flight = false;
+  Clock::time_point m_opened_at;
+};
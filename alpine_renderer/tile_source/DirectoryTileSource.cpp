@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/DirectoryTileSource.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+DirectoryTileSource::DirectoryTileSource(const QString& directory, UrlPattern url_pattern, const QString& file_ending)
+    : m_directory(directory),
+      m_url_pattern(url_pattern),
+      m_file_ending(file_ending)
+{
+}
+
+QString DirectoryTileSource::filePath(const srs::TileId& tile_id) const
+{
+  return m_directory + "/" + tileAddress(tile_id, m_url_pattern) + m_file_ending;
+}
+
+void DirectoryTileSource::store(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data)
+{
+  const auto path = filePath(tile_id);
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || file.write(*data) != data->size() || !file.commit())
+    qWarning() << "Could not store tile in" << path;
+}
+
+void DirectoryTileSource::load(const srs::TileId& tile_id)
+{
+  QFile file(filePath(tile_id));
+  if (!file.open(QIODevice::ReadOnly)) {
+    deliverUnavailable(tile_id);
+    return;
+  }
+  deliver(tile_id, std::make_shared<QByteArray>(file.readAll()));
+}
@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include "alpine_renderer/TileSource.h"
+
+// tiles as files in a local directory tree (<directory>/<tile address><file ending>), e.g., a copied tile server tree.
+// tiles stored from a fallback chain are written to the tree.
+class DirectoryTileSource : public TileSource
+{
+  Q_OBJECT
+public:
+  DirectoryTileSource(const QString& directory, UrlPattern url_pattern, const QString& file_ending);
+
+  [[nodiscard]] QString filePath(const srs::TileId& tile_id) const;
+  // written to a temporary file, which is renamed once complete
+  void store(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data) override;
+
+public slots:
+  // reads the file in the caller's thread
+  void load(const srs::TileId& tile_id) override;
+
+private:
+  QString m_directory;
+  UrlPattern m_url_pattern;
+  QString m_file_ending;
+};
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/FallbackTileSource.h"
+
+FallbackTileSource::FallbackTileSource(std::vector<std::shared_ptr<TileSource>> sources)
+    : m_sources(std::move(sources))
+{
+  for (size_t i = 0; i < m_sources.size(); ++i) {
+    connect(m_sources[i].get(), &TileSource::loadReady, this, [this, i](srs::TileId tile_id, std::shared_ptr<QByteArray> data) { receiveTile(i, tile_id, data); });
+    connect(m_sources[i].get(), &TileSource::imageReady, this, [this, i](srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image) { receiveTile(i, tile_id, data, image); });
+    connect(m_sources[i].get(), &TileSource::tileUnavailable, this, [this, i](srs::TileId tile_id) { notifyAboutUnavailableTile(i, tile_id); });
+  }
+}
+
+void FallbackTileSource::load(const srs::TileId& tile_id)
+{
+  request(tile_id, false);
+}
+
+void FallbackTileSource::prefetch(const srs::TileId& tile_id)
+{
+  request(tile_id, true);
+}
+
+void FallbackTileSource::request(const srs::TileId& tile_id, bool prefetch)
+{
+  if (m_sources.empty()) {
+    deliverUnavailable(tile_id);
+    return;
+  }
+  const auto [running, inserted] = m_requests.try_emplace(tile_id, Request{0, prefetch});
+  if (!inserted) {
+    // answered once for both. a prefetch, that is needed now, keeps its priority in the source, that has it at the moment.
+    running->second.prefetch = running->second.prefetch && prefetch;
+    return;
+  }
+  ask(tile_id, running->second);
+}
+
+void FallbackTileSource::ask(const srs::TileId& tile_id, const Request& request)
+{
+  if (request.prefetch)
+    m_sources[request.source]->prefetch(tile_id);
+  else
+    m_sources[request.source]->load(tile_id);
+}
+
+void FallbackTileSource::receiveTile(size_t source, const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image)
+{
+  // answers to requests, that didn't come from the chain, are ignored
+  const auto running = m_requests.find(tile_id);
+  if (running == m_requests.end() || running->second.source != source)
+    return;
+  m_requests.erase(running);
+  for (size_t i = 0; i < source; ++i)
+    m_sources[i]->store(tile_id, data);
+  if (image.isNull())
+    emit loadReady(tile_id, data);
+  else
+    emit imageReady(tile_id, data, image);
+}
+
+void FallbackTileSource::notifyAboutUnavailableTile(size_t source, const srs::TileId& tile_id)
+{
+  const auto running = m_requests.find(tile_id);
+  if (running == m_requests.end() || running->second.source != source)
+    return;
+  if (source + 1 == m_sources.size()) {
+    m_requests.erase(running);
+    emit tileUnavailable(tile_id);
+    return;
+  }
+  running->second.source++;
+  ask(tile_id, running->second);
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "alpine_renderer/TileSource.h"
+
+// asks the sources one after the other (e.g., memory -> disk -> network), until one of them has the tile.
+// the tile is then stored in the sources, that didn't have it. the sources have to live in the same thread as the chain.
+// decoded tiles (imageReady) are passed on decoded.
+class FallbackTileSource : public TileSource
+{
+  Q_OBJECT
+public:
+  explicit FallbackTileSource(std::vector<std::shared_ptr<TileSource>> sources);
+
+  [[nodiscard]] const std::vector<std::shared_ptr<TileSource>>& sources() const { return m_sources; }
+  [[nodiscard]] size_t numberOfTilesInFlight() const { return m_requests.size(); }
+
+public slots:
+  void load(const srs::TileId& tile_id) override;
+  void prefetch(const srs::TileId& tile_id) override;
+
+private:
+  struct Request {
+    size_t source = 0; // the one, that is asked at the moment
+    bool prefetch = false;
+  };
+  void request(const srs::TileId& tile_id, bool prefetch);
+  void ask(const srs::TileId& tile_id, const Request& request);
+  void receiveTile(size_t source, const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data, const QImage& image = {});
+  void notifyAboutUnavailableTile(size_t source, const srs::TileId& tile_id);
+
+  std::vector<std::shared_ptr<TileSource>> m_sources;
+  std::unordered_map<srs::TileId, Request, srs::TileId::Hasher> m_requests;
+};
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/MemoryTileSource.h"
+
+MemoryTileSource::MemoryTileSource(size_t byte_budget)
+    : m_byte_budget(byte_budget)
+{
+}
+
+void MemoryTileSource::insert(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data)
+{
+  assert(data);
+  erase(tile_id);
+  m_size_in_bytes += size_t(data->size());
+  m_tiles.emplace_front(tile_id, std::move(data));
+  m_index[tile_id] = m_tiles.begin();
+  evict();
+}
+
+bool MemoryTileSource::contains(const srs::TileId& tile_id) const
+{
+  return m_index.contains(tile_id);
+}
+
+void MemoryTileSource::erase(const srs::TileId& tile_id)
+{
+  const auto found = m_index.find(tile_id);
+  if (found == m_index.end())
+    return;
+  m_size_in_bytes -= size_t(found->second->second->size());
+  m_tiles.erase(found->second);
+  m_index.erase(found);
+}
+
+void MemoryTileSource::clear()
+{
+  m_tiles.clear();
+  m_index.clear();
+  m_size_in_bytes = 0;
+}
+
+void MemoryTileSource::store(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data)
+{
+  insert(tile_id, data);
+}
+
+void MemoryTileSource::load(const srs::TileId& tile_id)
+{
+  const auto found = m_index.find(tile_id);
+  if (found == m_index.end()) {
+    deliverUnavailable(tile_id);
+    return;
+  }
+  m_tiles.splice(m_tiles.begin(), m_tiles, found->second);
+  deliver(tile_id, found->second->second);
+}
+
+void MemoryTileSource::evict()
+{
+  while (m_size_in_bytes > m_byte_budget && !m_tiles.empty()) {
+    m_size_in_bytes -= size_t(m_tiles.back().second->size());
+    m_index.erase(m_tiles.back().first);
+    m_tiles.pop_back();
+  }
+}
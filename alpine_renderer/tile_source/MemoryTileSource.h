@@ -0,0 +1,56 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <limits>
+#include <list>
+#include <unordered_map>
+
+#include "alpine_renderer/TileSource.h"
+
+// tiles held in memory, e.g., as the first stage of a fallback chain or to feed schedulers in tests and benchmarks
+// without network. bounded by the size of the tiles, the least recently used ones are dropped first (unbounded by default).
+class MemoryTileSource : public TileSource
+{
+  Q_OBJECT
+public:
+  explicit MemoryTileSource(size_t byte_budget = std::numeric_limits<size_t>::max());
+
+  void insert(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data);
+  [[nodiscard]] bool contains(const srs::TileId& tile_id) const;
+  void erase(const srs::TileId& tile_id);
+  void clear();
+  [[nodiscard]] size_t numberOfTiles() const { return m_tiles.size(); }
+  [[nodiscard]] size_t sizeInBytes() const { return m_size_in_bytes; }
+  [[nodiscard]] size_t byteBudget() const { return m_byte_budget; }
+
+  void store(const srs::TileId& tile_id, const std::shared_ptr<QByteArray>& data) override;
+
+public slots:
+  void load(const srs::TileId& tile_id) override;
+
+private:
+  using TileList = std::list<std::pair<srs::TileId, std::shared_ptr<QByteArray>>>;
+  void evict();
+
+  TileList m_tiles; // front is the most recently used tile
+  std::unordered_map<srs::TileId, TileList::iterator, srs::TileId::Hasher> m_index;
+  size_t m_byte_budget;
+  size_t m_size_in_bytes = 0;
+};
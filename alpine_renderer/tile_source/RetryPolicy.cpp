@@ -0,0 +1,30 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/RetryPolicy.h"
+
+#include <algorithm>
+#include <cmath>
+
+RetryPolicy::Duration RetryPolicy::backoff(unsigned attempt, double random) const
+{
+  const auto max = double(max_backoff.count());
+  const auto exponential = std::min(max, double(initial_backoff.count()) * std::pow(backoff_factor, double(attempt)));
+  const auto jittered = exponential * (1.0 - std::clamp(jitter, 0.0, 1.0) * std::clamp(random, 0.0, 1.0));
+  return Duration(std::llround(jittered));
+}
@@ -0,0 +1,37 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <chrono>
+
+// when and how often failed tile downloads are tried again.
+// the backoff grows exponentially with the attempt and is jittered, so that the retries of many tiles don't arrive at the server at once.
+struct RetryPolicy {
+  using Duration = std::chrono::milliseconds;
+
+  unsigned max_retries = 3; // 0 disables retrying
+  Duration initial_backoff = Duration(250);
+  double backoff_factor = 2.0;
+  Duration max_backoff = Duration(8000);
+  // 0: no jitter, 1: the backoff is drawn from [0, backoff]
+  double jitter = 0.5;
+
+  // attempt 0 is the first retry. random has to be in [0, 1].
+  [[nodiscard]] Duration backoff(unsigned attempt, double random) const;
+};
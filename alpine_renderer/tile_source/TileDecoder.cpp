@@ -0,0 +1,47 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_source/TileDecoder.h"
+
+#include "alpine_renderer/utils/tile_conversion.h"
+
+TileDecoder::TileDecoder()
+{
+  m_thread.setObjectName("tile decoder");
+  m_context.moveToThread(&m_thread);
+  m_thread.start();
+}
+
+TileDecoder::~TileDecoder()
+{
+  // pending tiles are dropped
+  m_thread.quit();
+  m_thread.wait();
+}
+
+void TileDecoder::decode(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data)
+{
+  assert(data);
+  m_n_pending++;
+  QMetaObject::invokeMethod(&m_context, [this, tile_id, data = std::move(data)]() {
+    auto image = tile_conversion::toQImage(*data);
+    m_n_pending--;
+    emit decoded(tile_id, data, std::move(image));
+  });
+}
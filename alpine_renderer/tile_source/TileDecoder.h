@@ -0,0 +1,54 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <QByteArray>
+#include <QImage>
+#include <QObject>
+#include <QThread>
+
+#include "alpine_renderer/srs.h"
+
+// decodes encoded tiles (png, jpeg) in its own thread, e.g., while further tiles are still downloading.
+// the tiles are decoded in the order, in which they were given to it.
+class TileDecoder : public QObject
+{
+  Q_OBJECT
+public:
+  TileDecoder();
+  ~TileDecoder() override;
+
+  // thread safe
+  void decode(const srs::TileId& tile_id, std::shared_ptr<QByteArray> data);
+  // given to decode, but not emitted yet
+  [[nodiscard]] size_t numberOfPendingTiles() const { return m_n_pending; }
+
+signals:
+  // emitted in the decoder thread, receivers in other threads get it queued. the image is null, if the data can't be decoded.
+  void decoded(srs::TileId tile_id, std::shared_ptr<QByteArray> data, QImage image);
+
+private:
+  QThread m_thread;
+  QObject m_context; // lives in m_thread, the tiles are queued to it
+  std::atomic<size_t> m_n_pending = 0;
+};
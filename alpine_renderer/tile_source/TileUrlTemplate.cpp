@@ -0,0 +1,134 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/TileUrlTemplate.h"
+
+TileUrlTemplate::TileUrlTemplate(const QString& url_template, const QStringList& subdomains)
+    : m_url_template(url_template),
+      m_subdomains(subdomains),
+      m_error()
+{
+  if (url_template.isEmpty()) {
+    m_error = "empty url template";
+    return;
+  }
+  // parsed once, url() is called for every request
+  qsizetype position = 0;
+  while (position < url_template.size()) {
+    const auto open = url_template.indexOf("{", position);
+    if (open < 0) {
+      m_parts.push_back({url_template.mid(position), Placeholder::None});
+      break;
+    }
+    const auto close = url_template.indexOf("}", open);
+    if (close < 0) {
+      m_error = "unclosed placeholder in " + url_template;
+      return;
+    }
+    const auto name = url_template.mid(open + 1, close - open - 1);
+    Part part = {url_template.mid(position, open - position), Placeholder::None};
+    if (name == "z")
+      part.placeholder = Placeholder::Zoom;
+    else if (name == "x")
+      part.placeholder = Placeholder::X;
+    else if (name == "y")
+      part.placeholder = Placeholder::Y;
+    else if (name == "-y")
+      part.placeholder = Placeholder::YPointingSouth;
+    else if (name == "q")
+      part.placeholder = Placeholder::Quadkey;
+    else if (name == "s" && !subdomains.isEmpty())
+      part.placeholder = Placeholder::Subdomain;
+    else {
+      m_error = "unknown placeholder {" + name + "} in " + url_template;
+      return;
+    }
+    m_parts.push_back(part);
+    position = close + 1;
+  }
+}
+
+TileUrlTemplate TileUrlTemplate::fromPattern(const QString& base_url, TileSource::UrlPattern url_pattern, const QString& file_ending)
+{
+  if (base_url.isEmpty())
+    return {};
+  switch (url_pattern) {
+  case TileSource::UrlPattern::ZXY:
+    return TileUrlTemplate(base_url + "{z}/{x}/{y}" + file_ending, {});
+  case TileSource::UrlPattern::ZYX:
+    return TileUrlTemplate(base_url + "{z}/{y}/{x}" + file_ending, {});
+  case TileSource::UrlPattern::ZXY_yPointingSouth:
+    return TileUrlTemplate(base_url + "{z}/{x}/{-y}" + file_ending, {});
+  case TileSource::UrlPattern::ZYX_yPointingSouth:
+    return TileUrlTemplate(base_url + "{z}/{-y}/{x}" + file_ending, {});
+  }
+  return {};
+}
+
+QString TileUrlTemplate::url(const srs::TileId& tile_id) const
+{
+  if (!isValid())
+    return {};
+  const auto n_y_tiles = srs::number_of_vertical_tiles_for_zoom_level(tile_id.zoom_level);
+  QString url;
+  url.reserve(m_url_template.size() + 16);
+  for (const auto& part : m_parts) {
+    url += part.literal;
+    switch (part.placeholder) {
+    case Placeholder::None:
+      break;
+    case Placeholder::Zoom:
+      url += QString::number(tile_id.zoom_level);
+      break;
+    case Placeholder::X:
+      url += QString::number(tile_id.coords.x);
+      break;
+    case Placeholder::Y:
+      url += QString::number(tile_id.coords.y);
+      break;
+    case Placeholder::YPointingSouth:
+      url += QString::number(n_y_tiles - tile_id.coords.y - 1);
+      break;
+    case Placeholder::Quadkey:
+      url += quadkey(tile_id);
+      break;
+    case Placeholder::Subdomain:
+      url += m_subdomains[qsizetype((tile_id.coords.x + tile_id.coords.y) % unsigned(m_subdomains.size()))];
+      break;
+    }
+  }
+  return url;
+}
+
+QString TileUrlTemplate::quadkey(const srs::TileId& tile_id)
+{
+  // the rows of quadkeys start in the north
+  const auto y = srs::number_of_vertical_tiles_for_zoom_level(tile_id.zoom_level) - tile_id.coords.y - 1;
+  QString key;
+  key.reserve(tile_id.zoom_level);
+  for (auto level = tile_id.zoom_level; level > 0; --level) {
+    const auto mask = 1u << (level - 1);
+    char digit = '0';
+    if (tile_id.coords.x & mask)
+      digit += 1;
+    if (y & mask)
+      digit += 2;
+    key += QChar(digit);
+  }
+  return key;
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include "alpine_renderer/TileSource.h"
+#include "alpine_renderer/srs.h"
+
+// tile url with placeholders, e.g., "https://{s}.tiles.example.com/{z}/{x}/{-y}.png":
+//   {z}  zoom level
+//   {x}  column
+//   {y}  row, y=0 is the southern most tile (like everywhere else in here)
+//   {-y} row, y=0 is the northern most tile
+//   {q}  quadkey (bing maps)
+//   {s}  one of the subdomains (or any other part of the url, e.g., ports). they are rotated by tile, so that a tile always
+//        has the same url (and http caches work), while the tiles are spread over several hosts, each with its own connections.
+class TileUrlTemplate
+{
+public:
+  TileUrlTemplate() = default;
+  explicit TileUrlTemplate(const QString& url_template, const QStringList& subdomains = {"a", "b", "c"});
+  // base url + tile address + file ending. an empty base url gives an invalid template.
+  [[nodiscard]] static TileUrlTemplate fromPattern(const QString& base_url, TileSource::UrlPattern url_pattern, const QString& file_ending);
+
+  // false for empty templates, unknown placeholders, or {s} without subdomains
+  [[nodiscard]] bool isValid() const { return m_error.isEmpty(); }
+  [[nodiscard]] const QString& errorString() const { return m_error; }
+  [[nodiscard]] const QString& urlTemplate() const { return m_url_template; }
+  [[nodiscard]] const QStringList& subdomains() const { return m_subdomains; }
+
+  [[nodiscard]] QString url(const srs::TileId& tile_id) const;
+  [[nodiscard]] static QString quadkey(const srs::TileId& tile_id);
+
+private:
+  enum class Placeholder { None, Zoom, X, Y, YPointingSouth, Quadkey, Subdomain };
+  struct Part {
+    QString literal; // before the placeholder
+    Placeholder placeholder = Placeholder::None;
+  };
+
+  QString m_url_template;
+  QStringList m_subdomains;
+  std::vector<Part> m_parts;
+  QString m_error = "empty url template";
+};
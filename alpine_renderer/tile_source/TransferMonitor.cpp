@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_source/TransferMonitor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+TransferMonitor::TransferMonitor(Clock::duration window) : m_window(window)
+{
+}
+
+void TransferMonitor::add(Clock::time_point requested, Clock::time_point first_byte, Clock::time_point finished, size_t bytes)
+{
+  assert(requested <= first_byte && first_byte <= finished);
+  m_transfers.push_back({requested, first_byte, finished, bytes});
+  while (m_transfers.size() > max_number_of_transfers || m_transfers.front().finished < finished - m_window)
+    m_transfers.pop_front();
+}
+
+TransferEstimate TransferMonitor::estimate(Clock::time_point now) const
+{
+  TransferEstimate estimate;
+  std::vector<std::pair<Clock::time_point, Clock::time_point>> receiving;
+  size_t bytes = 0;
+  Clock::duration latency = Clock::duration::zero();
+  for (const auto& transfer : m_transfers) {
+    if (transfer.finished < now - m_window)
+      continue;
+    receiving.emplace_back(transfer.first_byte, transfer.finished);
+    bytes += transfer.bytes;
+    latency += transfer.first_byte - transfer.requested;
+  }
+  if (receiving.empty())
+    return estimate;
+
+  // length of the union of the receiving intervals
+  std::sort(receiving.begin(), receiving.end());
+  auto busy = Clock::duration::zero();
+  auto current = receiving.front();
+  for (const auto& interval : receiving) {
+    if (interval.first > current.second) {
+      busy += current.second - current.first;
+      current = interval;
+      continue;
+    }
+    current.second = std::max(current.second, interval.second);
+  }
+  busy += current.second - current.first;
+  // answers, that arrived in one piece, take no measurable time
+  busy = std::max<Clock::duration>(busy, std::chrono::milliseconds(1));
+
+  estimate.n_transfers = receiving.size();
+  estimate.throughput = double(bytes) / std::chrono::duration<double>(busy).count();
+  estimate.latency = latency / Clock::rep(receiving.size());
+  estimate.bytes_per_transfer = double(bytes) / double(receiving.size());
+  return estimate;
+}
+
+void TransferMonitor::clear()
+{
+  m_transfers.clear();
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+
+struct TransferEstimate {
+  double throughput = 0; // bytes per second, while something was being received
+  std::chrono::steady_clock::duration latency = std::chrono::steady_clock::duration::zero(); // mean time from the request to the first byte
+  double bytes_per_transfer = 0;
+  size_t n_transfers = 0; // the estimate is meaningless without any
+};
+
+// estimates throughput and latency of a tile source from the transfers, that finished within a sliding window.
+// the throughput is the received bytes divided by the time, in which at least one transfer was receiving,
+// so that idle time and the latency (waiting for the first byte) don't count as a slow network.
+class TransferMonitor
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TransferMonitor(Clock::duration window = std::chrono::seconds(10));
+
+  // requested is when the request was sent, first_byte when the first bytes of the answer arrived
+  void add(Clock::time_point requested, Clock::time_point first_byte, Clock::time_point finished, size_t bytes);
+  [[nodiscard]] TransferEstimate estimate(Clock::time_point now = Clock::now()) const;
+  void clear();
+
+  [[nodiscard]] Clock::duration window() const { return m_window; }
+  void setWindow(Clock::duration window) { m_window = window; }
+
+private:
+  struct Transfer {
+    Clock::time_point requested;
+    Clock::time_point first_byte;
+    Clock::time_point finished;
+    size_t bytes = 0;
+  };
+  static constexpr size_t max_number_of_transfers = 1024;
+
+  std::deque<Transfer> m_transfers; // in the order they finished
+  Clock::duration m_window;
+};
@@ -164,6 +164,27 @@ void reduce(QuadTreeNode<DataType>* root, const PredicateFunction& node_needs_re
     reduce(node.get(), node_needs_refinement);
   }
 }
+
+// same as reduce, but calls removed_node_visitor for every node that is removed from the tree (before it is removed).
+template <typename DataType, typename PredicateFunction, typename Function>
+void reduce(QuadTreeNode<DataType>* root, const PredicateFunction& node_needs_refinement, const Function& removed_node_visitor) {
+  using QuadTreeNodePtr = std::unique_ptr<QuadTreeNode<DataType>>;
+  if (!root->hasChildren())
+    return;
+  auto remove_children = !node_needs_refinement(root->data());
+  if (remove_children) {
+    for (QuadTreeNodePtr& node : *root) {
+      assert(node);
+      visit(node.get(), removed_node_visitor);
+    }
+    root->removeChildren();
+    return;
+  }
+  for (QuadTreeNodePtr& node : *root) {
+    assert(node);
+    reduce(node.get(), node_needs_refinement, removed_node_visitor);
+  }
+}
 }
 
 
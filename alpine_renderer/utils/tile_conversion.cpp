@@ -18,6 +18,9 @@
 
 #include "tile_conversion.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace tile_conversion {
 
 Raster<glm::u8vec4> toRasterRGBA(const QByteArray& byte_array)
@@ -48,4 +51,36 @@ Raster<uint16_t> qImage2uint16Raster(const QImage&  qimage)
   return raster;
 }
 
+Raster<uint16_t> resampleHeightRaster(const Raster<uint16_t>& raster, const srs::Bounds& raster_bounds, const srs::Bounds& target_bounds, size_t side_length)
+{
+  assert(raster.width() >= 2 && raster.height() >= 2);
+  assert(side_length >= 2);
+  const auto& source = raster.buffer();
+  const auto sample = [&](size_t x, size_t y) { return double(source[y * raster.width() + x]); };
+  const auto raster_size = raster_bounds.max - raster_bounds.min;
+  const auto target_size = target_bounds.max - target_bounds.min;
+  const auto max_x = double(raster.width() - 1);
+  const auto max_y = double(raster.height() - 1);
+
+  Raster<uint16_t> resampled(side_length);
+  auto target = resampled.begin();
+  for (size_t row = 0; row < side_length; ++row) {
+    const auto world_y = target_bounds.max.y - double(row) / double(side_length - 1) * target_size.y;
+    const auto y = std::clamp((raster_bounds.max.y - world_y) / raster_size.y * max_y, 0.0, max_y);
+    const auto y0 = std::min(size_t(y), raster.height() - 2);
+    const auto fy = y - double(y0);
+    for (size_t col = 0; col < side_length; ++col) {
+      const auto world_x = target_bounds.min.x + double(col) / double(side_length - 1) * target_size.x;
+      const auto x = std::clamp((world_x - raster_bounds.min.x) / raster_size.x * max_x, 0.0, max_x);
+      const auto x0 = std::min(size_t(x), raster.width() - 2);
+      const auto fx = x - double(x0);
+      const auto top = sample(x0, y0) * (1 - fx) + sample(x0 + 1, y0) * fx;
+      const auto bottom = sample(x0, y0 + 1) * (1 - fx) + sample(x0 + 1, y0 + 1) * fx;
+      *target = uint16_t(std::lround(top * (1 - fy) + bottom * fy));
+      ++target;
+    }
+  }
+  return resampled;
+}
+
 }
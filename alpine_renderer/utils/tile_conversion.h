@@ -23,6 +23,7 @@
 #include <QImage>
 
 #include "alpine_renderer/Raster.h"
+#include "alpine_renderer/srs.h"
 
 namespace tile_conversion
 {
@@ -30,6 +31,9 @@ namespace tile_conversion
 inline QImage toQImage(const QByteArray& byte_array) { return QImage::fromData(byte_array); }
 Raster<glm::u8vec4> toRasterRGBA(const QByteArray& byte_array);
 Raster<uint16_t> qImage2uint16Raster(const QImage& byte_array);
+// bilinearly resamples the part of a height raster covering target_bounds (e.g., a descendant tile) to side_length x side_length samples.
+// samples are on the bounds (first and last row / column on the edges), the first row is north.
+Raster<uint16_t> resampleHeightRaster(const Raster<uint16_t>& raster, const srs::Bounds& raster_bounds, const srs::Bounds& target_bounds, size_t side_length);
 
 inline glm::u8vec4 float2alpineRGBA(float height)
 {
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <optional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QStringList>
+
+#include "alpine_renderer/TilePackBuilder.h"
+
+// builds the tile archives for offline installs, e.g.:
+// alpine_tile_packer --bounds 1800000,6120000,1850000,6170000 --min-zoom 0 --max-zoom 14 --output vienna
+// the archives are then passed to alpine_gl_renderer with --height-archive vienna/height.atb --ortho-archive vienna/ortho.atb --offline
+
+namespace {
+std::optional<TileLoadService::UrlPattern> parseUrlPattern(const QString& name)
+{
+  if (name == "zxy")
+    return TileLoadService::UrlPattern::ZXY;
+  if (name == "zyx")
+    return TileLoadService::UrlPattern::ZYX;
+  if (name == "zxy_south")
+    return TileLoadService::UrlPattern::ZXY_yPointingSouth;
+  if (name == "zyx_south")
+    return TileLoadService::UrlPattern::ZYX_yPointingSouth;
+  return {};
+}
+
+std::optional<srs::Bounds> parseBounds(const QString& text)
+{
+  const auto parts = text.split(',');
+  if (parts.size() != 4)
+    return {};
+  double values[4];
+  for (int i = 0; i < 4; ++i) {
+    bool ok = false;
+    values[i] = parts[i].toDouble(&ok);
+    if (!ok)
+      return {};
+  }
+  if (values[0] >= values[2] || values[1] >= values[3])
+    return {};
+  return srs::Bounds{.min = {values[0], values[1]}, .max = {values[2], values[3]}};
+}
+}
+
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Downloads the height and ortho tiles of a region into tile archives. Interrupted builds are resumed.\n"
+                                   "Exits with 2, if some tiles were unavailable or could not be staged (they are left out, running again retries them).");
+  parser.addHelpOption();
+  const QCommandLineOption bounds_option("bounds", "Region in web mercator metres.", "min_x,min_y,max_x,max_y");
+  const QCommandLineOption min_zoom_option("min-zoom", "Coarsest zoom level (default 0).", "level", "0");
+  const QCommandLineOption max_zoom_option("max-zoom", "Finest zoom level.", "level");
+  const QCommandLineOption height_url_option("height-url", "Base url of the height tiles.", "url", "http://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/");
+  const QCommandLineOption height_pattern_option("height-pattern", "zxy, zyx, zxy_south or zyx_south.", "pattern", "zxy");
+  const QCommandLineOption height_ending_option("height-ending", "File ending of the height tiles.", "ending", ".png");
+  const QCommandLineOption ortho_url_option("ortho-url", "Base url of the ortho tiles.", "url", "http://maps.wien.gv.at/basemap/bmaporthofoto30cm/normal/google3857/");
+  const QCommandLineOption ortho_pattern_option("ortho-pattern", "zxy, zyx, zxy_south or zyx_south.", "pattern", "zyx_south");
+  const QCommandLineOption ortho_ending_option("ortho-ending", "File ending of the ortho tiles.", "ending", ".jpeg");
+  const QCommandLineOption concurrency_option("concurrency", "Maximum number of parallel downloads (default 16).", "n", "16");
+  const QCommandLineOption staging_option("staging", "Directory for the downloaded tiles (default <output>/staging). Keep it to resume.", "directory");
+  const QCommandLineOption output_option("output", "Directory for height.atb and ortho.atb.", "directory");
+  parser.addOptions({bounds_option, min_zoom_option, max_zoom_option, height_url_option, height_pattern_option, height_ending_option,
+                     ortho_url_option, ortho_pattern_option, ortho_ending_option, concurrency_option, staging_option, output_option});
+  parser.process(app);
+
+  const auto bounds = parseBounds(parser.value(bounds_option));
+  const auto height_pattern = parseUrlPattern(parser.value(height_pattern_option));
+  const auto ortho_pattern = parseUrlPattern(parser.value(ortho_pattern_option));
+  bool min_zoom_ok = false;
+  bool max_zoom_ok = false;
+  bool concurrency_ok = false;
+  const auto min_zoom = parser.value(min_zoom_option).toUInt(&min_zoom_ok);
+  const auto max_zoom = parser.value(max_zoom_option).toUInt(&max_zoom_ok);
+  const auto concurrency = parser.value(concurrency_option).toUInt(&concurrency_ok);
+  if (!bounds || !height_pattern || !ortho_pattern || !min_zoom_ok || !max_zoom_ok || min_zoom > max_zoom || max_zoom > 22 || !concurrency_ok
+      || !parser.isSet(output_option)) {
+    qWarning("invalid arguments");
+    parser.showHelp(1);
+  }
+  const auto output = parser.value(output_option);
+  const auto staging = parser.isSet(staging_option) ? parser.value(staging_option) : output + "/staging";
+
+  TilePackBuilder builder({{"height", parser.value(height_url_option), *height_pattern, parser.value(height_ending_option)},
+                           {"ortho", parser.value(ortho_url_option), *ortho_pattern, parser.value(ortho_ending_option)}},
+                          staging, concurrency);
+  const auto tiles = TilePackBuilder::tilesInRegion(*bounds, min_zoom, max_zoom);
+  qInfo() << tiles.size() << "tiles per layer";
+
+  QObject::connect(&builder, &TilePackBuilder::progressChanged, [](const TilePackBuilder::Progress& progress) {
+    if (progress.nDone() % 100 == 0 || progress.nDone() == progress.n_requested)
+      qInfo() << progress.nDone() << "/" << progress.n_requested;
+  });
+  QObject::connect(&builder, &TilePackBuilder::downloadsFinished, &app, [&](const TilePackBuilder::Progress& progress) {
+    qInfo() << "staged before:" << progress.n_staged_before << "downloaded:" << progress.n_downloaded << "unavailable:" << progress.n_unavailable << "not staged:" << progress.n_failed_writes;
+    if (!builder.pack(tiles, output)) {
+      qWarning() << "writing the archives to" << output << "failed";
+      app.exit(1);
+      return;
+    }
+    qInfo() << "archives written to" << output;
+    app.exit(progress.complete() ? 0 : 2);
+  });
+  builder.download(tiles);
+  return app.exec();
+}
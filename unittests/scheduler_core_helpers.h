@@ -0,0 +1,127 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <unordered_set>
+
+#include "alpine_renderer/Camera.h"
+#include "alpine_renderer/Tile.h"
+#include "alpine_renderer/TileSetDelta.h"
+#include "alpine_renderer/srs.h"
+#include "alpine_renderer/tile_scheduler/BasicTreeSchedulerCore.h"
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+#include "alpine_renderer/tile_scheduler/SimplisticSchedulerCore.h"
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
+
+// helpers for the tests of the scheduler cores (SimplisticSchedulerCore, BasicTreeSchedulerCore)
+namespace test_helpers {
+using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+
+inline std::shared_ptr<Tile> makeTile(const srs::TileId& id)
+{
+  return std::make_shared<Tile>(id, srs::tile_bounds(id), Raster<uint16_t>(64), QImage(256, 256, QImage::Format_ARGB32));
+}
+
+// the lod policy the tests of the core run with
+template <typename Core>
+LodPolicy testLodPolicy()
+{
+  return LodPolicy {};
+}
+template <>
+inline LodPolicy testLodPolicy<SimplisticSchedulerCore>()
+{
+  return LodPolicy { 4.0, 4.0 };
+}
+
+template <typename Core>
+struct Components {
+  LodPolicy lod_policy = testLodPolicy<Core>();
+  GpuMemoryBudget gpu_memory;
+  UnavailableTileCache unavailable_tiles;
+  TileCache tile_cache;
+  typename Core::Context context(bool progressive = false) { return { lod_policy, gpu_memory, unavailable_tiles, tile_cache, progressive }; }
+};
+
+inline Camera makeCamera(double distance)
+{
+  auto camera = Camera({1822577.0, 6141664.0 - distance, 171.28 + distance}, {1822577.0, 6141664.0, 171.28});
+  camera.setPerspectiveParams(45, {1000, 1000}, 100);
+  return camera;
+}
+
+// delivers the requested tiles right away. returns the number of requests.
+template <typename Core>
+size_t receiveAll(Core& core, const typename Core::Context& context, const TileSetDelta& delta)
+{
+  for (const auto& tile_id : delta.requested)
+    (void)core.receiveTile(context, makeTile(tile_id));
+  return delta.requested.size();
+}
+
+// updateCamera of a fast moving camera, the lod policy decides which levels are skipped
+inline TileSetDelta updateSkippingLevels(SimplisticSchedulerCore& core, const SimplisticSchedulerCore::Context& context, const Camera& camera)
+{
+  return core.updateTiles(context, camera, core.refineCandidates(context, camera), true);
+}
+inline TileSetDelta updateSkippingLevels(BasicTreeSchedulerCore& core, const BasicTreeSchedulerCore::Context& context, const Camera& camera)
+{
+  core.refine(context, camera);
+  return core.updateTiles(context, camera, true);
+}
+
+// requested, but not received yet
+inline bool hasTilesInTransit(const SimplisticSchedulerCore& core)
+{
+  return !core.pendingTiles().empty();
+}
+inline bool hasTilesInTransit(const BasicTreeSchedulerCore& core)
+{
+  return !core.tilesInTransit().empty();
+}
+
+// true if the area of the tile is drawn by an ancestor or by descendants on the gpu
+inline bool isCovered(const srs::TileId& tile_id, const TileSet& gpu_tiles)
+{
+  for (auto id = tile_id; id.zoom_level > 0; id = srs::parent(id)) {
+    if (gpu_tiles.contains(srs::parent(id)))
+      return true;
+  }
+  if (gpu_tiles.contains(tile_id))
+    return true;
+  const auto finer_tile_on_gpu = std::any_of(gpu_tiles.begin(), gpu_tiles.end(), [&tile_id](const auto& id) {
+    return id.zoom_level > tile_id.zoom_level && srs::overlap(id, tile_id);
+  });
+  if (!finer_tile_on_gpu)
+    return false;
+  const auto children = srs::subtiles(tile_id);
+  return std::all_of(children.begin(), children.end(), [&gpu_tiles](const auto& child) { return isCovered(child, gpu_tiles); });
+}
+
+inline bool containsOverlappingTiles(const TileSet& gpu_tiles)
+{
+  return std::any_of(gpu_tiles.begin(), gpu_tiles.end(), [&gpu_tiles](const auto& a) {
+    return std::any_of(gpu_tiles.begin(), gpu_tiles.end(), [&a](const auto& b) { return a != b && srs::overlap(a, b); });
+  });
+}
+}
@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/AdaptiveLodController.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("AdaptiveLodController") {
+  const auto start = AdaptiveLodController::Clock::time_point{};
+  AdaptiveLodController controller;
+  controller.setFrameTimeBudget(16ms);
+  controller.setMaxNumberOfTiles(100);
+  controller.setMaxDownloadBacklog(2s);
+  controller.setThresholdScaleBounds(0.5, 4.0);
+
+  SECTION("only observes when disabled") {
+    CHECK(!controller.enabled());
+    controller.addFrameTime(50ms);
+    controller.update(10, 0, start);
+    CHECK(controller.state().threshold_scale == 1.0);
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::FrameTime);
+    CHECK(controller.state().pressure == Approx(50.0 / 16.0));
+  }
+
+  SECTION("frame time") {
+    controller.setEnabled(true);
+    for (int i = 0; i < 100; ++i)
+      controller.addFrameTime(32ms);
+    for (int i = 0; i < 3; ++i)
+      controller.update(10, 0, start + i * 100ms);
+    CHECK(std::chrono::duration<double, std::milli>(controller.state().frame_time).count() == Approx(32.0));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::FrameTime);
+    CHECK(controller.state().threshold_scale > 1.5);
+    // stays within bounds
+    for (int i = 3; i < 100; ++i)
+      controller.update(10, 0, start + i * 100ms);
+    CHECK(controller.state().threshold_scale == 4.0);
+
+    // fast frames again, detail comes back
+    for (int i = 0; i < 100; ++i)
+      controller.addFrameTime(2ms);
+    for (int i = 100; i < 200; ++i)
+      controller.update(10, 0, start + i * 100ms);
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::None);
+    CHECK(controller.state().threshold_scale == 0.5);
+  }
+
+  SECTION("tile count") {
+    controller.setEnabled(true);
+    controller.update(200, 0, start);
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::TileCount);
+    CHECK(controller.state().threshold_scale > 1.0);
+    const auto scale = controller.state().threshold_scale;
+    // within the deadband, the scale is kept
+    controller.update(80, 0, start + 100ms);
+    CHECK(controller.state().threshold_scale == scale);
+  }
+
+  SECTION("bandwidth") {
+    controller.setEnabled(true);
+    controller.update(10, 4, start);
+    // 4 downloads of 100 kB in one second
+    for (int i = 0; i < 4; ++i)
+      controller.addReceivedBytes(100'000, start + 1s);
+    controller.update(10, 100, start + 1s);
+    CHECK(controller.state().throughput == Approx(400'000));
+    // 100 downloads in transit take 25 seconds
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(25s));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::Bandwidth);
+    CHECK(controller.state().threshold_scale > 1.0);
+
+    // a second without data while downloading lowers the estimate, idle time doesn't
+    controller.update(10, 0, start + 2s);
+    controller.update(10, 0, start + 10s);
+    CHECK(controller.state().throughput == Approx(400'000 * 0.7));
+  }
+
+  SECTION("idle gap, then resume") {
+    controller.setEnabled(true);
+    controller.update(10, 10, start);
+    // 10 downloads of 100 kB in one second, then nothing for longer than the max age of transfer estimates
+    for (int i = 0; i < 10; ++i)
+      controller.addReceivedBytes(100'000, start + 100ms * (i + 1));
+    controller.setTransferEstimate(0, {.throughput = 1'000'000, .latency = 0ms, .bytes_per_transfer = 100'000, .n_transfers = 10}, start + 1s);
+    controller.update(10, 0, start + 30s);
+    CHECK(controller.state().throughput == Approx(1'000'000));
+
+    // requested outside of an update (e.g., prefetches), while the camera rested. it's neither slow nor stalled.
+    controller.update(10, 10, start + 30s + 50ms);
+    CHECK(controller.state().throughput == Approx(1'000'000));
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(1s));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::None);
+
+    // the resumed downloads arrive at the same speed
+    for (int i = 0; i < 10; ++i)
+      controller.addReceivedBytes(100'000, start + 30s + 50ms + 100ms * (i + 1));
+    controller.update(10, 10, start + 40s);
+    CHECK(controller.state().throughput == Approx(1'000'000));
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(1s));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::None);
+  }
+
+  SECTION("transfer estimates of the sources") {
+    controller.setEnabled(true);
+    // cache hits make the received bytes look like a fast network
+    controller.update(10, 4, start);
+    for (int i = 0; i < 40; ++i)
+      controller.addReceivedBytes(100'000, start + 1s);
+    // two sources with 100 kB per second each, one of them with 500ms latency
+    controller.setTransferEstimate(0, {.throughput = 100'000, .latency = 100ms, .bytes_per_transfer = 50'000, .n_transfers = 10}, start + 1s);
+    controller.setTransferEstimate(1, {.throughput = 100'000, .latency = 500ms, .bytes_per_transfer = 150'000, .n_transfers = 10}, start + 1s);
+    controller.update(10, 20, start + 1s);
+    CHECK(controller.state().throughput == Approx(200'000));
+    CHECK(controller.state().latency == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(500ms));
+    // 20 downloads of 100 kB at 200 kB/s take 10s, after the latency
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(10500ms));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::Bandwidth);
+    CHECK(controller.state().threshold_scale > 1.0);
+
+    // nothing in transit, the view is complete
+    controller.update(10, 0, start + 2s);
+    CHECK(controller.state().download_backlog == AdaptiveLodController::Clock::duration::zero());
+
+    // sources without transfers in their window don't count
+    controller.setTransferEstimate(0, {}, start + 3s);
+    controller.setTransferEstimate(1, {}, start + 3s);
+    controller.update(10, 0, start + 3s);
+    CHECK(controller.state().throughput > 200'000);
+    CHECK(controller.state().latency == AdaptiveLodController::Clock::duration::zero());
+  }
+
+  SECTION("stalled links and outdated transfer estimates") {
+    controller.setEnabled(true);
+    const auto estimate = TransferEstimate {.throughput = 100'000, .latency = 100ms, .bytes_per_transfer = 10'000, .n_transfers = 10};
+    controller.setTransferEstimate(0, estimate, start);
+    controller.update(10, 4, start);
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(500ms));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::None);
+
+    // nothing finished for 3s while downloads were in transit, the last estimate is too optimistic
+    controller.update(10, 4, start + 3s);
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(3s));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::Bandwidth);
+    CHECK(controller.state().threshold_scale > 1.0);
+
+    // the link is back
+    controller.setTransferEstimate(0, estimate, start + 4s);
+    controller.update(10, 4, start + 4s);
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(500ms));
+    CHECK(controller.state().limit == AdaptiveLodController::Limit::None);
+
+    // idle time doesn't count as a stall
+    controller.update(10, 0, start + 8s);
+    controller.update(10, 4, start + 9s);
+    CHECK(controller.state().download_backlog == std::chrono::duration_cast<AdaptiveLodController::Clock::duration>(500ms));
+
+    // estimates older than the max age are ignored
+    controller.update(10, 0, start + 4s + controller.maxTransferEstimateAge() + 1ms);
+    CHECK(controller.state().latency == AdaptiveLodController::Clock::duration::zero());
+  }
+
+  SECTION("disabling resets the scale") {
+    controller.setEnabled(true);
+    controller.update(200, 0, start);
+    CHECK(controller.state().threshold_scale > 1.0);
+    controller.setEnabled(false);
+    CHECK(controller.state().threshold_scale == 1.0);
+  }
+}
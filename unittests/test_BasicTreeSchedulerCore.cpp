@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/BasicTreeSchedulerCore.h"
+
+#include <algorithm>
+
+#include <catch2/catch.hpp>
+
+#include "unittests/scheduler_core_helpers.h"
+
+using namespace test_helpers;
+
+// the behaviour shared with the SimplisticSchedulerCore is tested in test_SchedulerCores.cpp
+TEST_CASE("BasicTreeSchedulerCore") {
+  const auto camera = makeCamera(500);
+  Components<BasicTreeSchedulerCore> components;
+  BasicTreeSchedulerCore core;
+
+  SECTION("requests the leaves of the tree once") {
+    const auto delta = core.updateCamera(components.context(), camera);
+    REQUIRE(delta.requested.size() >= 10);
+    CHECK(delta.ready.empty());
+    CHECK(delta.expired.empty());
+    CHECK(core.tilesInTransit().size() == delta.requested.size());
+    for (const auto& tile_id : delta.requested) {
+      CHECK(core.isInTransit(tile_id));
+      CHECK(core.isScheduled(tile_id));
+    }
+    CHECK(core.updateCamera(components.context(), camera).empty());
+  }
+
+  SECTION("ships the tiles once all of them arrived") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    REQUIRE(requests.requested.size() >= 10);
+    for (size_t i = 0; i + 1 < requests.requested.size(); ++i)
+      CHECK(core.receiveTile(components.context(), makeTile(requests.requested[i])).empty());
+    const auto delta = core.receiveTile(components.context(), makeTile(requests.requested.back()));
+    CHECK(delta.ready.size() == requests.requested.size());
+    CHECK(delta.expired.empty());
+    CHECK(core.tilesInTransit().empty());
+    CHECK(core.gpuTiles().size() == requests.requested.size());
+    CHECK(components.gpu_memory.numberOfTiles() == requests.requested.size());
+  }
+
+  SECTION("ignores tiles, that are not in transit") {
+    (void)core.updateCamera(components.context(), camera);
+    const auto tile_id = srs::TileId { 10, { 100, 100 } };
+    CHECK(core.receiveTile(components.context(), makeTile(tile_id)).empty());
+    CHECK(!core.gpuTiles().contains(tile_id));
+  }
+
+  SECTION("expires the tiles of removed nodes") {
+    (void)receiveAll(core, components.context(), core.updateCamera(components.context(), camera));
+    const auto gpu_tiles = core.gpuTiles();
+    const auto far_camera = makeCamera(20000);
+    const auto requests = core.updateCamera(components.context(), far_camera);
+    REQUIRE(!requests.requested.empty());
+    TileSetDelta shipment;
+    for (const auto& tile_id : requests.requested)
+      shipment = core.receiveTile(components.context(), makeTile(tile_id));
+    CHECK(!shipment.expired.empty());
+    for (const auto& tile_id : shipment.expired)
+      CHECK(gpu_tiles.contains(tile_id));
+    CHECK(!containsOverlappingTiles(core.gpuTiles()));
+    CHECK(components.gpu_memory.numberOfTiles() == core.gpuTiles().size());
+  }
+
+  SECTION("unavailable tiles don't block shipping and are not requested again") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    const auto unavailable_tile = requests.requested.front();
+    CHECK(core.markTileUnavailable(components.context(), unavailable_tile).empty());
+    CHECK(!core.isInTransit(unavailable_tile));
+    CHECK(components.unavailable_tiles.contains(unavailable_tile));
+    TileSetDelta shipment;
+    for (size_t i = 1; i < requests.requested.size(); ++i)
+      shipment = core.receiveTile(components.context(), makeTile(requests.requested[i]));
+    CHECK(shipment.ready.size() == requests.requested.size() - 1);
+
+    BasicTreeSchedulerCore other_core;
+    const auto delta = other_core.updateCamera(components.context(), camera);
+    CHECK(delta.requested.size() == requests.requested.size() - 1);
+    CHECK(std::find(delta.requested.begin(), delta.requested.end(), unavailable_tile) == delta.requested.end());
+  }
+
+  SECTION("cached tiles are shipped without request") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    for (const auto& tile_id : requests.requested)
+      components.tile_cache.insert(makeTile(tile_id));
+
+    components.tile_cache.resetStatistics();
+    BasicTreeSchedulerCore other_core;
+    const auto delta = other_core.updateCamera(components.context(), camera);
+    CHECK(delta.requested.empty());
+    CHECK(delta.ready.size() == requests.requested.size());
+    CHECK(components.tile_cache.statistics().hits == requests.requested.size());
+    CHECK(components.tile_cache.statistics().misses == 0);
+  }
+}
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/CameraPredictor.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("CameraPredictor") {
+  const auto camera = Camera({1000.0, 2000.0, 500.0}, {1000.0, 2500.0, 0.0});
+  const auto start = CameraPredictor::Clock::time_point{};
+  const auto moved = [&camera](const glm::dvec3& delta) {
+    auto c = camera;
+    c.move(delta);
+    return c;
+  };
+
+  SECTION("no prediction without samples") {
+    CameraPredictor predictor;
+    CHECK(!predictor.predict(100ms));
+    CHECK(glm::length(predictor.velocity()) == 0);
+  }
+
+  SECTION("still camera") {
+    CameraPredictor predictor;
+    predictor.addSample(camera, start);
+    predictor.addSample(camera, start + 20ms);
+    CHECK(glm::length(predictor.velocity()) == 0);
+    const auto predicted = predictor.predict(300ms);
+    REQUIRE(predicted);
+    CHECK(glm::length(predicted->position() - camera.position()) == Approx(0));
+  }
+
+  SECTION("constant velocity is extrapolated") {
+    CameraPredictor predictor;
+    for (int i = 0; i < 10; ++i)
+      predictor.addSample(moved({i * 10.0, 0, 0}), start + i * 50ms); // 200 m/s in x direction
+    const auto velocity = predictor.velocity();
+    CHECK(velocity.x == Approx(200.0));
+    CHECK(velocity.y == Approx(0.0).margin(0.000001));
+    CHECK(velocity.z == Approx(0.0).margin(0.000001));
+
+    const auto predicted = predictor.predict(500ms);
+    REQUIRE(predicted);
+    CHECK(predicted->position().x == Approx(camera.position().x + 90 + 100));
+    CHECK(predicted->position().y == Approx(camera.position().y));
+    // orientation is kept
+    CHECK(glm::length(predicted->zAxis() - camera.zAxis()) == Approx(0).margin(0.000001));
+  }
+
+  SECTION("old samples are dropped") {
+    CameraPredictor predictor(100ms);
+    predictor.addSample(moved({-1000, 0, 0}), start);
+    predictor.addSample(moved({0, 0, 0}), start + 1000ms);
+    // the camera was still for longer than the window
+    CHECK(glm::length(predictor.velocity()) == 0);
+    predictor.addSample(moved({0, 10, 0}), start + 1050ms);
+    predictor.addSample(moved({0, 20, 0}), start + 1100ms);
+    CHECK(predictor.velocity().x == Approx(0.0).margin(0.000001));
+    CHECK(predictor.velocity().y == Approx(200.0));
+  }
+
+  SECTION("clear") {
+    CameraPredictor predictor;
+    predictor.addSample(camera, start);
+    predictor.clear();
+    CHECK(!predictor.predict(100ms));
+  }
+}
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/CircuitBreaker.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+using State = CircuitBreaker::State;
+
+TEST_CASE("CircuitBreaker") {
+  const auto t0 = CircuitBreaker::Clock::now();
+  CircuitBreaker breaker(3, 10s);
+
+  SECTION("opens after consecutive failures") {
+    CHECK(breaker.state(t0) == State::Closed);
+    breaker.recordFailure(t0, t0);
+    breaker.recordFailure(t0, t0);
+    breaker.recordSuccess(t0); // resets the count
+    breaker.recordFailure(t0, t0);
+    breaker.recordFailure(t0, t0);
+    CHECK(breaker.allowRequest(t0));
+    breaker.recordFailure(t0, t0);
+    CHECK(breaker.state(t0) == State::Open);
+    CHECK(breaker.timeUntilHalfOpen(t0 + 4s) == 6s);
+    CHECK(!breaker.allowRequest(t0 + 9s));
+    // failures of requests, that were sent before, don't prolong it
+    breaker.recordFailure(t0, t0 + 5s);
+    CHECK(breaker.state(t0 + 10s) == State::HalfOpen);
+    CHECK(breaker.timeUntilHalfOpen(t0 + 10s) == 0s);
+  }
+
+  SECTION("half open allows one probe") {
+    for (int i = 0; i < 3; ++i)
+      breaker.recordFailure(t0, t0);
+    CHECK(breaker.allowRequest(t0 + 10s));
+    CHECK(breaker.probeInFlight());
+    CHECK(!breaker.allowRequest(t0 + 10s));
+
+    SECTION("a successful probe closes it") {
+      breaker.recordSuccess(t0 + 10s);
+      CHECK(breaker.state(t0 + 10s) == State::Closed);
+      CHECK(breaker.allowRequest(t0 + 10s));
+      CHECK(breaker.allowRequest(t0 + 10s));
+    }
+    SECTION("a failed probe opens it again") {
+      breaker.recordFailure(t0 + 10s, t0 + 11s);
+      CHECK(breaker.state(t0 + 11s) == State::Open);
+      CHECK(breaker.state(t0 + 20s) == State::Open);
+      CHECK(breaker.state(t0 + 21s) == State::HalfOpen);
+    }
+    SECTION("late answers to requests sent before it opened don't decide") {
+      breaker.recordSuccess(t0 - 1s);
+      CHECK(breaker.state(t0 + 11s) == State::HalfOpen);
+      breaker.recordFailure(t0 - 1s, t0 + 11s);
+      CHECK(breaker.state(t0 + 11s) == State::HalfOpen);
+      CHECK(breaker.probeInFlight());
+      CHECK(!breaker.allowRequest(t0 + 11s));
+      breaker.recordSuccess(t0 + 10s);
+      CHECK(breaker.state(t0 + 11s) == State::Closed);
+    }
+  }
+
+  SECTION("a threshold of 0 never opens") {
+    CircuitBreaker disabled(0, 10s);
+    for (int i = 0; i < 100; ++i)
+      disabled.recordFailure(t0, t0);
+    CHECK(disabled.allowRequest(t0));
+  }
+}
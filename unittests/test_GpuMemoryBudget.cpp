@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/GpuMemoryBudget.h"
+
+#include <catch2/catch.hpp>
+
+#include "alpine_renderer/Tile.h"
+
+namespace {
+Tile makeTile(const srs::TileId& id, int side_length)
+{
+  return Tile(id, srs::tile_bounds(id), Raster<uint16_t>(size_t(side_length)), QImage(side_length, side_length, QImage::Format_ARGB32));
+}
+}
+
+TEST_CASE("GpuMemoryBudget") {
+  SECTION("estimate includes mip maps") {
+    CHECK(GpuMemoryBudget::estimatedBytes(1, 1) == 2 + 4);
+    CHECK(GpuMemoryBudget::estimatedBytes(2, 2) == 2 * 4 + 4 * (4 + 1));
+    CHECK(GpuMemoryBudget::estimatedBytes(256, 256) == 256 * 256 * 2 + 4 * (256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2 + 1));
+    CHECK(GpuMemoryBudget::estimatedBytes(makeTile({0, {0, 0}}, 256)) == GpuMemoryBudget::estimatedBytes(256, 256));
+  }
+
+  SECTION("tracks residency") {
+    const auto tile_bytes = GpuMemoryBudget::estimatedBytes(64, 64);
+    GpuMemoryBudget budget(3 * tile_bytes);
+    CHECK(budget.bytesPerTile() == GpuMemoryBudget::estimatedBytes(256, 256));
+    CHECK(budget.maxNumberOfTiles() == 0);
+
+    budget.add(makeTile({1, {0, 0}}, 64));
+    budget.add(makeTile({1, {1, 0}}, 64));
+    budget.add(makeTile({1, {1, 0}}, 64)); // no double counting
+    CHECK(budget.numberOfTiles() == 2);
+    CHECK(budget.bytes() == 2 * tile_bytes);
+    CHECK(budget.bytesOf({1, {1, 0}}) == tile_bytes);
+    CHECK(budget.bytesOf({1, {1, 1}}) == 0);
+    CHECK(budget.bytesPerTile() == tile_bytes);
+    CHECK(budget.maxNumberOfTiles() == 3);
+    CHECK(budget.fits(tile_bytes));
+    CHECK(!budget.fits(tile_bytes + 1));
+
+    const auto residency = budget.residency();
+    CHECK(residency.n_tiles == 2);
+    CHECK(residency.bytes == 2 * tile_bytes);
+    CHECK(residency.budget == 3 * tile_bytes);
+
+    budget.remove({1, {0, 0}});
+    budget.remove({1, {0, 0}});
+    CHECK(budget.numberOfTiles() == 1);
+    CHECK(budget.bytes() == tile_bytes);
+    budget.clear();
+    CHECK(budget.bytes() == 0);
+  }
+}
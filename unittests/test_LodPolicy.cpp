@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/LodPolicy.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("LodPolicy") {
+  const auto start = LodPolicy::Clock::time_point{};
+  const auto tile = srs::TileId{10, {500, 300}};
+
+  SECTION("hysteresis") {
+    LodPolicy policy(2.0, 1.0);
+    CHECK(policy.shouldRefine(tile, 2.0, false, start));
+    CHECK(!policy.shouldRefine(tile, 1.5, false, start));
+    CHECK(policy.shouldRefine(tile, 1.5, true, start));
+    CHECK(policy.shouldRefine(tile, 1.0, true, start));
+    CHECK(!policy.shouldRefine(tile, 0.9, true, start));
+  }
+
+  SECTION("max zoom level") {
+    LodPolicy policy(2.0, 1.0);
+    CHECK(!policy.shouldRefine({16, {0, 0}}, 100.0, true, start));
+    policy.setMaxZoomLevel(18);
+    CHECK(policy.shouldRefine({16, {0, 0}}, 100.0, true, start));
+  }
+
+  SECTION("min residency") {
+    LodPolicy policy(2.0, 1.0, 5s);
+    policy.tileShipped(srs::TileId{12, {2000, 1200}}, start);
+    // grand parent, children are kept
+    CHECK(policy.shouldRefine(tile, 0.1, true, start + 1s));
+    CHECK(!policy.shouldRefine(tile, 0.1, false, start + 1s));
+    CHECK(!policy.shouldRefine(tile, 0.1, true, start + 5s));
+    // not an ancestor
+    CHECK(!policy.shouldRefine(srs::TileId{10, {501, 300}}, 0.1, true, start + 1s));
+
+    policy.removeExpired(start + 4s);
+    CHECK(policy.shouldRefine(tile, 0.1, true, start + 4s));
+    policy.removeExpired(start + 6s);
+    policy.setMinResidency(1min);
+    CHECK(!policy.shouldRefine(tile, 0.1, true, start + 6s));
+  }
+
+  SECTION("skip levels") {
+    LodPolicy policy;
+    CHECK(policy.levelSkip() == 1);
+    CHECK(policy.skipLevels(tile) == tile);
+    policy.setLevelSkip(3);
+    CHECK(policy.skipLevels(tile) == srs::TileId{9, {250, 150}});
+    CHECK(policy.skipLevels({9, {250, 150}}) == srs::TileId{9, {250, 150}});
+    CHECK(policy.skipLevels({2, {1, 1}}) == srs::TileId{0, {0, 0}});
+  }
+
+  SECTION("fast movement") {
+    LodPolicy policy;
+    policy.setFastMovementSpeed(0.5);
+    const auto camera = Camera({1000.0, 2000.0, 1000.0}, {1000.0, 2500.0, 0.0});
+    CHECK(!policy.isFastMovement(camera, {0.0, 0.0, 0.0}));
+    CHECK(!policy.isFastMovement(camera, {0.0, 0.0, -400.0}));
+    CHECK(policy.isFastMovement(camera, {0.0, 0.0, -600.0}));
+    CHECK(policy.isFastMovement(camera, {600.0, 0.0, 0.0}));
+  }
+
+  SECTION("churn statistics") {
+    LodPolicy policy;
+    policy.setChurnWindow(10s);
+    policy.tileRequested(tile, start);
+    policy.tileRequested(srs::TileId{10, {501, 300}}, start);
+    CHECK(policy.statistics().requests == 2);
+    CHECK(policy.statistics().re_requests == 0);
+    policy.tileRequested(tile, start + 5s);
+    CHECK(policy.statistics().re_requests == 1);
+    policy.tileRequested(tile, start + 16s);
+    CHECK(policy.statistics().re_requests == 1);
+    CHECK(policy.statistics().requests == 4);
+    CHECK(policy.statistics().churnRate() == Approx(0.25));
+    policy.resetStatistics();
+    CHECK(policy.statistics().requests == 0);
+    CHECK(policy.statistics().churnRate() == 0);
+  }
+}
@@ -270,6 +270,22 @@ TEST_CASE("QuadTree") {
 //    root[0][2].addChildren({-1, -1, -1, -1});
 //    root[0][3].addChildren({0, 0, 0, -1});
   }
+  SECTION("reduce visits removed nodes") {
+    QuadTreeNode<int> root(1);
+    root.addChildren({1, -1, 1, 1});
+    root[0].addChildren({-1, 2, 3, 4});
+    root[1].addChildren({5, 6, 7, 8});
+    root[1][3].addChildren({9, 10, 11, 12});
+
+    std::vector<int> removed;
+    quad_tree::reduce(&root, [](int v) { return v >= 0; }, [&](int v) { removed.push_back(v); });
+    std::sort(removed.begin(), removed.end());
+    CHECK(removed == std::vector<int>{5, 6, 7, 8, 9, 10, 11, 12});
+    REQUIRE(root.hasChildren());
+    CHECK(root[0].hasChildren());
+    CHECK(!root[1].hasChildren());
+    CHECK(!root[2].hasChildren());
+  }
 }
 
 TEST_CASE("on the fly QuadTree") {
@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/RetryPolicy.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("RetryPolicy") {
+  SECTION("backoff grows exponentially up to the maximum") {
+    const RetryPolicy policy = {.initial_backoff = 100ms, .backoff_factor = 2.0, .max_backoff = 1000ms, .jitter = 0.0};
+    CHECK(policy.backoff(0, 0.7) == 100ms);
+    CHECK(policy.backoff(1, 0.7) == 200ms);
+    CHECK(policy.backoff(2, 0.7) == 400ms);
+    CHECK(policy.backoff(3, 0.7) == 800ms);
+    CHECK(policy.backoff(4, 0.7) == 1000ms);
+    CHECK(policy.backoff(60, 0.7) == 1000ms);
+  }
+
+  SECTION("jitter shortens the backoff") {
+    const RetryPolicy policy = {.initial_backoff = 100ms, .backoff_factor = 2.0, .max_backoff = 1000ms, .jitter = 0.5};
+    CHECK(policy.backoff(1, 0.0) == 200ms);
+    CHECK(policy.backoff(1, 0.5) == 150ms);
+    CHECK(policy.backoff(1, 1.0) == 100ms);
+    const RetryPolicy full_jitter = {.initial_backoff = 100ms, .jitter = 1.0};
+    CHECK(full_jitter.backoff(0, 1.0) == 0ms);
+    CHECK(full_jitter.backoff(0, 0.25) == 75ms);
+  }
+}
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <chrono>
+#include <utility>
+
+#include <catch2/catch.hpp>
+
+#include "unittests/scheduler_core_helpers.h"
+
+using namespace test_helpers;
+
+namespace {
+// zooms in quickly from high above, the tiles arrive immediately. then the camera settles and the skipped levels are filled in.
+// returns the number of requested tiles and the gpu tiles after the camera settled.
+template <typename Core>
+std::pair<size_t, TileSet> replayFastZoom(unsigned level_skip)
+{
+  Components<Core> components;
+  components.lod_policy.setLevelSkip(level_skip);
+  Core core;
+  auto n_requests = size_t(0);
+  auto camera = makeCamera(500);
+  for (int step = 20; step >= 0; --step) {
+    camera = makeCamera(500);
+    camera.move(camera.zAxis() * (step * 1000.0));
+    n_requests += receiveAll(core, components.context(), updateSkippingLevels(core, components.context(), camera));
+  }
+  n_requests += receiveAll(core, components.context(), core.updateCamera(components.context(), camera));
+  return {n_requests, core.gpuTiles()};
+}
+
+// zooms out and in again a few times, the tiles arrive immediately. returns the number of tiles, that were requested again.
+template <typename Core>
+size_t replayZoomOscillation(std::chrono::seconds min_residency)
+{
+  Components<Core> components;
+  components.lod_policy.setMinResidency(min_residency);
+  Core core;
+  const auto camera = makeCamera(500);
+  auto far_camera = camera;
+  far_camera.move(camera.zAxis() * 2000.0);
+  for (int i = 0; i < 3; ++i) {
+    (void)receiveAll(core, components.context(), core.updateCamera(components.context(), camera));
+    (void)receiveAll(core, components.context(), core.updateCamera(components.context(), far_camera));
+  }
+  return components.lod_policy.statistics().re_requests;
+}
+}
+
+// the behaviour both cores share, the rest is in test_SimplisticSchedulerCore.cpp and test_BasicTreeSchedulerCore.cpp
+TEMPLATE_TEST_CASE("scheduler cores", "", SimplisticSchedulerCore, BasicTreeSchedulerCore) {
+  const auto camera = makeCamera(500);
+  Components<TestType> components;
+  TestType core;
+
+  SECTION("doesn't request descendants of unavailable tiles") {
+    const auto unavailable_tile = srs::TileId { .zoom_level = 8, .coords = { 139, 167 } }; // contains the stephansdom
+    components.unavailable_tiles.insert(unavailable_tile);
+    const auto delta = core.updateCamera(components.context(), camera);
+    REQUIRE(!delta.requested.empty());
+    for (const auto& tile_id : delta.requested)
+      CHECK((tile_id.zoom_level < unavailable_tile.zoom_level || !srs::overlap(tile_id, unavailable_tile)));
+  }
+
+  SECTION("respects the gpu memory budget") {
+    (void)receiveAll(core, components.context(), core.updateCamera(components.context(), camera));
+    REQUIRE(core.gpuTiles().size() > 8);
+
+    const auto budget = GpuMemoryBudget::estimatedBytes(64, 256) * 8;
+    components.gpu_memory.setBudget(budget);
+    const auto requests = core.updateCamera(components.context(), camera);
+    REQUIRE(!requests.requested.empty());
+    for (const auto& tile_id : requests.requested) {
+      // the tree core ships only once all requested tiles arrived
+      const auto delta = core.receiveTile(components.context(), makeTile(tile_id));
+      if (!delta.ready.empty())
+        CHECK(components.gpu_memory.bytes() <= budget);
+    }
+    CHECK(!core.gpuTiles().empty());
+    CHECK(core.gpuTiles().size() <= 8);
+    CHECK(components.gpu_memory.numberOfTiles() == core.gpuTiles().size());
+  }
+
+  SECTION("progressive mode keeps the parents until the children arrive") {
+    const auto context = components.context(true);
+    (void)receiveAll(core, context, core.updateCamera(context, camera));
+    REQUIRE(!core.gpuTiles().empty());
+    CHECK(!containsOverlappingTiles(core.gpuTiles()));
+
+    // move closer, the finer tiles are delivered one by one
+    const auto requests = core.updateCamera(context, makeCamera(250));
+    REQUIRE(!requests.requested.empty());
+    std::vector<srs::TileId> covered_tiles;
+    std::copy_if(requests.requested.begin(), requests.requested.end(), std::back_inserter(covered_tiles), [&](const auto& id) { return isCovered(id, core.gpuTiles()); });
+    REQUIRE(!covered_tiles.empty());
+
+    // nothing that was drawn before disappears, until it is replaced
+    size_t n_expired = requests.expired.size();
+    for (const auto& tile_id : requests.requested) {
+      n_expired += core.receiveTile(context, makeTile(tile_id)).expired.size();
+      const auto gpu_tiles = core.gpuTiles();
+      for (const auto& covered_tile : covered_tiles)
+        CHECK(isCovered(covered_tile, gpu_tiles));
+    }
+    // all tiles arrived, the parents were expired
+    CHECK(n_expired > 0);
+    CHECK(!containsOverlappingTiles(core.gpuTiles()));
+    CHECK(components.gpu_memory.numberOfTiles() == core.gpuTiles().size());
+  }
+
+  SECTION("skipping levels during a fast zoom requests fewer tiles") {
+    const auto [n_requests_without_skipping, gpu_tiles_without_skipping] = replayFastZoom<TestType>(1);
+    const auto [n_requests_with_skipping, gpu_tiles_with_skipping] = replayFastZoom<TestType>(3);
+    CHECK(n_requests_with_skipping < n_requests_without_skipping);
+    CHECK(gpu_tiles_with_skipping == gpu_tiles_without_skipping);
+  }
+
+  SECTION("min residency reduces churn") {
+    const auto n_re_requests_without_residency = replayZoomOscillation<TestType>(std::chrono::seconds(0));
+    const auto n_re_requests_with_residency = replayZoomOscillation<TestType>(std::chrono::seconds(60));
+    CHECK(n_re_requests_without_residency > 0);
+    CHECK(n_re_requests_with_residency < n_re_requests_without_residency);
+  }
+}
+
+// run with: unittests "[benchmark]"
+TEMPLATE_TEST_CASE("scheduler core pan", "[.][benchmark]", SimplisticSchedulerCore, BasicTreeSchedulerCore) {
+  const auto n_updates = 1000;
+  Components<TestType> components;
+  TestType core;
+  size_t n_requests = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n_updates; ++i) {
+    auto camera = makeCamera(500);
+    camera.move({i * 10.0, 0.0, 0.0});
+    // every tile arrives immediately
+    n_requests += receiveAll(core, components.context(), core.updateCamera(components.context(), camera));
+  }
+  const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  WARN(n_updates << " camera updates, " << n_requests << " tiles: " << duration.count() / n_updates << "us per update");
+  CHECK(!hasTilesInTransit(core));
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/SimplisticSchedulerCore.h"
+
+#include <catch2/catch.hpp>
+
+#include "unittests/scheduler_core_helpers.h"
+
+using namespace test_helpers;
+
+// the behaviour shared with the BasicTreeSchedulerCore is tested in test_SchedulerCores.cpp
+TEST_CASE("SimplisticSchedulerCore") {
+  const auto camera = makeCamera(500);
+  Components<SimplisticSchedulerCore> components;
+  SimplisticSchedulerCore core;
+
+  SECTION("requests the visible tiles once") {
+    const auto delta = core.updateCamera(components.context(), camera);
+    REQUIRE(delta.requested.size() >= 10);
+    CHECK(delta.ready.empty());
+    CHECK(delta.expired.empty());
+    CHECK(core.pendingTiles().size() == delta.requested.size());
+    for (const auto& tile_id : delta.requested)
+      CHECK(core.isPending(tile_id));
+    CHECK(core.updateCamera(components.context(), camera).empty());
+  }
+
+  SECTION("received tiles are shipped") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    for (const auto& tile_id : requests.requested) {
+      const auto delta = core.receiveTile(components.context(), makeTile(tile_id));
+      REQUIRE(delta.ready.size() == 1);
+      CHECK(delta.ready.front()->id == tile_id);
+      CHECK(!core.isPending(tile_id));
+    }
+    CHECK(core.pendingTiles().empty());
+    CHECK(core.gpuTiles().size() == requests.requested.size());
+    CHECK(components.gpu_memory.numberOfTiles() == requests.requested.size());
+  }
+
+  SECTION("overlapping tiles are expired") {
+    const auto parent = srs::TileId { 10, { 100, 100 } };
+    CHECK(core.receiveTile(components.context(), makeTile(parent)).expired.empty());
+    const auto delta = core.receiveTile(components.context(), makeTile(srs::subtiles(parent)[0]));
+    REQUIRE(delta.expired.size() == 1);
+    CHECK(delta.expired.front() == parent);
+    CHECK(!core.gpuTiles().contains(parent));
+  }
+
+  SECTION("cached tiles are shipped without request") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    for (const auto& tile_id : requests.requested)
+      components.tile_cache.insert(makeTile(tile_id));
+
+    SimplisticSchedulerCore other_core;
+    const auto delta = other_core.updateCamera(components.context(), camera);
+    CHECK(delta.requested.empty());
+    CHECK(delta.ready.size() == requests.requested.size());
+  }
+
+  SECTION("unavailable tiles are not requested again") {
+    const auto requests = core.updateCamera(components.context(), camera);
+    const auto unavailable_tile = requests.requested.front();
+    core.markTileUnavailable(components.context(), unavailable_tile);
+    CHECK(!core.isPending(unavailable_tile));
+    CHECK(components.unavailable_tiles.contains(unavailable_tile));
+
+    SimplisticSchedulerCore other_core;
+    const auto delta = other_core.updateCamera(components.context(), camera);
+    CHECK(delta.requested.size() == requests.requested.size() - 1);
+  }
+}
@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileArchive.h"
+
+#include <catch2/catch.hpp>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+TEST_CASE("TileArchive") {
+  QTemporaryDir dir;
+  REQUIRE(dir.isValid());
+  const auto path = dir.filePath("tiles.atb");
+  const auto tile_a = srs::TileId{9, {273, 177}};
+  const auto tile_b = srs::TileId{9, {272, 179}};
+  const auto tile_c = srs::TileId{10, {544, 358}};
+
+  SECTION("write and read") {
+    TileArchiveWriter writer(path);
+    // not sorted on purpose
+    CHECK(writer.add(tile_c, "tile c"));
+    CHECK(writer.add(tile_a, "tile a, a bit longer"));
+    CHECK(writer.add(tile_b, "b"));
+    CHECK(!writer.add(tile_b, "b again"));
+    CHECK(writer.numberOfTiles() == 3);
+    REQUIRE(writer.finish());
+
+    TileArchive archive(path);
+    REQUIRE(archive.isValid());
+    CHECK(archive.numberOfTiles() == 3);
+    CHECK(archive.contains(tile_a));
+    CHECK(!archive.contains({9, {273, 178}}));
+    CHECK(archive.tile(tile_a) == QByteArray("tile a, a bit longer"));
+    CHECK(archive.tile(tile_b) == QByteArray("b"));
+    CHECK(archive.tile(tile_c) == QByteArray("tile c"));
+    CHECK(archive.tile({0, {0, 0}}).isEmpty());
+    // sorted by zoom level, x, y
+    CHECK(archive.tileIds() == std::vector<srs::TileId>{tile_b, tile_a, tile_c});
+  }
+
+  SECTION("empty archive") {
+    REQUIRE(TileArchiveWriter(path).finish());
+    TileArchive archive(path);
+    CHECK(archive.isValid());
+    CHECK(archive.numberOfTiles() == 0);
+    CHECK(!archive.contains(tile_a));
+  }
+
+  SECTION("nothing is written without finish") {
+    {
+      TileArchiveWriter writer(path);
+      CHECK(writer.add(tile_a, "tile a"));
+    }
+    CHECK(!QFile::exists(path));
+    CHECK(!TileArchive(path).isValid());
+  }
+
+  SECTION("corrupt archives are invalid") {
+    {
+      TileArchiveWriter writer(path);
+      CHECK(writer.add(tile_a, "tile a"));
+      REQUIRE(writer.finish());
+    }
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::ReadOnly));
+    const auto bytes = file.readAll();
+    file.close();
+    const auto write = [&](const QByteArray& data) {
+      QFile out(path);
+      REQUIRE(out.open(QIODevice::WriteOnly | QIODevice::Truncate));
+      out.write(data);
+    };
+
+    write(bytes.left(bytes.size() - 8)); // truncated index
+    CHECK(!TileArchive(path).isValid());
+    write(bytes.left(16)); // truncated header
+    CHECK(!TileArchive(path).isValid());
+    auto wrong_magic = bytes;
+    wrong_magic[0] = 'X';
+    write(wrong_magic);
+    CHECK(!TileArchive(path).isValid());
+    write(bytes);
+    CHECK(TileArchive(path).isValid());
+  }
+}
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/TileCache.h"
+
+#include <catch2/catch.hpp>
+
+#include "alpine_renderer/Tile.h"
+
+namespace {
+std::shared_ptr<Tile> makeTile(const srs::TileId& id)
+{
+  return std::make_shared<Tile>(id, srs::tile_bounds(id), Raster<uint16_t>(64), QImage(64, 64, QImage::Format_ARGB32));
+}
+}
+
+TEST_CASE("TileCache") {
+  const auto tile_size = TileCache::sizeInBytes(*makeTile({0, {0, 0}}));
+  REQUIRE(tile_size == 64 * 64 * 2 + 64 * 64 * 4);
+
+  SECTION("insert and get") {
+    TileCache cache;
+    CHECK(cache.numberOfTiles() == 0);
+    CHECK(cache.sizeInBytes() == 0);
+    CHECK(!cache.get({0, {0, 0}}));
+
+    cache.insert(makeTile({0, {0, 0}}));
+    cache.insert(makeTile({1, {1, 0}}));
+    CHECK(cache.numberOfTiles() == 2);
+    CHECK(cache.sizeInBytes() == 2 * tile_size);
+    CHECK(cache.contains({1, {1, 0}}));
+    CHECK(!cache.contains({1, {0, 1}}));
+    const auto tile = cache.get({1, {1, 0}});
+    REQUIRE(tile);
+    CHECK(tile->id == srs::TileId{1, {1, 0}});
+
+    // inserting the same id again replaces the old tile
+    cache.insert(makeTile({1, {1, 0}}));
+    CHECK(cache.numberOfTiles() == 2);
+    CHECK(cache.sizeInBytes() == 2 * tile_size);
+
+    cache.erase({0, {0, 0}});
+    CHECK(!cache.contains({0, {0, 0}}));
+    CHECK(cache.sizeInBytes() == tile_size);
+    cache.clear();
+    CHECK(cache.numberOfTiles() == 0);
+    CHECK(cache.sizeInBytes() == 0);
+  }
+
+  SECTION("evicts least recently used tiles when over budget") {
+    TileCache cache(3 * tile_size);
+    cache.insert(makeTile({2, {0, 0}}));
+    cache.insert(makeTile({2, {1, 0}}));
+    cache.insert(makeTile({2, {2, 0}}));
+    CHECK(cache.numberOfTiles() == 3);
+
+    CHECK(cache.get({2, {0, 0}}));  // {2, {1, 0}} is the least recently used now
+    cache.insert(makeTile({2, {3, 0}}));
+    CHECK(cache.numberOfTiles() == 3);
+    CHECK(cache.sizeInBytes() <= cache.byteBudget());
+    CHECK(cache.contains({2, {0, 0}}));
+    CHECK(!cache.contains({2, {1, 0}}));
+    CHECK(cache.contains({2, {2, 0}}));
+    CHECK(cache.contains({2, {3, 0}}));
+    CHECK(cache.statistics().evictions == 1);
+
+    cache.setByteBudget(tile_size);
+    CHECK(cache.numberOfTiles() == 1);
+    CHECK(cache.contains({2, {3, 0}}));
+    CHECK(cache.statistics().evictions == 3);
+
+    cache.setByteBudget(0);
+    CHECK(cache.numberOfTiles() == 0);
+    cache.insert(makeTile({2, {3, 0}}));
+    CHECK(cache.numberOfTiles() == 0);
+  }
+
+  SECTION("hit rate statistics") {
+    TileCache cache;
+    CHECK(cache.statistics().hitRate() == 0);
+    cache.insert(makeTile({0, {0, 0}}));
+    CHECK(cache.get({0, {0, 0}}));
+    CHECK(cache.get({0, {0, 0}}));
+    CHECK(cache.get({0, {0, 0}}));
+    CHECK(!cache.get({1, {0, 0}}));
+    CHECK(cache.contains({1, {0, 0}}) == false); // doesn't count
+    CHECK(cache.statistics().hits == 3);
+    CHECK(cache.statistics().misses == 1);
+    CHECK(cache.statistics().hitRate() == Approx(0.75));
+    cache.resetStatistics();
+    CHECK(cache.statistics().hits == 0);
+    CHECK(cache.statistics().misses == 0);
+  }
+}
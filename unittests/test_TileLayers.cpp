@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/TileLayers.h"
+
+#include <catch2/catch.hpp>
+
+#include "alpine_renderer/Tile.h"
+
+namespace {
+std::shared_ptr<QByteArray> someData()
+{
+  return std::make_shared<QByteArray>("data");
+}
+}
+
+TEST_CASE("TileLayers") {
+  SECTION("registry") {
+    TileLayerRegistry layers;
+    CHECK(layers.size() == 2);
+    CHECK(layers.layer(TileLayerRegistry::height).name == "height");
+    CHECK(layers.layer(TileLayerRegistry::ortho).name == "ortho");
+    CHECK(layers.isRequired(TileLayerRegistry::height));
+    CHECK(layers.isRequired(TileLayerRegistry::ortho));
+
+    const auto snow = layers.add("snow", false);
+    CHECK(snow == 2);
+    CHECK(layers.size() == 3);
+    CHECK(layers.layer(snow).name == "snow");
+    CHECK(!layers.isRequired(snow));
+  }
+
+  SECTION("a tile is complete when all required layers are there") {
+    TileLayerRegistry layers;
+    const auto hillshade = layers.add("hillshade", true);
+    const auto snow = layers.add("snow", false);
+    TileLayerBundles bundles(&layers);
+    const auto id = srs::TileId{3, {1, 2}};
+    CHECK(!bundles.contains(id));
+    CHECK(!bundles.hasRequiredLayers(id));
+
+    bundles.insert(id, snow, someData());
+    CHECK(bundles.contains(id));
+    CHECK(bundles.contains(id, snow));
+    CHECK(!bundles.contains(id, TileLayerRegistry::ortho));
+    bundles.insert(id, TileLayerRegistry::ortho, someData());
+    bundles.insert(id, hillshade, someData());
+    CHECK(!bundles.hasRequiredLayers(id));
+    CHECK(bundles.hasRequiredLayers(id, true)); // e.g., with a height zoom offset
+    bundles.insert(id, TileLayerRegistry::height, someData());
+    CHECK(bundles.hasRequiredLayers(id));
+    CHECK(bundles.numberOfTiles() == 1);
+
+    const auto bundle = bundles.take(id);
+    REQUIRE(bundle.size() == 4);
+    CHECK(bundle[TileLayerRegistry::height]);
+    CHECK(bundle[snow]);
+    CHECK(!bundles.contains(id));
+    CHECK(bundles.take(id).empty());
+  }
+
+  SECTION("optional layers don't block") {
+    TileLayerRegistry layers;
+    layers.add("snow", false);
+    TileLayerBundles bundles(&layers);
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::height, someData());
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::ortho, someData());
+    CHECK(bundles.hasRequiredLayers({1, {0, 0}}));
+  }
+
+  SECTION("one entry per tile") {
+    TileLayerRegistry layers;
+    TileLayerBundles bundles(&layers);
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::height, someData());
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::ortho, someData());
+    bundles.insert({1, {1, 0}}, TileLayerRegistry::ortho, someData());
+    CHECK(bundles.numberOfTiles() == 2);
+    CHECK(bundles.numberOfTilesWith(TileLayerRegistry::height) == 1);
+    CHECK(bundles.numberOfTilesWith(TileLayerRegistry::ortho) == 2);
+    CHECK(bundles.tiles().size() == 2);
+
+    // layers added later
+    const auto snow = layers.add("snow", false);
+    bundles.insert({1, {1, 0}}, snow, someData());
+    CHECK(bundles.contains({1, {1, 0}}, snow));
+    CHECK(!bundles.contains({1, {0, 0}}, snow));
+    CHECK(bundles.numberOfTilesWith(snow) == 1);
+
+    bundles.erase({1, {0, 0}});
+    CHECK(bundles.numberOfTiles() == 1);
+    bundles.clear();
+    CHECK(bundles.numberOfTiles() == 0);
+  }
+
+  SECTION("images decoded on arrival are taken with the bundle") {
+    TileLayerRegistry layers;
+    TileLayerBundles bundles(&layers);
+    QImage decoded(4, 4, QImage::Format_ARGB32);
+    decoded.fill(Qt::red);
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::height, someData());
+    bundles.insert({1, {0, 0}}, TileLayerRegistry::ortho, someData(), decoded);
+
+    TileLayerBundles::Images images;
+    const auto bundle = bundles.take({1, {0, 0}}, &images);
+    REQUIRE(images.size() == 2);
+    CHECK(images[TileLayerRegistry::height].isNull());
+    CHECK(TileLayerBundles::image(bundle, images, TileLayerRegistry::ortho) == decoded); // "data" isn't decoded
+    CHECK(TileLayerBundles::image(bundle, images, TileLayerRegistry::height).isNull());
+    CHECK(TileLayerBundles::makeTile({1, {0, 0}}, Raster<uint16_t>(4), bundle, images)->orthotexture == decoded);
+  }
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_source/TileUrlTemplate.h"
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("TileUrlTemplate") {
+  const srs::TileId tile_id = {.zoom_level = 3, .coords = {3, 2}};
+
+  SECTION("placeholders") {
+    CHECK(TileUrlTemplate("https://tiles.example.com/{z}/{x}/{y}.png").url(tile_id).toStdString() == "https://tiles.example.com/3/3/2.png");
+    CHECK(TileUrlTemplate("https://tiles.example.com/{z}/{-y}/{x}.jpeg").url(tile_id).toStdString() == "https://tiles.example.com/3/5/3.jpeg");
+    CHECK(TileUrlTemplate("https://tiles.example.com/{q}").url(tile_id).toStdString() == "https://tiles.example.com/213"); // the example of bing maps
+    CHECK(TileUrlTemplate::quadkey({.zoom_level = 0, .coords = {0, 0}}).isEmpty());
+    CHECK(TileUrlTemplate::quadkey({.zoom_level = 1, .coords = {1, 1}}).toStdString() == "1");
+    CHECK(TileUrlTemplate("no placeholders").url(tile_id).toStdString() == "no placeholders");
+  }
+
+  SECTION("subdomains are rotated by tile") {
+    const TileUrlTemplate url_template("https://{s}.example.com/{z}/{x}/{y}", {"a", "b", "c"});
+    CHECK(url_template.url({.zoom_level = 3, .coords = {0, 0}}).toStdString() == "https://a.example.com/3/0/0");
+    CHECK(url_template.url({.zoom_level = 3, .coords = {1, 0}}).toStdString() == "https://b.example.com/3/1/0");
+    CHECK(url_template.url({.zoom_level = 3, .coords = {1, 1}}).toStdString() == "https://c.example.com/3/1/1");
+    CHECK(url_template.url({.zoom_level = 3, .coords = {2, 1}}).toStdString() == "https://a.example.com/3/2/1");
+    // always the same url for a tile
+    CHECK(url_template.url(tile_id) == url_template.url(tile_id));
+  }
+
+  SECTION("from a url pattern") {
+    const auto url = [&](TileSource::UrlPattern pattern) { return TileUrlTemplate::fromPattern("http://x/", pattern, ".png").url(tile_id).toStdString(); };
+    CHECK(url(TileSource::UrlPattern::ZXY) == "http://x/3/3/2.png");
+    CHECK(url(TileSource::UrlPattern::ZYX) == "http://x/3/2/3.png");
+    CHECK(url(TileSource::UrlPattern::ZXY_yPointingSouth) == "http://x/3/3/5.png");
+    CHECK(url(TileSource::UrlPattern::ZYX_yPointingSouth) == "http://x/3/5/3.png");
+    for (const auto pattern : {TileSource::UrlPattern::ZXY, TileSource::UrlPattern::ZYX, TileSource::UrlPattern::ZXY_yPointingSouth, TileSource::UrlPattern::ZYX_yPointingSouth})
+      CHECK(url(pattern) == ("http://x/" + TileSource::tileAddress(tile_id, pattern) + ".png").toStdString());
+    CHECK(!TileUrlTemplate::fromPattern("", TileSource::UrlPattern::ZXY, ".png").isValid());
+  }
+
+  SECTION("invalid templates") {
+    CHECK(!TileUrlTemplate().isValid());
+    CHECK(!TileUrlTemplate("").isValid());
+    CHECK(!TileUrlTemplate("https://x/{z}/{x}/{y").isValid());
+    CHECK(!TileUrlTemplate("https://x/{zoom}/{x}/{y}").isValid());
+    CHECK(!TileUrlTemplate("https://{s}.x/{z}/{x}/{y}", {}).isValid());
+    CHECK(TileUrlTemplate("https://x/{z}/{x}/{y}").isValid());
+    CHECK(TileUrlTemplate("https://{s}.x/{z}/{x}/{y}").isValid());
+    CHECK(TileUrlTemplate("https://x/{zoom}").url(tile_id).isEmpty());
+  }
+}
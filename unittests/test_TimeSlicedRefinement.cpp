@@ -0,0 +1,89 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_scheduler/TimeSlicedRefinement.h"
+
+#include <catch2/catch.hpp>
+
+#include "alpine_renderer/tile_scheduler/utils.h"
+
+namespace {
+using TileSet = TimeSlicedRefinement::TileSet;
+TileSet toSet(const std::vector<srs::TileId>& tiles)
+{
+  return {tiles.begin(), tiles.end()};
+}
+bool refine(const srs::TileId& tile_id, double screen_space_error)
+{
+  return tile_id.zoom_level < 16 && screen_space_error >= 4.0;
+}
+}
+
+TEST_CASE("TimeSlicedRefinement") {
+  auto camera = Camera({1822577.0, 6141664.0 - 500, 171.28 + 500}, {1822577.0, 6141664.0, 171.28});
+  camera.setPerspectiveParams(45, {1000, 1000}, 100);
+  const auto expected_leaves = toSet(tile_scheduler::visibleLeaves(camera, 4.0));
+  REQUIRE(expected_leaves.size() >= 10);
+
+  SECTION("finds the same leaves as the on the fly traversal") {
+    TimeSlicedRefinement refinement;
+    CHECK(!refinement.started());
+    refinement.start(camera, refine);
+    CHECK(!refinement.finished());
+    refinement.run();
+    CHECK(refinement.finished());
+    CHECK(toSet(refinement.visibleLeaves()) == expected_leaves);
+    CHECK(refinement.numberOfProcessedTiles() == refinement.leaves().size() + refinement.innerNodes().size());
+    for (const auto& leaf : refinement.leaves())
+      CHECK(!refinement.innerNodes().contains(leaf));
+  }
+
+  SECTION("tiles with a higher screen space error come first") {
+    TimeSlicedRefinement refinement;
+    refinement.start(camera, refine);
+    refinement.run();
+    const auto& leaves = refinement.visibleLeaves();
+    CHECK(tile_scheduler::screenSpaceError(camera, leaves.front()) > tile_scheduler::screenSpaceError(camera, leaves.back()));
+  }
+
+  SECTION("can be suspended and resumed") {
+    TimeSlicedRefinement refinement;
+    refinement.start(camera, refine);
+    size_t n_runs = 0;
+    // a deadline in the past processes one tile per run
+    while (!refinement.run(TimeSlicedRefinement::Clock::time_point {})) {
+      n_runs++;
+      CHECK(refinement.numberOfProcessedTiles() == n_runs);
+    }
+    CHECK(n_runs > 10);
+    CHECK(toSet(refinement.visibleLeaves()) == expected_leaves);
+  }
+
+  SECTION("continues with a new camera") {
+    auto other_camera = Camera({0.0, 0.0 - 500, 0.0 - 500}, {0.0, 0.0, -1000.0});
+    other_camera.setPerspectiveParams(45, {1000, 1000}, 100);
+    TimeSlicedRefinement refinement;
+    refinement.start(other_camera, refine);
+    // the root tile was processed for the old camera
+    refinement.run(TimeSlicedRefinement::Clock::time_point {});
+    refinement.setCamera(camera);
+    refinement.run();
+    CHECK(toSet(refinement.visibleLeaves()) == expected_leaves);
+  }
+}
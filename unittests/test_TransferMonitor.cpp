@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/tile_source/TransferMonitor.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("TransferMonitor") {
+  const auto start = TransferMonitor::Clock::time_point{} + 1h;
+  TransferMonitor monitor(10s);
+
+  SECTION("unknown without transfers") {
+    const auto estimate = monitor.estimate(start);
+    CHECK(estimate.n_transfers == 0);
+    CHECK(estimate.throughput == 0);
+    CHECK(estimate.latency == TransferMonitor::Clock::duration::zero());
+  }
+
+  SECTION("throughput while receiving and latency") {
+    // two parallel transfers receiving from 0.1s to 1.1s, a third one alone from 2.2s to 2.7s
+    monitor.add(start, start + 100ms, start + 1100ms, 100'000);
+    monitor.add(start, start + 100ms, start + 1100ms, 100'000);
+    monitor.add(start + 2s, start + 2200ms, start + 2700ms, 100'000);
+    const auto estimate = monitor.estimate(start + 3s);
+    CHECK(estimate.n_transfers == 3);
+    // 300 kB in 1.5s of receiving, the idle time between doesn't count
+    CHECK(estimate.throughput == Approx(200'000));
+    CHECK(estimate.latency == std::chrono::duration_cast<TransferMonitor::Clock::duration>(400ms) / 3);
+    CHECK(estimate.bytes_per_transfer == Approx(100'000));
+  }
+
+  SECTION("overlapping transfers are counted once") {
+    monitor.add(start, start, start + 1s, 50'000);
+    monitor.add(start, start + 500ms, start + 1500ms, 50'000);
+    CHECK(monitor.estimate(start + 2s).throughput == Approx(100'000 / 1.5));
+  }
+
+  SECTION("old transfers leave the window") {
+    monitor.add(start, start + 1s, start + 2s, 1'000'000);
+    CHECK(monitor.estimate(start + 11s).n_transfers == 1);
+    CHECK(monitor.estimate(start + 13s).n_transfers == 0);
+    monitor.add(start + 5s, start + 5s, start + 15s, 10'000);
+    const auto estimate = monitor.estimate(start + 13s);
+    CHECK(estimate.n_transfers == 1);
+    CHECK(estimate.throughput == Approx(1'000));
+    CHECK(estimate.latency == TransferMonitor::Clock::duration::zero());
+    CHECK(monitor.estimate(start + 30s).n_transfers == 0);
+
+    monitor.clear();
+    CHECK(monitor.estimate(start + 15s).n_transfers == 0);
+  }
+
+  SECTION("answers in one piece") {
+    monitor.add(start, start + 50ms, start + 50ms, 1'000);
+    const auto estimate = monitor.estimate(start + 1s);
+    CHECK(estimate.throughput == Approx(1'000'000)); // 1 kB in at least 1ms
+    CHECK(estimate.latency == std::chrono::duration_cast<TransferMonitor::Clock::duration>(50ms));
+  }
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/UnavailableTileCache.h"
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("UnavailableTileCache") {
+  const auto t0 = UnavailableTileCache::Clock::now();
+
+  SECTION("remembers tiles until they expire") {
+    UnavailableTileCache cache(10s, 0);
+    CHECK(!cache.contains({5, {3, 4}}, t0));
+    cache.insert({5, {3, 4}}, t0);
+    CHECK(cache.size() == 1);
+    CHECK(cache.contains({5, {3, 4}}, t0));
+    CHECK(cache.contains({5, {3, 4}}, t0 + 9s));
+    CHECK(!cache.contains({5, {3, 4}}, t0 + 10s));
+    CHECK(!cache.contains({5, {4, 3}}, t0));
+
+    // reinserting refreshes the entry
+    cache.insert({5, {3, 4}}, t0 + 5s);
+    CHECK(cache.contains({5, {3, 4}}, t0 + 14s));
+
+    cache.removeExpired(t0 + 14s);
+    CHECK(cache.size() == 1);
+    cache.removeExpired(t0 + 15s);
+    CHECK(cache.size() == 0);
+  }
+
+  SECTION("descendants of unavailable tiles are unavailable") {
+    UnavailableTileCache cache(10s, 0);
+    cache.insert({5, {3, 4}}, t0);
+    CHECK(cache.contains({6, {6, 8}}, t0));
+    CHECK(cache.contains({6, {7, 9}}, t0));
+    CHECK(cache.contains({16, {3 << 11, 4 << 11}}, t0));
+    CHECK(cache.contains({16, {(4 << 11) - 1, (5 << 11) - 1}}, t0));
+    CHECK(!cache.contains({16, {4 << 11, 5 << 11}}, t0));
+    CHECK(!cache.contains({6, {8, 8}}, t0));
+    CHECK(!cache.contains({4, {1, 2}}, t0)); // ancestors are not affected
+    CHECK(!cache.contains({6, {6, 8}}, t0 + 10s));
+  }
+
+  SECTION("only tiles on or above the min inheriting zoom level are inherited") {
+    UnavailableTileCache cache(10s, 8);
+    cache.insert({0, {0, 0}}, t0);
+    cache.insert({7, {10, 10}}, t0);
+    cache.insert({8, {30, 30}}, t0);
+    CHECK(cache.contains({0, {0, 0}}, t0));
+    CHECK(!cache.contains({1, {0, 0}}, t0));
+    CHECK(cache.contains({7, {10, 10}}, t0));
+    CHECK(!cache.contains({8, {20, 20}}, t0));
+    CHECK(cache.contains({8, {30, 30}}, t0));
+    CHECK(cache.contains({9, {60, 61}}, t0));
+    CHECK(cache.contains({12, {30 * 16 + 3, 30 * 16 + 15}}, t0));
+
+    cache.setMinInheritingZoomLevel(0);
+    CHECK(cache.contains({8, {20, 20}}, t0));
+  }
+}
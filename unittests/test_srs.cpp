@@ -15,6 +15,8 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
+#include <algorithm>
+
 #include <catch2/catch.hpp>
 
 #include "alpine_renderer/srs.h"
@@ -116,6 +118,31 @@ TEST_CASE("srs tests") {
     }
   }
 
+  SECTION("parent") {
+    CHECK(srs::parent(srs::TileId{.zoom_level = 0, .coords = {0, 0}}) == srs::TileId{.zoom_level = 0, .coords = {0, 0}});
+    CHECK(srs::parent(srs::TileId{.zoom_level = 1, .coords = {1, 0}}) == srs::TileId{.zoom_level = 0, .coords = {0, 0}});
+    CHECK(srs::parent(srs::TileId{.zoom_level = 3, .coords = {5, 2}}) == srs::TileId{.zoom_level = 2, .coords = {2, 1}});
+    for (const auto& tile : srs::subtiles(srs::TileId{.zoom_level = 7, .coords = {42, 17}}))
+      CHECK(srs::parent(tile) == srs::TileId{.zoom_level = 7, .coords = {42, 17}});
+  }
+
+  SECTION("neighbours") {
+    CHECK(srs::neighbours(srs::TileId{.zoom_level = 0, .coords = {0, 0}}).empty());
+    CHECK(srs::neighbours(srs::TileId{.zoom_level = 1, .coords = {0, 0}}).size() == 3);
+    const auto neighbours = srs::neighbours(srs::TileId{.zoom_level = 3, .coords = {5, 2}});
+    CHECK(neighbours.size() == 8);
+    for (const auto& neighbour : neighbours) {
+      CHECK(neighbour.zoom_level == 3);
+      CHECK(neighbour != srs::TileId{.zoom_level = 3, .coords = {5, 2}});
+      CHECK(std::abs(int(neighbour.coords.x) - 5) <= 1);
+      CHECK(std::abs(int(neighbour.coords.y) - 2) <= 1);
+    }
+    // wraps around the antimeridian, but not the poles
+    const auto edge_neighbours = srs::neighbours(srs::TileId{.zoom_level = 3, .coords = {0, 7}});
+    CHECK(edge_neighbours.size() == 5);
+    CHECK(std::find(edge_neighbours.begin(), edge_neighbours.end(), srs::TileId{.zoom_level = 3, .coords = {7, 6}}) != edge_neighbours.end());
+  }
+
   SECTION("overlap") {
     CHECK(srs::overlap(srs::TileId{.zoom_level = 0, .coords = {0, 0}}, srs::TileId{.zoom_level = 0, .coords = {0, 0}}));
     CHECK(!srs::overlap(srs::TileId{.zoom_level = 1, .coords = {0, 0}}, srs::TileId{.zoom_level = 1, .coords = {0, 1}}));
@@ -123,4 +150,30 @@ TEST_CASE("srs tests") {
     CHECK(srs::overlap(srs::TileId{.zoom_level = 1, .coords = {0, 0}}, srs::TileId{.zoom_level = 3, .coords = {2, 1}}));
     CHECK(!srs::overlap(srs::TileId{.zoom_level = 1, .coords = {0, 0}}, srs::TileId{.zoom_level = 3, .coords = {0, 7}}));
   }
+
+  SECTION("tiles overlapping") {
+    const auto tile = srs::TileId{.zoom_level = 2, .coords = {1, 2}};
+    CHECK(srs::tiles_overlapping(srs::tile_bounds(tile), 2) == std::vector<srs::TileId>{tile});
+    CHECK(srs::tiles_overlapping(srs::tile_bounds(tile), 0) == std::vector<srs::TileId>{{.zoom_level = 0, .coords = {0, 0}}});
+    const auto subtiles = srs::subtiles(tile);
+    const auto finer_tiles = srs::tiles_overlapping(srs::tile_bounds(tile), 3);
+    CHECK(finer_tiles.size() == 4);
+    for (const auto& subtile : subtiles)
+      CHECK(std::find(finer_tiles.begin(), finer_tiles.end(), subtile) != finer_tiles.end());
+
+    // vienna, about 10km x 10km
+    const auto vienna = srs::Bounds{.min = {1817577.0, 6136664.0}, .max = {1827577.0, 6146664.0}};
+    const auto vienna_tiles = srs::tiles_overlapping(vienna, 12);
+    CHECK(vienna_tiles.size() >= 4);
+    CHECK(vienna_tiles.size() <= 9);
+    for (const auto& vienna_tile : vienna_tiles) {
+      const auto bounds = srs::tile_bounds(vienna_tile);
+      CHECK(bounds.max.x > vienna.min.x);
+      CHECK(bounds.min.x < vienna.max.x);
+      CHECK(bounds.max.y > vienna.min.y);
+      CHECK(bounds.min.y < vienna.max.y);
+    }
+    // clamped
+    CHECK(srs::tiles_overlapping({.min = {-1e9, -1e9}, .max = {1e9, 1e9}}, 1).size() == 4);
+  }
 }
@@ -137,4 +137,19 @@ SECTION("byte array to raster unsigned short") {
   CHECK(raster.buffer()[1] == 23 * 256 + 186);
 
 }
+
+SECTION("resample height raster") {
+  // first row is north
+  const auto raster = Raster<uint16_t>({200, 210, 220,
+                                        100, 110, 120,
+                                          0,  10,  20}, 3);
+  const auto bounds = srs::Bounds{{0, 0}, {2, 2}};
+  CHECK(tile_conversion::resampleHeightRaster(raster, bounds, bounds, 3).buffer() == raster.buffer());
+
+  // north east quarter
+  const auto quarter = tile_conversion::resampleHeightRaster(raster, bounds, {{1, 1}, {2, 2}}, 2);
+  CHECK(quarter.buffer() == std::vector<uint16_t>({210, 220, 110, 120}));
+  const auto upsampled_quarter = tile_conversion::resampleHeightRaster(raster, bounds, {{1, 1}, {2, 2}}, 3);
+  CHECK(upsampled_quarter.buffer() == std::vector<uint16_t>({210, 215, 220, 160, 165, 170, 110, 115, 120}));
+}
 }
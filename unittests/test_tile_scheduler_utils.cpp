@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/tile_scheduler/utils.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+using TileSet = std::unordered_set<srs::TileId, srs::TileId::Hasher>;
+// the area covered by a set of non overlapping tiles, in units of zoom level 10 tiles
+unsigned long long coveredArea(const std::vector<srs::TileId>& tiles)
+{
+  unsigned long long area = 0;
+  for (const auto& t : tiles)
+    area += 1ull << (2 * (10 - t.zoom_level));
+  return area;
+}
+}
+
+TEST_CASE("tile scheduler utils") {
+  SECTION("coarsen leaves") {
+    std::vector<srs::TileId> leaves;
+    for (const auto& a : srs::subtiles({4, {3, 5}})) {
+      for (const auto& b : srs::subtiles(a))
+        leaves.push_back(b);
+    }
+    leaves.push_back({5, {0, 0}}); // a tile without its siblings
+    REQUIRE(leaves.size() == 17);
+
+    // importance: higher zoom levels are more important, ties broken by x and y
+    const auto importance = [](const srs::TileId& t) { return double(t.zoom_level) * 1000 + t.coords.x + t.coords.y * 0.001; };
+
+    CHECK(tile_scheduler::coarsenLeaves(leaves, 17, importance).size() == 17);
+    CHECK(tile_scheduler::coarsenLeaves(leaves, 100, importance).size() == 17);
+
+    {
+      const auto coarsened = tile_scheduler::coarsenLeaves(leaves, 14, importance);
+      const TileSet coarsened_set(coarsened.begin(), coarsened.end());
+      CHECK(coarsened.size() == 14);
+      // the lonely {5, {0, 0}} is merged up to {2, {0, 0}} first (least important), that doesn't reduce the number of tiles.
+      // {1, {0, 0}} can't be merged, as {2, {0, 1}} is an inner node. then {5, {6, 10}} is merged, being the least important on level 5
+      CHECK(coarsened_set.contains({2, {0, 0}}));
+      CHECK(coarsened_set.contains({5, {6, 10}}));
+      CHECK(coveredArea(coarsened) == coveredArea(leaves));
+    }
+    {
+      const auto coarsened = tile_scheduler::coarsenLeaves(leaves, 2, importance);
+      const TileSet coarsened_set(coarsened.begin(), coarsened.end());
+      CHECK(coarsened.size() == 2);
+      CHECK(coarsened_set.contains({2, {0, 0}}));
+      CHECK(coarsened_set.contains({4, {3, 5}}));
+    }
+    {
+      // merging goes on until the root is reached
+      const auto coarsened = tile_scheduler::coarsenLeaves(leaves, 0, importance);
+      REQUIRE(coarsened.size() == 1);
+      CHECK(coarsened.front() == srs::TileId{0, {0, 0}});
+    }
+  }
+
+  SECTION("skip levels") {
+    const auto every_third_level = [](srs::TileId t) {
+      while (t.zoom_level % 3 != 0)
+        t = srs::parent(t);
+      return t;
+    };
+    {
+      const auto tiles = tile_scheduler::skipLevels({{6, {10, 20}}, {7, {0, 0}}, {8, {2, 0}}, {5, {4, 4}}}, every_third_level);
+      REQUIRE(tiles.size() == 3);
+      CHECK(tiles[0] == srs::TileId{6, {10, 20}});
+      CHECK(tiles[1] == srs::TileId{6, {0, 0}});
+      CHECK(tiles[2] == srs::TileId{3, {1, 1}});
+    }
+    {
+      // {8, {20, 0}} is not below {5, {0, 0}}, but the tile it is replaced with is below {3, {0, 0}}
+      const auto tiles = tile_scheduler::skipLevels({{8, {20, 0}}, {5, {0, 0}}}, every_third_level);
+      REQUIRE(tiles.size() == 1);
+      CHECK(tiles[0] == srs::TileId{3, {0, 0}});
+    }
+  }
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+// minimal http server on localhost. answers every GET with "tile <path>" (or the given body), or with 404 for the missing paths.
+// failing paths are answered with 503 the given number of times, the next answer for a slow path is delayed by the given milliseconds.
+// every answer is delayed by the latency. paths with an etag are answered with 304, if the request's if-none-match matches.
+// with bytes per second, the answers are sent in chunks, as if all connections shared a link of that bandwidth.
+class LocalTileServer : public QObject
+{
+  Q_OBJECT
+public:
+  LocalTileServer() {
+    m_clock.start();
+    connect(&m_server, &QTcpServer::newConnection, this, &LocalTileServer::accept);
+    m_server.listen(QHostAddress::LocalHost);
+  }
+  [[nodiscard]] bool isListening() const { return m_server.isListening(); }
+  [[nodiscard]] QString baseUrl() const { return QString("http://127.0.0.1:%1/").arg(m_server.serverPort()); }
+  static QByteArray payload(const QString& path) { return "tile " + path.toUtf8(); }
+
+  QSet<QString> missing_paths;
+  QHash<QString, QByteArray> bodies; // instead of the payload
+  QHash<QString, int> failing_paths;
+  QHash<QString, int> slow_paths;
+  QHash<QString, QByteArray> etags;
+  QByteArray cache_control; // sent with every 200 and 304, if not empty
+  int latency_in_ms = 0;
+  int bytes_per_second = 0; // unthrottled, if 0
+  int n_requests = 0;
+  int n_not_modified = 0;
+
+private:
+  void accept() {
+    while (auto* socket = m_server.nextPendingConnection()) {
+      connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { respond(socket); });
+      connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+  }
+
+  void respond(QTcpSocket* socket) {
+    // connections are kept alive, several requests can arrive at once. they have no body and end with an empty line.
+    auto& buffer = m_buffers[socket];
+    buffer += socket->readAll();
+    for (auto end = buffer.indexOf("\r\n\r\n"); end >= 0; end = buffer.indexOf("\r\n\r\n")) {
+      const auto lines = buffer.left(end).split('\n');
+      buffer.remove(0, end + 4);
+      const auto path = QString::fromUtf8(lines.value(0).split(' ').value(1));
+      QByteArray if_none_match;
+      for (const auto& line : lines) {
+        if (line.toLower().startsWith("if-none-match:"))
+          if_none_match = line.mid(14).trimmed();
+      }
+      n_requests++;
+      const auto response = answer(path, if_none_match);
+      const auto delay = latency_in_ms + slow_paths.value(path);
+      slow_paths.remove(path);
+      if (bytes_per_second > 0) {
+        sendThrottled(socket, response, delay);
+        continue;
+      }
+      if (delay > 0) {
+        QTimer::singleShot(delay, socket, [socket, response]() { socket->write(response); });
+        continue;
+      }
+      socket->write(response);
+    }
+  }
+
+  QByteArray answer(const QString& path, const QByteArray& if_none_match) {
+    if (missing_paths.contains(path))
+      return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    if (failing_paths.value(path) > 0) {
+      failing_paths[path]--;
+      return "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+    }
+    QByteArray headers;
+    if (etags.contains(path))
+      headers += "ETag: " + etags.value(path) + "\r\n";
+    if (!cache_control.isEmpty())
+      headers += "Cache-Control: " + cache_control + "\r\n";
+    if (etags.contains(path) && etags.value(path) == if_none_match) {
+      n_not_modified++;
+      return "HTTP/1.1 304 Not Modified\r\n" + headers + "\r\n";
+    }
+    const auto body = bodies.value(path, payload(path));
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n" + headers + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+  }
+
+  void sendThrottled(QTcpSocket* socket, const QByteArray& response, int delay) {
+    // the chunks of all answers are queued on the link, one after the other
+    const auto chunk_size = std::max(1, bytes_per_second / 50);
+    const auto now = m_clock.elapsed();
+    auto sent_at = std::max(now + delay, m_link_free_at);
+    for (qsizetype offset = 0; offset < response.size(); offset += chunk_size) {
+      const auto chunk = response.mid(offset, chunk_size);
+      sent_at += qint64(chunk.size()) * 1000 / bytes_per_second;
+      QTimer::singleShot(int(sent_at - now), socket, [socket, chunk]() { socket->write(chunk); });
+    }
+    m_link_free_at = sent_at;
+  }
+
+  QTcpServer m_server;
+  QHash<QTcpSocket*, QByteArray> m_buffers;
+  QElapsedTimer m_clock;
+  qint64 m_link_free_at = 0; // in ms of the clock
+};
@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#include "alpine_renderer/TileLoadService.h"
+#include "alpine_renderer/tile_scheduler/SimplisticTileScheduler.h"
+
+#include <QTest>
+
+#include "alpine_renderer/Camera.h"
+#include "LocalTileServer.h"
+
+// downloads from a throttled local server, the measured throughput and latency should make the lod coarser.
+class TestBandwidthAdaptation : public QObject
+{
+  Q_OBJECT
+  static constexpr unsigned n_tiles = 6;
+  static constexpr int tile_size = 32 * 1024;
+  static constexpr int latency_in_ms = 20;
+
+  static void serveTiles(LocalTileServer& server) {
+    server.latency_in_ms = latency_in_ms;
+    for (unsigned i = 0; i < n_tiles; ++i)
+      server.bodies[QString("/12/%1/0.png").arg(i)] = QByteArray(tile_size, 'x');
+  }
+
+  // estimate is the last one, that was signalled
+  static void downloadTiles(TileLoadService& service, TransferEstimate& estimate) {
+    unsigned n_received = 0;
+    const auto ready_connection = connect(&service, &TileLoadService::loadReady, &service, [&]() { n_received++; });
+    const auto estimate_connection = connect(&service, &TileLoadService::transferEstimateUpdated, &service, [&](const TransferEstimate& e) { estimate = e; });
+    for (unsigned i = 0; i < n_tiles; ++i)
+      service.load({.zoom_level = 12, .coords = {i, 0}});
+    QVERIFY(QTest::qWaitFor([&]() { return n_received == n_tiles; }, 20000));
+    disconnect(ready_connection);
+    disconnect(estimate_connection);
+  }
+
+private slots:
+  void measuresThroughputAndLatency() {
+    LocalTileServer server;
+    QVERIFY(server.isListening());
+    serveTiles(server);
+    server.bytes_per_second = 256 * 1024;
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    TransferEstimate estimate;
+    downloadTiles(service, estimate);
+    QCOMPARE(estimate.n_transfers, size_t(n_tiles));
+    QCOMPARE(estimate.bytes_per_transfer, double(tile_size));
+    QVERIFY(estimate.latency >= std::chrono::milliseconds(latency_in_ms));
+    // the first chunk of every answer arrives before the receiving starts, so it is a bit faster than the link
+    QVERIFY(estimate.throughput > 0.5 * server.bytes_per_second);
+    QVERIFY(estimate.throughput < 2.0 * server.bytes_per_second);
+    QCOMPARE(service.transferEstimate().n_transfers, size_t(n_tiles));
+  }
+
+  void coarserLodOnSlowLinks_data() {
+    QTest::addColumn<int>("bytes_per_second");
+    QTest::addColumn<bool>("coarser");
+    QTest::newRow("unthrottled") << 0 << false;
+    QTest::newRow("256 KiB/s") << 256 * 1024 << true;
+  }
+
+  void coarserLodOnSlowLinks() {
+    QFETCH(int, bytes_per_second);
+    QFETCH(bool, coarser);
+    LocalTileServer server;
+    QVERIFY(server.isListening());
+    serveTiles(server);
+    server.bytes_per_second = bytes_per_second;
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+
+    // wired as in alpine_gl_renderer
+    SimplisticTileScheduler scheduler;
+    scheduler.lodController().setEnabled(true);
+    scheduler.lodController().setMaxDownloadBacklog(std::chrono::milliseconds(500));
+    connect(&service, &TileLoadService::transferEstimateUpdated, &scheduler, &TileScheduler::updateOrthoTransferEstimate);
+    TransferEstimate estimate;
+    downloadTiles(service, estimate);
+
+    // the first update requests the tiles, the second one sees them in transit (nothing delivers them).
+    // at 256 KiB/s, the 32 KiB height and ortho parts of 10 or more tiles take more than a second.
+    auto camera = Camera({1822577.0, 6141664.0 - 500, 171.28 + 500}, {1822577.0, 6141664.0, 171.28});
+    camera.setPerspectiveParams(45, {1000, 1000}, 100);
+    scheduler.updateCamera(camera);
+    QVERIFY(scheduler.numberOfTilesInTransit() >= 10);
+    scheduler.updateCamera(camera);
+    const auto lod = scheduler.statistics().lod;
+    QCOMPARE(lod.limit == AdaptiveLodController::Limit::Bandwidth, coarser);
+    QCOMPARE(lod.threshold_scale > 1.0, coarser);
+    QVERIFY(lod.latency >= std::chrono::milliseconds(latency_in_ms));
+    QVERIFY(lod.throughput >= estimate.throughput);
+  }
+};
+
+QTEST_MAIN(TestBandwidthAdaptation)
+#include "qtest_BandwidthAdaptation.moc"
@@ -0,0 +1,181 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileDiskCache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestTileDiskCache : public QObject
+{
+  Q_OBJECT
+private:
+  const srs::TileId m_tile_a = {.zoom_level = 9, .coords = {273, 177}};
+  const srs::TileId m_tile_b = {.zoom_level = 9, .coords = {272, 179}};
+  const srs::TileId m_tile_c = {.zoom_level = 10, .coords = {544, 358}};
+
+private slots:
+  void writeAndRead() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    TileDiskCache cache(dir.path());
+    QVERIFY(!cache.read("ortho", m_tile_a));
+    QVERIFY(cache.write("ortho", m_tile_a, "ortho a"));
+    QVERIFY(cache.write("height", m_tile_a, "height a"));
+    QVERIFY(cache.contains("ortho", m_tile_a));
+    QVERIFY(!cache.contains("ortho", m_tile_b));
+    QCOMPARE(cache.numberOfTiles(), size_t(2));
+    QCOMPARE(cache.sizeInBytes(), size_t(7 + 8));
+
+    const auto data = cache.read("ortho", m_tile_a);
+    QVERIFY(data);
+    QCOMPARE(*data, QByteArray("ortho a"));
+    QCOMPARE(*cache.read("height", m_tile_a), QByteArray("height a"));
+
+    // replaces the old file
+    QVERIFY(cache.write("ortho", m_tile_a, "new"));
+    QCOMPARE(*cache.read("ortho", m_tile_a), QByteArray("new"));
+    QCOMPARE(cache.sizeInBytes(), size_t(3 + 8));
+    QCOMPARE(cache.statistics().hits, size_t(3));
+    QCOMPARE(cache.statistics().misses, size_t(1));
+
+    cache.erase("ortho", m_tile_a);
+    QVERIFY(!cache.read("ortho", m_tile_a));
+    cache.clear();
+    QCOMPARE(cache.numberOfTiles(), size_t(0));
+    QCOMPARE(cache.sizeInBytes(), size_t(0));
+  }
+
+  void persistsAcrossInstances() {
+    QTemporaryDir dir;
+    {
+      TileDiskCache cache(dir.path());
+      QVERIFY(cache.write("ortho", m_tile_a, "ortho a"));
+      QVERIFY(cache.write("ortho", m_tile_b, "ortho b"));
+    }
+    // a file of an interrupted write is removed
+    QFile left_over(dir.filePath("ortho/9/273/177.tile.AbCdEf"));
+    QVERIFY(left_over.open(QIODevice::WriteOnly));
+    left_over.write("trunc");
+    left_over.close();
+
+    TileDiskCache cache(dir.path());
+    QCOMPARE(cache.numberOfTiles(), size_t(2));
+    QCOMPARE(cache.sizeInBytes(), size_t(14));
+    QCOMPARE(*cache.read("ortho", m_tile_a), QByteArray("ortho a"));
+    QCOMPARE(*cache.read("ortho", m_tile_b), QByteArray("ortho b"));
+    QVERIFY(!QFile::exists(dir.filePath("ortho/9/273/177.tile.AbCdEf")));
+  }
+
+  void leavesForeignFilesAlone() {
+    // e.g., a staging directory of alpine_tile_packer, that holds other files as well
+    QTemporaryDir dir;
+    const auto foreign_files = QStringList{"notes.txt", "photo.tile", "ortho/readme.md", "ortho/9/273/backup.tile", "ortho/9/273/177.png", "a/b/c/d/1.tile.x"};
+    for (const auto& name : foreign_files) {
+      QDir().mkpath(QFileInfo(dir.filePath(name)).absolutePath());
+      QFile file(dir.filePath(name));
+      QVERIFY(file.open(QIODevice::WriteOnly));
+      file.write("foreign");
+    }
+    TileDiskCache cache(dir.path(), 0);
+    QCOMPARE(cache.numberOfTiles(), size_t(0));
+    QCOMPARE(cache.sizeInBytes(), size_t(0));
+    cache.clear();
+    for (const auto& name : foreign_files)
+      QVERIFY(QFile::exists(dir.filePath(name)));
+  }
+
+  void evictsLeastRecentlyUsedTiles() {
+    QTemporaryDir dir;
+    {
+      TileDiskCache cache(dir.path(), 20);
+      QVERIFY(cache.write("ortho", m_tile_a, "ortho a"));
+      QTest::qWait(20); // the order is rebuilt from the modification times
+      QVERIFY(cache.write("ortho", m_tile_b, "ortho b"));
+      QTest::qWait(20);
+      QVERIFY(cache.read("ortho", m_tile_a)); // b is the least recently used now
+      QTest::qWait(20);
+      QVERIFY(cache.write("ortho", m_tile_c, "ortho c"));
+      QCOMPARE(cache.numberOfTiles(), size_t(2));
+      QVERIFY(cache.sizeInBytes() <= cache.byteBudget());
+      QVERIFY(cache.contains("ortho", m_tile_a));
+      QVERIFY(!cache.contains("ortho", m_tile_b));
+      QVERIFY(cache.contains("ortho", m_tile_c));
+      QCOMPARE(cache.statistics().evictions, size_t(1));
+    }
+    // c was written after a was read last
+    TileDiskCache cache(dir.path(), 10);
+    QCOMPARE(cache.numberOfTiles(), size_t(1));
+    QVERIFY(cache.contains("ortho", m_tile_c));
+    QVERIFY(!QFile::exists(dir.filePath("ortho/9/273/177.tile")));
+  }
+
+  void readsAsync() {
+    QTemporaryDir dir;
+    TileDiskCache cache(dir.path());
+    QVERIFY(cache.write("ortho", m_tile_a, "ortho a"));
+    cache.writeAsync("ortho", m_tile_b, std::make_shared<QByteArray>("ortho b"));
+
+    QSignalSpy spy(&cache, &TileDiskCache::readFinished);
+    cache.readAsync("ortho", m_tile_a);
+    cache.readAsync("ortho", m_tile_b);
+    cache.readAsync("ortho", m_tile_c);
+    QTRY_COMPARE(spy.count(), 3);
+    QCOMPARE(*spy.at(0).at(2).value<std::shared_ptr<QByteArray>>(), QByteArray("ortho a"));
+    QCOMPARE(*spy.at(1).at(2).value<std::shared_ptr<QByteArray>>(), QByteArray("ortho b")); // the io thread handles the requests in order
+    QCOMPARE(spy.at(2).at(1).value<srs::TileId>(), m_tile_c);
+    QVERIFY(!spy.at(2).at(2).value<std::shared_ptr<QByteArray>>());
+  }
+
+  void storesMetadata() {
+    QTemporaryDir dir;
+    const auto metadata = TileDiskCache::Metadata{.etag = "\"v1\"", .last_modified = "Tue, 15 Nov 1994 12:45:26 GMT", .fresh_until = 1000};
+    {
+      TileDiskCache cache(dir.path());
+      QVERIFY(cache.write("ortho", m_tile_a, "ortho a", metadata));
+      QVERIFY(cache.write("ortho", m_tile_b, "ortho b"));
+      QVERIFY(cache.readWithMetadata("ortho", m_tile_a).metadata.hasValidators());
+    }
+    TileDiskCache cache(dir.path());
+    const auto cached = cache.readWithMetadata("ortho", m_tile_a);
+    QVERIFY(cached.data);
+    QCOMPARE(*cached.data, QByteArray("ortho a")); // without the header
+    QCOMPARE(cached.metadata.etag, metadata.etag);
+    QCOMPARE(cached.metadata.last_modified, metadata.last_modified);
+    QCOMPARE(cached.metadata.fresh_until, qint64(1000));
+    QVERIFY(cached.metadata.isFresh(999));
+    QVERIFY(!cached.metadata.isFresh(1000));
+    // tiles without metadata are stored as they are, and are always stale
+    QCOMPARE(*cache.read("ortho", m_tile_b), QByteArray("ortho b"));
+    QVERIFY(!cache.readWithMetadata("ortho", m_tile_b).metadata.hasValidators());
+    QVERIFY(!cache.readWithMetadata("ortho", m_tile_b).metadata.isFresh(0));
+
+    // only the metadata changes, e.g., after a 304
+    QVERIFY(cache.updateMetadata("ortho", m_tile_a, {.etag = "\"v1\"", .last_modified = {}, .fresh_until = 2000}));
+    QCOMPARE(*cache.read("ortho", m_tile_a), QByteArray("ortho a"));
+    QCOMPARE(cache.readWithMetadata("ortho", m_tile_a).metadata.fresh_until, qint64(2000));
+    QVERIFY(!cache.updateMetadata("ortho", m_tile_c, metadata));
+  }
+};
+
+QTEST_MAIN(TestTileDiskCache)
+#include "qtest_TileDiskCache.moc"
@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileLoadService.h"
+
+#include <QElapsedTimer>
+#include <QTest>
+#include <QUrl>
+
+#include "LocalTileServer.h"
+
+// download throughput against local servers with latency. each server stands in for one host (subdomain) of a sharded tile server.
+class TestTileDownloadThroughput : public QObject
+{
+  Q_OBJECT
+  static constexpr unsigned n_tiles = 96;
+  static constexpr unsigned n_shards = 4;
+  std::vector<std::unique_ptr<LocalTileServer>> m_servers;
+
+  [[nodiscard]] QStringList ports() const {
+    QStringList ports;
+    for (const auto& server : m_servers)
+      ports.push_back(QString::number(QUrl(server->baseUrl()).port()));
+    return ports;
+  }
+
+  [[nodiscard]] std::unique_ptr<TileLoadService> makeService(bool sharded, unsigned connections_per_host) const {
+    const auto url_template = sharded ? TileUrlTemplate("http://127.0.0.1:{s}/{z}/{x}/{y}.png", ports())
+                                      : TileUrlTemplate(m_servers.front()->baseUrl() + "{z}/{x}/{y}.png");
+    auto service = std::make_unique<TileLoadService>(url_template);
+    service->setConnectionsPerHost(connections_per_host);
+    return service;
+  }
+
+  // every tile is downloaded again, the service only coalesces requests, that are in flight
+  static void downloadTiles(TileLoadService& service) {
+    unsigned n_received = 0;
+    const auto connection = connect(&service, &TileLoadService::loadReady, &service, [&]() { n_received++; });
+    for (unsigned i = 0; i < n_tiles; ++i)
+      service.load({.zoom_level = 12, .coords = {i, 0}});
+    QVERIFY(QTest::qWaitFor([&]() { return n_received == n_tiles; }, 20000));
+    disconnect(connection);
+  }
+
+  static qint64 timeDownload(TileLoadService& service) {
+    QElapsedTimer timer;
+    timer.start();
+    downloadTiles(service);
+    return timer.elapsed();
+  }
+
+private slots:
+  void initTestCase() {
+    for (unsigned i = 0; i < n_shards; ++i) {
+      m_servers.push_back(std::make_unique<LocalTileServer>());
+      QVERIFY(m_servers.back()->isListening());
+      m_servers.back()->latency_in_ms = 20;
+    }
+  }
+
+  void throughput_data() {
+    QTest::addColumn<bool>("sharded");
+    QTest::addColumn<unsigned>("connections_per_host");
+    QTest::newRow("one host") << false << 0u;
+    QTest::newRow("one host, 24 connections") << false << 24u;
+    QTest::newRow("4 shards") << true << 0u;
+  }
+
+  void throughput() {
+    QFETCH(bool, sharded);
+    QFETCH(unsigned, connections_per_host);
+    const auto service = makeService(sharded, connections_per_host);
+    QBENCHMARK {
+      downloadTiles(*service);
+    }
+  }
+
+  void shardingIncreasesThroughput() {
+    const auto single_host = makeService(false, 0);
+    const auto sharded = makeService(true, 0);
+    // warm up the connections
+    downloadTiles(*single_host);
+    downloadTiles(*sharded);
+    const auto single_host_time = timeDownload(*single_host);
+    const auto sharded_time = timeDownload(*sharded);
+    qDebug() << "one host:" << single_host_time << "ms," << n_shards << "shards:" << sharded_time << "ms for" << n_tiles << "tiles";
+    QVERIFY(sharded_time < single_host_time);
+    int n_requests = 0;
+    for (const auto& server : m_servers) {
+      if (server.get() != m_servers.front().get())
+        QVERIFY(server->n_requests > 0);
+      n_requests += server->n_requests;
+    }
+    QVERIFY(n_requests >= int(4 * n_tiles));
+  }
+};
+
+QTEST_MAIN(TestTileDownloadThroughput)
+#include "qtest_TileDownloadThroughput.moc"
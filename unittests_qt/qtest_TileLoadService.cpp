@@ -17,11 +17,16 @@
  *****************************************************************************/
 
 #include "alpine_renderer/TileLoadService.h"
+#include "alpine_renderer/TileDiskCache.h"
 #include "alpine_renderer/utils/tile_conversion.h"
+#include "LocalTileServer.h"
 #include <algorithm>
 
+#include <QBuffer>
 #include <QTest>
+#include <QDateTime>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 
 class TestTileLoadService: public QObject
 {
@@ -101,6 +106,291 @@ private slots:
     QCOMPARE(arguments.at(0).value<srs::TileId>(), unavailable_tile_id); // verify the first argument
 
   }
+
+  void servesTilesFromTheDiskCache() {
+    QTemporaryDir dir;
+    const auto cached_tile_id = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    const auto missing_tile_id = srs::TileId{.zoom_level = 9, .coords = {272, 179}};
+    auto disk_cache = std::make_shared<TileDiskCache>(dir.path());
+    QVERIFY(disk_cache->write("ortho", cached_tile_id, "cached"));
+
+    // nothing listens there, so a hit can't come from the network
+    TileLoadService service("http://127.0.0.1:1/", TileLoadService::UrlPattern::ZYX, ".jpeg");
+    service.setDiskCache(disk_cache, "ortho");
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    service.load(cached_tile_id);
+    service.load(missing_tile_id);
+    QTRY_COMPARE(ready_spy.count() + unavailable_spy.count(), 2);
+    QCOMPARE(ready_spy.count(), 1);
+    QCOMPARE(ready_spy.front().at(0).value<srs::TileId>(), cached_tile_id);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("cached"));
+    // the miss went to the network
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), missing_tile_id);
+  }
+
+  void coalescesRequestsForTilesInFlight() {
+    LocalTileServer server;
+    QVERIFY(server.isListening());
+    const auto tile_a = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    const auto tile_b = srs::TileId{.zoom_level = 9, .coords = {272, 179}};
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    service.load(tile_a);
+    service.prefetch(tile_a);
+    service.load(tile_a);
+    service.load(tile_b);
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(2));
+    QTRY_COMPARE(ready_spy.count(), 2);
+    QTest::qWait(10);
+    QCOMPARE(ready_spy.count(), 2); // answered once per tile
+    QCOMPARE(unavailable_spy.count(), 0);
+    QCOMPARE(server.n_requests, 2);
+    QCOMPARE(service.statistics().n_downloads, size_t(2));
+    QCOMPARE(service.statistics().n_coalesced_requests, size_t(2));
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(0));
+
+    // not in flight anymore, so it is downloaded again
+    service.load(tile_a);
+    QTRY_COMPARE(ready_spy.count(), 3);
+    QCOMPARE(server.n_requests, 3);
+    QCOMPARE(*ready_spy.back().at(1).value<std::shared_ptr<QByteArray>>(), LocalTileServer::payload("/9/273/177.png"));
+  }
+
+  void retriesTransientErrors() {
+    LocalTileServer server;
+    const auto flaky_tile = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    const auto missing_tile = srs::TileId{.zoom_level = 9, .coords = {272, 179}};
+    server.failing_paths["/9/273/177.png"] = 2;
+    server.missing_paths.insert("/9/272/179.png");
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setRetryPolicy({.max_retries = 3, .initial_backoff = std::chrono::milliseconds(10)});
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    service.load(flaky_tile);
+    service.load(missing_tile);
+    QTRY_COMPARE(ready_spy.count() + unavailable_spy.count(), 2);
+    QCOMPARE(ready_spy.count(), 1);
+    QCOMPARE(ready_spy.front().at(0).value<srs::TileId>(), flaky_tile);
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), missing_tile);
+    // 404 is not retried
+    QCOMPARE(server.n_requests, 3 + 1);
+    QCOMPARE(service.statistics().n_retries, size_t(2));
+    QCOMPARE(service.statistics().n_failed_downloads, size_t(1));
+
+    // after the last retry, the tile is not reported unavailable. it is sent again after the open duration of the breaker.
+    service.setCircuitBreakerPolicy(0, std::chrono::milliseconds(100));
+    server.failing_paths["/9/273/177.png"] = 4;
+    service.load(flaky_tile);
+    QTRY_COMPARE(service.statistics().n_postponed_downloads, size_t(1));
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(1));
+    QTRY_COMPARE(ready_spy.count(), 2);
+    QCOMPARE(unavailable_spy.count(), 1);
+    QCOMPARE(service.statistics().n_retries, size_t(2 + 3));
+    QCOMPARE(server.n_requests, 3 + 1 + 4 + 1);
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(0));
+
+    // unless waiting for failing hosts is off
+    service.setWaitForFailingHosts(false);
+    server.failing_paths["/9/273/177.png"] = 10;
+    service.load(flaky_tile);
+    QTRY_COMPARE(unavailable_spy.count(), 2);
+    QCOMPARE(service.statistics().n_failed_downloads, size_t(2));
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(0));
+  }
+
+  void hedgesSlowRequests() {
+    LocalTileServer server;
+    const auto tile_id = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    server.slow_paths["/9/273/177.png"] = 2000;
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setHedgeDelay(std::chrono::milliseconds(20));
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    service.load(tile_id);
+    QVERIFY(ready_spy.wait(1000)); // long before the slow answer
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), LocalTileServer::payload("/9/273/177.png"));
+    QCOMPARE(server.n_requests, 2);
+    QCOMPARE(service.statistics().n_hedged_requests, size_t(1));
+    QCOMPARE(service.statistics().n_hedges_won, size_t(1));
+    QTest::qWait(50);
+    QCOMPARE(ready_spy.count(), 1);
+  }
+
+  void circuitBreakerStopsRequestsToAFailingHost() {
+    LocalTileServer server;
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setRetryPolicy({.max_retries = 0});
+    service.setCircuitBreakerPolicy(3, std::chrono::milliseconds(200));
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    for (unsigned x = 0; x < 3; ++x) {
+      server.failing_paths[QString("/9/%1/177.png").arg(x)] = 1;
+      service.load({.zoom_level = 9, .coords = {x, 177}});
+    }
+    QTRY_COMPARE(service.statistics().n_postponed_downloads, size_t(3));
+    QCOMPARE(service.circuitBreakerState("127.0.0.1"), CircuitBreaker::State::Open);
+
+    // not sent, and not reported unavailable (that would put it into the unavailable tile cache of the scheduler)
+    service.load({.zoom_level = 9, .coords = {3, 177}});
+    QCOMPARE(server.n_requests, 3);
+    QCOMPARE(service.statistics().n_short_circuited_requests, size_t(1));
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(4));
+
+    // after the open period, the first one is the probe. it closes the breaker, then the others are sent.
+    QTRY_COMPARE(ready_spy.count(), 4);
+    QCOMPARE(service.circuitBreakerState("127.0.0.1"), CircuitBreaker::State::Closed);
+    QCOMPARE(server.n_requests, 3 + 4);
+    QCOMPARE(unavailable_spy.count(), 0);
+    QCOMPARE(service.numberOfDownloadsInFlight(), size_t(0));
+  }
+
+  void failedProbeKeepsTheTilesWaiting() {
+    LocalTileServer server;
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setRetryPolicy({.max_retries = 0});
+    service.setCircuitBreakerPolicy(1, std::chrono::milliseconds(100));
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    server.failing_paths["/9/0/177.png"] = 2;
+    service.load({.zoom_level = 9, .coords = {0, 177}});
+    QTRY_COMPARE(service.circuitBreakerState("127.0.0.1"), CircuitBreaker::State::Open);
+    service.load({.zoom_level = 9, .coords = {1, 177}});
+
+    // the first probe fails and opens it again, the second one closes it
+    QTRY_COMPARE(ready_spy.count(), 2);
+    QCOMPARE(server.n_requests, 1 + 1 + 2);
+    QCOMPARE(unavailable_spy.count(), 0);
+  }
+
+  void decodesTilesOnArrival() {
+    LocalTileServer server;
+    const auto image_tile = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    const auto broken_tile = srs::TileId{.zoom_level = 9, .coords = {272, 179}};
+    QImage image(16, 16, QImage::Format_RGB32);
+    image.fill(Qt::green);
+    QBuffer png;
+    png.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&png, "PNG"));
+    server.bodies["/9/273/177.png"] = png.data();
+    server.latency_in_ms = 10;
+
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setDecodeOnArrival(true);
+    QSignalSpy image_spy(&service, &TileLoadService::imageReady);
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    service.load(image_tile);
+    service.load(broken_tile);
+    QTRY_COMPARE(image_spy.count() + ready_spy.count(), 2);
+    QCOMPARE(image_spy.count(), 1);
+    QCOMPARE(image_spy.front().at(0).value<srs::TileId>(), image_tile);
+    QCOMPARE(*image_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), png.data());
+    QCOMPARE(image_spy.front().at(2).value<QImage>().convertToFormat(QImage::Format_RGB32), image);
+    // can't be decoded, the consumer gets the bytes
+    QCOMPARE(ready_spy.front().at(0).value<srs::TileId>(), broken_tile);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), LocalTileServer::payload("/9/272/179.png"));
+    QCOMPARE(service.statistics().n_decoded_on_arrival, size_t(1));
+  }
+
+  void revalidatesStaleTiles() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    const auto tile_id = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    server.etags["/9/273/177.png"] = "\"v1\"";
+    server.cache_control = "max-age=0";
+    auto disk_cache = std::make_shared<TileDiskCache>(dir.path());
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setDiskCache(disk_cache, "ortho");
+    service.setStaleWhileRevalidate(false);
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 1);
+    QTRY_VERIFY(disk_cache->contains("ortho", tile_id));
+    QCOMPARE(disk_cache->readWithMetadata("ortho", tile_id).metadata.etag, QByteArray("\"v1\""));
+
+    // stale right away (max-age=0), the server confirms it with a 304
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 2);
+    QCOMPARE(*ready_spy.back().at(1).value<std::shared_ptr<QByteArray>>(), LocalTileServer::payload("/9/273/177.png"));
+    QCOMPARE(server.n_requests, 2);
+    QCOMPARE(server.n_not_modified, 1);
+    QCOMPARE(service.statistics().n_revalidations, size_t(1));
+    QCOMPARE(service.statistics().n_not_modified, size_t(1));
+
+    // a changed tile is downloaded again, together with its new etag
+    server.etags["/9/273/177.png"] = "\"v2\"";
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 3);
+    QCOMPARE(server.n_not_modified, 1);
+    QTRY_COMPARE(disk_cache->readWithMetadata("ortho", tile_id).metadata.etag, QByteArray("\"v2\""));
+
+    // fresh tiles don't go to the server
+    server.cache_control = "max-age=3600";
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 4);
+    QTRY_VERIFY(disk_cache->readWithMetadata("ortho", tile_id).metadata.isFresh(QDateTime::currentMSecsSinceEpoch()));
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 5);
+    QCOMPARE(server.n_requests, 4);
+  }
+
+  void servesStaleTilesWhileRevalidating() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    const auto tile_id = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    server.etags["/9/273/177.png"] = "\"v1\"";
+    server.latency_in_ms = 200;
+    auto disk_cache = std::make_shared<TileDiskCache>(dir.path());
+    QVERIFY(disk_cache->write("ortho", tile_id, "stale", {.etag = "\"v1\"", .last_modified = {}, .fresh_until = 0}));
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setDiskCache(disk_cache, "ortho");
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    service.load(tile_id);
+    QVERIFY(ready_spy.wait(150)); // before the server answers
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("stale"));
+    QCOMPARE(service.statistics().n_stale_hits, size_t(1));
+
+    // the 304 only refreshes the disk cache
+    QTRY_COMPARE(service.statistics().n_not_modified, size_t(1));
+    QTRY_VERIFY(disk_cache->readWithMetadata("ortho", tile_id).metadata.isFresh(QDateTime::currentMSecsSinceEpoch()));
+    QCOMPARE(ready_spy.count(), 1);
+    QCOMPARE(*disk_cache->read("ortho", tile_id), QByteArray("stale"));
+
+    // the stale tile is better than nothing, if the revalidation fails
+    QVERIFY(disk_cache->write("ortho", tile_id, "stale", {.etag = "\"v1\"", .last_modified = {}, .fresh_until = 0}));
+    server.missing_paths.insert("/9/273/177.png");
+    service.setStaleWhileRevalidate(false);
+    service.load(tile_id);
+    QTRY_COMPARE(ready_spy.count(), 2);
+    QCOMPARE(*ready_spy.back().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("stale"));
+    QCOMPARE(service.statistics().n_stale_if_error, size_t(1));
+  }
+
+  void keepsStaleTilesOfCoalescedRequests() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    const auto tile_id = srs::TileId{.zoom_level = 9, .coords = {273, 177}};
+    server.missing_paths.insert("/9/273/177.png");
+    server.latency_in_ms = 200;
+    auto disk_cache = std::make_shared<TileDiskCache>(dir.path());
+    TileLoadService service(server.baseUrl(), TileLoadService::UrlPattern::ZXY, ".png");
+    service.setDiskCache(disk_cache, "ortho");
+    service.setStaleWhileRevalidate(false);
+    QSignalSpy ready_spy(&service, &TileLoadService::loadReady);
+    QSignalSpy unavailable_spy(&service, &TileLoadService::tileUnavailable);
+    service.load(tile_id);
+    QTRY_COMPARE(service.numberOfDownloadsInFlight(), size_t(1));
+
+    // the revalidation joins the download, that is in flight already. its stale tile is used, when that fails.
+    QVERIFY(disk_cache->write("ortho", tile_id, "stale", {.etag = "\"v1\"", .last_modified = {}, .fresh_until = 0}));
+    service.load(tile_id);
+    QTRY_COMPARE(service.statistics().n_coalesced_requests, size_t(1));
+    QTRY_COMPARE(ready_spy.count(), 1);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("stale"));
+    QCOMPARE(service.statistics().n_stale_if_error, size_t(1));
+    QCOMPARE(unavailable_spy.count(), 0);
+    QCOMPARE(server.n_requests, 1);
+  }
 };
 
 
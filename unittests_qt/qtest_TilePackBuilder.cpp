@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TilePackBuilder.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QUrl>
+
+#include "alpine_renderer/TileArchive.h"
+#include "LocalTileServer.h"
+
+class TestTilePackBuilder : public QObject
+{
+  Q_OBJECT
+private:
+  // about 10km x 10km around vienna
+  const srs::Bounds m_bounds = {.min = {1817577.0, 6136664.0}, .max = {1827577.0, 6146664.0}};
+
+  std::vector<TilePackBuilder::Source> sources(const LocalTileServer& server) const {
+    return {{"height", server.baseUrl() + "height/", TileLoadService::UrlPattern::ZXY, ".png"},
+            {"ortho", server.baseUrl() + "ortho/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg"}};
+  }
+
+  static QString path(const TilePackBuilder::Source& source, const srs::TileId& tile_id) {
+    return QUrl(TileLoadService(source.base_url, source.url_pattern, source.file_ending).build_tile_url(tile_id)).path();
+  }
+
+private slots:
+  void tilesInRegion() {
+    const auto tiles = TilePackBuilder::tilesInRegion(m_bounds, 0, 12);
+    // one tile per level for the coarse levels
+    QCOMPARE(tiles.front(), (srs::TileId{.zoom_level = 0, .coords = {0, 0}}));
+    QVERIFY(tiles.size() >= 13 + 3);
+    QVERIFY(tiles.size() <= 13 * 9);
+    for (const auto& tile_id : tiles)
+      QVERIFY(tile_id.zoom_level <= 12);
+  }
+
+  void buildsArchivesOfARegion() {
+    LocalTileServer server;
+    QVERIFY(server.isListening());
+    QTemporaryDir dir;
+    const auto tiles = TilePackBuilder::tilesInRegion(m_bounds, 10, 12);
+    const auto missing_tile = tiles.back();
+    server.missing_paths.insert(path(sources(server)[0], missing_tile));
+
+    TilePackBuilder builder(sources(server), dir.filePath("staging"), 4);
+    QSignalSpy finished_spy(&builder, &TilePackBuilder::downloadsFinished);
+    builder.download(tiles);
+    QVERIFY(finished_spy.wait(5000));
+    QCOMPARE(builder.progress().n_requested, tiles.size() * 2);
+    QCOMPARE(builder.progress().n_downloaded, tiles.size() * 2 - 1);
+    QCOMPARE(builder.progress().n_unavailable, size_t(1));
+    QVERIFY(builder.maxObservedConcurrentDownloads() <= 4);
+
+    QVERIFY(builder.pack(tiles, dir.filePath("out")));
+    TileArchive height_archive(dir.filePath("out/height.atb"));
+    TileArchive ortho_archive(dir.filePath("out/ortho.atb"));
+    QVERIFY(height_archive.isValid());
+    QVERIFY(ortho_archive.isValid());
+    QCOMPARE(height_archive.numberOfTiles(), tiles.size() - 1);
+    QCOMPARE(ortho_archive.numberOfTiles(), tiles.size());
+    QVERIFY(!height_archive.contains(missing_tile));
+    for (const auto& tile_id : tiles) {
+      QCOMPARE(ortho_archive.tile(tile_id), LocalTileServer::payload(path(sources(server)[1], tile_id)));
+      if (tile_id != missing_tile)
+        QCOMPARE(height_archive.tile(tile_id), LocalTileServer::payload(path(sources(server)[0], tile_id)));
+    }
+  }
+
+  void countsTilesThatCouldNotBeStaged() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    const auto tiles = TilePackBuilder::tilesInRegion(m_bounds, 10, 10);
+    // a file in place of the directory of the height layer, the height tiles can't be written
+    QDir().mkpath(dir.filePath("staging"));
+    QFile blocker(dir.filePath("staging/height"));
+    QVERIFY(blocker.open(QIODevice::WriteOnly));
+    blocker.close();
+
+    TilePackBuilder builder(sources(server), dir.filePath("staging"));
+    QSignalSpy finished_spy(&builder, &TilePackBuilder::downloadsFinished);
+    builder.download(tiles);
+    QVERIFY(finished_spy.wait(5000));
+    QCOMPARE(builder.progress().n_downloaded, tiles.size());
+    QCOMPARE(builder.progress().n_failed_writes, tiles.size());
+    QCOMPARE(builder.progress().nDone(), builder.progress().n_requested);
+    QVERIFY(!builder.progress().complete());
+  }
+
+  void resumesInterruptedBuilds() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    const auto tiles = TilePackBuilder::tilesInRegion(m_bounds, 10, 12);
+    {
+      // a build, that got only half of the tiles
+      TilePackBuilder builder(sources(server), dir.filePath("staging"));
+      QSignalSpy finished_spy(&builder, &TilePackBuilder::downloadsFinished);
+      builder.download(std::vector<srs::TileId>(tiles.begin(), tiles.begin() + tiles.size() / 2));
+      QVERIFY(finished_spy.wait(5000));
+    }
+    const auto n_requests_before = server.n_requests;
+
+    TilePackBuilder builder(sources(server), dir.filePath("staging"));
+    QSignalSpy finished_spy(&builder, &TilePackBuilder::downloadsFinished);
+    builder.download(tiles);
+    QVERIFY(finished_spy.wait(5000));
+    QCOMPARE(builder.progress().n_staged_before, (tiles.size() / 2) * 2);
+    QCOMPARE(builder.progress().n_downloaded, (tiles.size() - tiles.size() / 2) * 2);
+    QCOMPARE(size_t(server.n_requests - n_requests_before), builder.progress().n_downloaded);
+
+    // nothing left to do
+    builder.download(tiles);
+    QVERIFY(finished_spy.wait(1000));
+    QCOMPARE(builder.progress().n_staged_before, tiles.size() * 2);
+    QCOMPARE(builder.progress().n_downloaded, size_t(0));
+  }
+
+  void capsConcurrentDownloads() {
+    LocalTileServer server;
+    QTemporaryDir dir;
+    TilePackBuilder builder(sources(server), dir.filePath("staging"), 2);
+    QSignalSpy finished_spy(&builder, &TilePackBuilder::downloadsFinished);
+    builder.download(TilePackBuilder::tilesInRegion(m_bounds, 10, 13));
+    QVERIFY(finished_spy.wait(5000));
+    QCOMPARE(builder.maxObservedConcurrentDownloads(), 2u);
+  }
+};
+
+QTEST_MAIN(TestTilePackBuilder)
+#include "qtest_TilePackBuilder.moc"
@@ -18,15 +18,23 @@
 
 #include "alpine_renderer/TileScheduler.h"
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <limits>
 #include <unordered_set>
+#include <utility>
 
 #include <QTest>
 #include <QSignalSpy>
+#include <QThread>
 #include <glm/glm.hpp>
 
 #include "alpine_renderer/Camera.h"
 #include "alpine_renderer/srs.h"
 #include "alpine_renderer/Tile.h"
+#include "alpine_renderer/tile_scheduler/utils.h"
+#include "alpine_renderer/tile_source/MemoryTileSource.h"
 
 class TestTileScheduler: public QObject
 {
@@ -41,6 +49,63 @@ private:
 
   virtual std::unique_ptr<TileScheduler> makeScheduler() const = 0;
 
+  // true if the area of the tile is drawn by the tile itself or by its descendants on the gpu
+  static bool isCoveredInDetail(const srs::TileId& tile_id, const TileScheduler::TileSet& gpu_tiles) {
+    if (gpu_tiles.contains(tile_id))
+      return true;
+    const auto finer_tile_on_gpu = std::any_of(gpu_tiles.begin(), gpu_tiles.end(), [&tile_id](const auto& id) {
+      return id.zoom_level > tile_id.zoom_level && srs::overlap(id, tile_id);
+    });
+    if (!finer_tile_on_gpu)
+      return false;
+    const auto children = srs::subtiles(tile_id);
+    return std::all_of(children.begin(), children.end(), [&gpu_tiles](const auto& child) { return isCoveredInDetail(child, gpu_tiles); });
+  }
+
+  // pans along a straight line (one camera update every 50ms), while the tiles arrive with a latency of a few camera updates.
+  // returns the number of visible tiles, that were not drawn in full detail, summed over all camera updates.
+  size_t replayPan(bool prefetching) {
+    auto scheduler = makeScheduler();
+    scheduler->setProgressive(true);
+    scheduler->prefetcher().setEnabled(prefetching);
+    scheduler->prefetcher().setMaxNumberOfTilesInFlight(256);
+    auto now = TilePrefetcher::Clock::time_point{};
+    scheduler->prefetcher().setTimeSource([&now]() { return now; });
+
+    const auto latency = 5u;
+    auto step = 0u;
+    std::deque<std::pair<unsigned, srs::TileId>> network; // arrival step and tile
+    const auto send = [&](const srs::TileId& tile_id) { network.emplace_back(step + latency, tile_id); };
+    connect(scheduler.get(), &TileScheduler::tileRequested, this, send);
+    connect(scheduler.get(), &TileScheduler::tilePrefetchRequested, this, send);
+    const auto deliver = [&](unsigned until_step) {
+      while (!network.empty() && network.front().first <= until_step) {
+        const auto tile_id = network.front().second;
+        network.pop_front();
+        scheduler->receiveOrthoTile(tile_id, std::make_shared<QByteArray>(m_ortho_bytes));
+        scheduler->receiveHeightTile(tile_id, std::make_shared<QByteArray>(m_height_bytes));
+      }
+    };
+
+    auto camera = test_cam;
+    scheduler->updateCamera(camera);
+    deliver(std::numeric_limits<unsigned>::max());
+
+    auto n_missing_tiles = size_t(0);
+    for (step = 1; step <= 40; ++step) {
+      now += std::chrono::milliseconds(50);
+      camera.move({50.0, 0.0, 0.0});
+      deliver(step);
+      scheduler->updateCamera(camera);
+      const auto gpu_tiles = scheduler->gpuTiles();
+      for (const auto& tile_id : tile_scheduler::visibleLeaves(camera, 4.0)) {
+        if (!isCoveredInDetail(tile_id, gpu_tiles))
+          n_missing_tiles++;
+      }
+    }
+    return n_missing_tiles;
+  }
+
 
 public slots:
   void giveTiles(const srs::TileId& tile_id) {
@@ -136,6 +201,33 @@ private slots:
     }
   }
 
+  void loadsTilesFromATileSource() {
+    TileScheduler::TileSet expected_tiles;
+    {
+      const auto reference_scheduler = makeScheduler();
+      connect(reference_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) { expected_tiles.insert(tile_id); });
+      reference_scheduler->updateCamera(test_cam);
+      QVERIFY(expected_tiles.size() >= 10);
+    }
+    MemoryTileSource ortho_source;
+    MemoryTileSource height_source;
+    for (const auto& tile_id : expected_tiles) {
+      ortho_source.insert(tile_id, std::make_shared<QByteArray>(m_ortho_bytes));
+      height_source.insert(tile_id, std::make_shared<QByteArray>(m_height_bytes));
+    }
+    connect(m_scheduler.get(), &TileScheduler::tileSetChanged, &ortho_source, &TileSource::loadBatch);
+    connect(m_scheduler.get(), &TileScheduler::tileSetChanged, &height_source, &TileSource::loadBatch);
+    connect(&ortho_source, &TileSource::loadReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(&height_source, &TileSource::loadReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    connect(&ortho_source, &TileSource::tileUnavailable, m_scheduler.get(), &TileScheduler::notifyAboutUnavailableOrthoTile);
+    connect(&height_source, &TileSource::tileUnavailable, m_scheduler.get(), &TileScheduler::notifyAboutUnavailableHeightTile);
+    TileScheduler::TileSet ready_tiles;
+    connect(m_scheduler.get(), &TileScheduler::tileReady, this, [&](const std::shared_ptr<Tile>& tile) { ready_tiles.insert(tile->id); });
+
+    m_scheduler->updateCamera(test_cam);
+    QTRY_VERIFY_WITH_TIMEOUT(std::all_of(expected_tiles.begin(), expected_tiles.end(), [&](const auto& id) { return ready_tiles.contains(id); }), 5000);
+  }
+
   void emitsReceivedTilesWhenSomeAreUnavailable() {
     m_unavailable_tiles.insert(srs::TileId{.zoom_level = 0, .coords = {0, 0}});
     m_unavailable_tiles.insert(srs::TileId{.zoom_level = 1, .coords = {0, 0}});
@@ -228,4 +320,344 @@ private slots:
       QVERIFY(gpu_tiles.contains(tile));
     }
   }
+
+  void prefetchingReducesMissingTilesDuringPans() {
+    const auto n_missing_tiles_without_prefetching = replayPan(false);
+    const auto n_missing_tiles_with_prefetching = replayPan(true);
+    qDebug("visible tiles not drawn in full detail during the pan: %zu without and %zu with prefetching",
+           n_missing_tiles_without_prefetching, n_missing_tiles_with_prefetching);
+    QVERIFY(n_missing_tiles_with_prefetching < n_missing_tiles_without_prefetching);
+  }
+
+  void adoptsTilesThatAreBeingPrefetched() {
+    auto now = TilePrefetcher::Clock::time_point{};
+    m_scheduler->prefetcher().setEnabled(true);
+    m_scheduler->prefetcher().setTimeSource([&now]() { return now; });
+    QSignalSpy prefetch_spy(m_scheduler.get(), &TileScheduler::tilePrefetchRequested);
+    QSignalSpy request_spy(m_scheduler.get(), &TileScheduler::tileRequested);
+    auto camera = test_cam;
+    m_scheduler->updateCamera(camera);
+    QVERIFY(prefetch_spy.empty());    // not moving yet
+    now += std::chrono::milliseconds(50);
+    camera.move({50.0, 0.0, 0.0});
+    m_scheduler->updateCamera(camera);
+    QVERIFY(!prefetch_spy.empty());
+    QVERIFY(m_scheduler->prefetcher().numberOfTilesInFlight() <= m_scheduler->prefetcher().maxNumberOfTilesInFlight());
+
+    std::unordered_set<srs::TileId, srs::TileId::Hasher> prefetched_tiles;
+    for (const QList<QVariant>& signal : prefetch_spy)
+      prefetched_tiles.insert(signal.at(0).value<srs::TileId>());
+
+    // arriving at the predicted position doesn't request the prefetched tiles again
+    now += std::chrono::milliseconds(300);
+    camera.move({300.0, 0.0, 0.0});
+    m_scheduler->updateCamera(camera);
+    std::vector<srs::TileId> requested_tiles;
+    for (const QList<QVariant>& signal : request_spy) {
+      const auto tile_id = signal.at(0).value<srs::TileId>();
+      QVERIFY(!prefetched_tiles.contains(tile_id));
+      requested_tiles.push_back(tile_id);
+    }
+
+    // and once they arrive, they are shipped
+    QSignalSpy ready_spy(m_scheduler.get(), &TileScheduler::tileReady);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    for (const auto& tile_id : requested_tiles)
+      giveTiles(tile_id);
+    for (const auto& tile_id : prefetched_tiles)
+      giveTiles(tile_id);
+    QCOMPARE(m_scheduler->prefetcher().numberOfTilesInFlight(), size_t(0));
+    QVERIFY(!ready_spy.empty());
+    QVERIFY(m_scheduler->tileCache().numberOfTiles() >= prefetched_tiles.size());
+  }
+
+  void prefetchesRingAroundTheViewWhenIdle() {
+    auto& prefetcher = m_scheduler->prefetcher();
+    prefetcher.setIdlePrefetchEnabled(true);
+    prefetcher.setIdleDelay(std::chrono::milliseconds(0)); // the idle timer fires in the next processEvents
+    prefetcher.setMaxNumberOfTilesInFlight(4);
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    QSignalSpy prefetch_spy(m_scheduler.get(), &TileScheduler::tilePrefetchRequested);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(prefetch_spy.empty());
+    QCoreApplication::processEvents();
+    QCOMPARE(prefetch_spy.size(), 4); // limited by the number of tiles in flight
+
+    const auto gpu_tiles = m_scheduler->gpuTiles();
+    const auto max_zoom_level = std::max_element(gpu_tiles.begin(), gpu_tiles.end(), [](const auto& a, const auto& b) { return a.zoom_level < b.zoom_level; })->zoom_level;
+    std::vector<srs::TileId> prefetched_tiles;
+    for (const QList<QVariant>& signal : prefetch_spy) {
+      const auto tile_id = signal.at(0).value<srs::TileId>();
+      QVERIFY(!gpu_tiles.contains(tile_id));
+      QVERIFY(tile_id.zoom_level < max_zoom_level);
+      prefetched_tiles.push_back(tile_id);
+    }
+    // prefetched tiles go into the cache, and the ring continues
+    for (const auto& tile_id : prefetched_tiles)
+      giveTiles(tile_id);
+    QCOMPARE(prefetcher.numberOfTilesInFlight(), size_t(0));
+    for (const auto& tile_id : prefetched_tiles)
+      QVERIFY(m_scheduler->tileCache().contains(tile_id));
+    QVERIFY(m_scheduler->gpuTiles() == gpu_tiles);
+    QCoreApplication::processEvents();
+    QVERIFY(prefetch_spy.size() > 4);
+
+    // moving the camera drops the ring around the old view
+    for (const QList<QVariant>& signal : prefetch_spy) {
+      if (prefetcher.isInFlight(signal.at(0).value<srs::TileId>()))
+        giveTiles(signal.at(0).value<srs::TileId>());
+    }
+    Camera replacement_cam = Camera({0.0, 0.0 - 500, 0.0 - 500}, {0.0, 0.0, -1000.0});
+    m_scheduler->updateCamera(replacement_cam);
+    prefetch_spy.clear();
+    QCoreApplication::processEvents();
+    QVERIFY(!prefetch_spy.empty());
+    const auto stephansdom = glm::dvec2(1822577.0, 6141664.0);
+    for (const QList<QVariant>& signal : prefetch_spy) {
+      const auto tile_id = signal.at(0).value<srs::TileId>();
+      QVERIFY(!srs::contains(srs::tile_bounds(tile_id), stephansdom));
+    }
+  }
+
+  void idleRingRespectsByteBudget() {
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    m_scheduler->updateCamera(test_cam);
+    const auto tile_bytes = m_scheduler->tileCache().sizeInBytes() / m_scheduler->tileCache().numberOfTiles();
+    auto& prefetcher = m_scheduler->prefetcher();
+    prefetcher.setIdlePrefetchEnabled(true);
+    prefetcher.setIdleDelay(std::chrono::milliseconds(0));
+    prefetcher.setIdleByteBudget(3 * tile_bytes);
+
+    QSignalSpy prefetch_spy(m_scheduler.get(), &TileScheduler::tilePrefetchRequested);
+    connect(m_scheduler.get(), &TileScheduler::tilePrefetchRequested, this, &TestTileScheduler::giveTiles);
+    m_scheduler->updateCamera(test_cam);
+    QCoreApplication::processEvents();
+    QCoreApplication::processEvents(); // the ring doesn't continue
+    QCOMPARE(prefetch_spy.size(), 3);
+  }
+
+  void adaptiveLodDropsDetailOverTileLimit() {
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    m_scheduler->updateCamera(test_cam);
+    const auto n_tiles_with_full_detail = m_scheduler->gpuTiles().size();
+    QVERIFY(n_tiles_with_full_detail >= 10);
+
+    auto& controller = m_scheduler->lodController();
+    controller.setEnabled(true);
+    controller.setMaxNumberOfTiles(n_tiles_with_full_detail / 2);
+    for (int i = 0; i < 10; ++i)
+      m_scheduler->updateCamera(test_cam);
+    QVERIFY(controller.state().threshold_scale > 1.0);
+    QCOMPARE(m_scheduler->lodPolicy()->thresholdScale(), controller.state().threshold_scale);
+    QVERIFY(m_scheduler->gpuTiles().size() < n_tiles_with_full_detail);
+  }
+
+  void adaptiveLodRelaxesWhileTheCameraRests() {
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    m_scheduler->updateCamera(test_cam);
+    const auto n_tiles_with_full_detail = m_scheduler->gpuTiles().size();
+
+    auto& controller = m_scheduler->lodController();
+    controller.setEnabled(true);
+    controller.setMaxNumberOfTiles(n_tiles_with_full_detail / 2);
+    for (int i = 0; i < 10; ++i)
+      m_scheduler->updateCamera(test_cam);
+    const auto n_coarsened_tiles = m_scheduler->gpuTiles().size();
+    QVERIFY(n_coarsened_tiles < n_tiles_with_full_detail);
+
+    // no more camera updates, the statistics timer drives the controller
+    controller.setMaxNumberOfTiles(n_tiles_with_full_detail * 4);
+    QTRY_COMPARE(controller.state().threshold_scale, 1.0);
+    QCOMPARE(m_scheduler->lodPolicy()->thresholdScale(), 1.0);
+    QVERIFY(m_scheduler->gpuTiles().size() > n_coarsened_tiles);
+  }
+
+  void sharesHeightTilesBetweenTiles() {
+    m_scheduler->setHeightZoomOffset(2);
+    TileScheduler::TileSet requested_height_tiles;
+    connect(m_scheduler.get(), &TileScheduler::heightTileRequested, this, [&](const srs::TileId& height_tile_id) {
+      QVERIFY(!requested_height_tiles.contains(height_tile_id));
+      requested_height_tiles.insert(height_tile_id);
+      emit heightTileReady(height_tile_id, std::make_shared<QByteArray>(m_height_bytes));
+    });
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) {
+      m_given_tiles.insert(tile_id);
+      emit orthoTileReady(tile_id, std::make_shared<QByteArray>(m_ortho_bytes));
+    });
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    QSignalSpy spy(m_scheduler.get(), &TileScheduler::tileReady);
+    m_scheduler->updateCamera(test_cam);
+
+    QVERIFY(m_given_tiles.size() >= 10);
+    QVERIFY(requested_height_tiles.size() < m_given_tiles.size());
+    QCOMPARE(size_t(spy.size()), m_given_tiles.size());
+    QVERIFY(m_scheduler->numberOfTilesInTransit() == 0);
+    for (const QList<QVariant>& signal : spy) {
+      const std::shared_ptr<Tile> tile = signal.at(0).value<std::shared_ptr<Tile>>();
+      QVERIFY(requested_height_tiles.contains(m_scheduler->heightTileId(tile->id)));
+      QVERIFY(tile->height_map.width() == 256);
+    }
+  }
+
+  void optionalLayersDontBlockShipping() {
+    const auto snow = m_scheduler->layers().add("snow", false);
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    QSignalSpy ready_spy(m_scheduler.get(), &TileScheduler::tileReady);
+    QSignalSpy layer_spy(m_scheduler.get(), &TileScheduler::tileLayerReady);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(m_given_tiles.size() >= 10);
+    QCOMPARE(size_t(ready_spy.size()), m_given_tiles.size());
+    QVERIFY(m_scheduler->numberOfWaitingHeightTiles() == 0);
+    QVERIFY(m_scheduler->numberOfWaitingOrthoTiles() == 0);
+
+    // the optional layer streams in later
+    const auto tile_id = *m_given_tiles.begin();
+    m_scheduler->receiveTileLayer(tile_id, snow, std::make_shared<QByteArray>(m_ortho_bytes));
+    QCOMPARE(layer_spy.size(), 1);
+    QCOMPARE(layer_spy.front().at(0).value<srs::TileId>(), tile_id);
+    QCOMPARE(layer_spy.front().at(1).value<unsigned>(), snow);
+    QVERIFY(m_scheduler->numberOfWaitingTiles(snow) == 0);
+    const auto cached_tile = m_scheduler->tileCache().get(tile_id);
+    QVERIFY(cached_tile);
+    QVERIFY(cached_tile->layers.contains(snow));
+  }
+
+  void requiredLayersBlockShipping() {
+    const auto hillshade = m_scheduler->layers().add("hillshade", true);
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    QSignalSpy spy(m_scheduler.get(), &TileScheduler::tileReady);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(m_given_tiles.size() >= 10);
+    QCOMPARE(spy.size(), 0);
+    QCOMPARE(m_scheduler->numberOfWaitingOrthoTiles(), m_given_tiles.size());
+
+    for (const auto& tile_id : m_given_tiles)
+      m_scheduler->receiveTileLayer(tile_id, hillshade, std::make_shared<QByteArray>(m_ortho_bytes));
+    QCOMPARE(size_t(spy.size()), m_given_tiles.size());
+    for (const QList<QVariant>& signal : spy) {
+      const std::shared_ptr<Tile> tile = signal.at(0).value<std::shared_ptr<Tile>>();
+      QVERIFY(tile->layers.contains(hillshade));
+    }
+  }
+
+  void usesTilesDecodedOnArrival() {
+    QImage decoded_ortho(32, 32, QImage::Format_ARGB32);
+    decoded_ortho.fill(Qt::red);
+    // the bytes are not decoded again, the given image is used
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) {
+      m_scheduler->receiveDecodedOrthoTile(tile_id, std::make_shared<QByteArray>("not an image"), decoded_ortho);
+      m_scheduler->receiveHeightTile(tile_id, std::make_shared<QByteArray>(m_height_bytes));
+    });
+    QSignalSpy spy(m_scheduler.get(), &TileScheduler::tileReady);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(spy.size() >= 10);
+    for (const QList<QVariant>& signal : spy) {
+      const std::shared_ptr<Tile> tile = signal.at(0).value<std::shared_ptr<Tile>>();
+      QCOMPARE(tile->orthotexture, decoded_ortho);
+      QVERIFY(tile->height_map.width() == 256);
+    }
+  }
+
+  void postedCamerasAreCoalesced() {
+    TileScheduler::TileSet expected_tiles;
+    {
+      const auto reference_scheduler = makeScheduler();
+      connect(reference_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) { expected_tiles.insert(tile_id); });
+      reference_scheduler->updateCamera(test_cam);
+    }
+
+    TileScheduler::TileSet requested_tiles;
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) { requested_tiles.insert(tile_id); });
+    Camera replacement_cam = Camera({0.0, 0.0 - 500, 0.0 - 500}, {0.0, 0.0, -1000.0});
+    replacement_cam.setPerspectiveParams(45, {1000, 1000}, 100);
+    m_scheduler->postCamera(replacement_cam);
+    m_scheduler->postCamera(test_cam);
+    QVERIFY(requested_tiles.empty()); // delivered through the event loop
+    QCoreApplication::processEvents();
+    QVERIFY(requested_tiles == expected_tiles); // replacement_cam was dropped
+  }
+
+  void runsInAWorkerThread() {
+    QThread thread;
+    m_scheduler->moveToThread(&thread);
+    thread.start();
+
+    // all connections are queued, the lambdas run in the test thread
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, &TestTileScheduler::giveTiles);
+    connect(this, &TestTileScheduler::orthoTileReady, m_scheduler.get(), &TileScheduler::receiveOrthoTile);
+    connect(this, &TestTileScheduler::heightTileReady, m_scheduler.get(), &TileScheduler::receiveHeightTile);
+    TileScheduler::TileSet shipped_tiles;
+    connect(m_scheduler.get(), &TileScheduler::tileReady, this, [&](const std::shared_ptr<Tile>& tile) {
+      QVERIFY(QThread::currentThread() == this->thread());
+      shipped_tiles.insert(tile->id);
+    });
+    TileScheduler::Statistics statistics;
+    connect(m_scheduler.get(), &TileScheduler::statisticsUpdated, this, [&](const TileScheduler::Statistics& new_statistics) { statistics = new_statistics; });
+
+    m_scheduler->postCamera(test_cam);
+    QTRY_VERIFY_WITH_TIMEOUT(m_given_tiles.size() >= 10 && shipped_tiles == m_given_tiles, 5000);
+    QTRY_VERIFY_WITH_TIMEOUT(statistics.n_gpu_tiles == m_given_tiles.size() && statistics.n_tiles_in_transit == 0, 1000);
+
+    QMetaObject::invokeMethod(m_scheduler.get(), [&]() { m_scheduler->moveToThread(this->thread()); }, Qt::BlockingQueuedConnection);
+    thread.quit();
+    thread.wait();
+  }
+
+  void batchesTileSignalsIntoOneDelta() {
+    QSignalSpy request_spy(m_scheduler.get(), &TileScheduler::tileRequested);
+    QSignalSpy delta_spy(m_scheduler.get(), &TileScheduler::tileSetChanged);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(request_spy.size() >= 10);
+    QVERIFY(delta_spy.empty()); // emitted, once the cycle is done
+    QCoreApplication::processEvents();
+    QCOMPARE(delta_spy.size(), 1);
+    const auto requests = delta_spy.front().at(0).value<TileSetDelta>();
+    QCOMPARE(requests.requested.size(), size_t(request_spy.size()));
+    QVERIFY(requests.ready.empty());
+    QVERIFY(requests.expired.empty());
+
+    for (const auto& tile_id : requests.requested) {
+      m_scheduler->receiveOrthoTile(tile_id, std::make_shared<QByteArray>(m_ortho_bytes));
+      m_scheduler->receiveHeightTile(tile_id, std::make_shared<QByteArray>(m_height_bytes));
+    }
+    QCoreApplication::processEvents();
+    QCOMPARE(delta_spy.size(), 2);
+    const auto shipment = delta_spy.back().at(0).value<TileSetDelta>();
+    QVERIFY(shipment.requested.empty());
+    QCOMPARE(shipment.ready.size(), requests.requested.size());
+  }
+
+  void timeSlicedUpdateConvergesToTheNewestCamera() {
+    TileScheduler::TileSet expected_tiles;
+    {
+      const auto reference_scheduler = makeScheduler();
+      connect(reference_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) { expected_tiles.insert(tile_id); });
+      reference_scheduler->updateCamera(test_cam);
+      QVERIFY(expected_tiles.size() >= 10);
+    }
+
+    m_scheduler->setTimeBudget(std::chrono::microseconds(1));
+    TileScheduler::TileSet requested_tiles;
+    connect(m_scheduler.get(), &TileScheduler::tileRequested, this, [&](const srs::TileId& tile_id) { requested_tiles.insert(tile_id); });
+    Camera replacement_cam = Camera({0.0, 0.0 - 500, 0.0 - 500}, {0.0, 0.0, -1000.0});
+    replacement_cam.setPerspectiveParams(45, {1000, 1000}, 100);
+    m_scheduler->updateCamera(replacement_cam);
+    m_scheduler->updateCamera(test_cam);
+    QVERIFY(requested_tiles.empty()); // the traversal takes a lot longer than the budget
+    QTRY_VERIFY_WITH_TIMEOUT(std::all_of(expected_tiles.begin(), expected_tiles.end(), [&](const auto& id) { return requested_tiles.contains(id); }), 5000);
+  }
 };
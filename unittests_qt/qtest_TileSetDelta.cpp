@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "alpine_renderer/TileSetDelta.h"
+
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QTest>
+#include <QThread>
+
+#include "alpine_renderer/Tile.h"
+
+class TileSender : public QObject
+{
+  Q_OBJECT
+signals:
+  void tileReady(const std::shared_ptr<Tile>& tile);
+  void tileSetChanged(const TileSetDelta& delta);
+};
+
+class TileReceiver : public QObject
+{
+  Q_OBJECT
+public:
+  std::atomic<size_t> n_received_tiles = 0;
+
+public slots:
+  void receiveTile(const std::shared_ptr<Tile>&) { n_received_tiles++; }
+  void receiveDelta(const TileSetDelta& delta) { n_received_tiles += delta.ready.size(); }
+};
+
+// per tile vs batched delivery of shipped tiles over a queued connection (the receiver lives in another thread)
+class TestTileSetDelta : public QObject
+{
+  Q_OBJECT
+  static constexpr size_t n_tiles = 512;
+  std::vector<std::shared_ptr<Tile>> m_tiles;
+  QThread m_thread;
+  TileReceiver m_receiver;
+  TileSender m_sender;
+
+  void sendPerTile() {
+    m_receiver.n_received_tiles = 0;
+    for (const auto& tile : m_tiles)
+      emit m_sender.tileReady(tile);
+    while (m_receiver.n_received_tiles < n_tiles)
+      QThread::yieldCurrentThread();
+  }
+
+  void sendBatched() {
+    m_receiver.n_received_tiles = 0;
+    TileSetDelta delta;
+    delta.ready = m_tiles;
+    emit m_sender.tileSetChanged(delta);
+    while (m_receiver.n_received_tiles < n_tiles)
+      QThread::yieldCurrentThread();
+  }
+
+private slots:
+  void initTestCase() {
+    for (unsigned i = 0; i < n_tiles; ++i) {
+      const auto id = srs::TileId{10, {i, 0}};
+      m_tiles.push_back(std::make_shared<Tile>(id, srs::tile_bounds(id), Raster<uint16_t>(64), QImage(256, 256, QImage::Format_ARGB32)));
+    }
+    connect(&m_sender, &TileSender::tileReady, &m_receiver, &TileReceiver::receiveTile);
+    connect(&m_sender, &TileSender::tileSetChanged, &m_receiver, &TileReceiver::receiveDelta);
+    m_receiver.moveToThread(&m_thread);
+    m_thread.start();
+  }
+
+  void cleanupTestCase() {
+    m_thread.quit();
+    m_thread.wait();
+  }
+
+  void perTileQueuedDelivery() {
+    QBENCHMARK {
+      sendPerTile();
+    }
+  }
+
+  void batchedQueuedDelivery() {
+    QBENCHMARK {
+      sendBatched();
+    }
+  }
+
+  void batchedDeliveryIsFaster() {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < 10; ++i)
+      sendPerTile();
+    const auto per_tile_time = timer.nsecsElapsed();
+    timer.restart();
+    for (int i = 0; i < 10; ++i)
+      sendBatched();
+    const auto batched_time = timer.nsecsElapsed();
+    qDebug() << "per tile:" << per_tile_time / 10'000 << "us, batched:" << batched_time / 10'000 << "us for" << n_tiles << "tiles";
+    QVERIFY(batched_time < per_tile_time);
+  }
+};
+
+QTEST_MAIN(TestTileSetDelta)
+#include "qtest_TileSetDelta.moc"
@@ -0,0 +1,219 @@
+/*****************************************************************************
+ * Alpine Terrain Builder
+ * Copyright (C) 2022 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "alpine_renderer/TileArchive.h"
+#include "alpine_renderer/TileLoadService.h"
+#include "alpine_renderer/tile_source/ArchiveTileSource.h"
+#include "alpine_renderer/tile_source/DirectoryTileSource.h"
+#include "alpine_renderer/tile_source/FallbackTileSource.h"
+#include "alpine_renderer/tile_source/MemoryTileSource.h"
+
+namespace {
+// counts the loads and prefetches, that reach it
+class CountingTileSource : public MemoryTileSource
+{
+public:
+  unsigned n_loads = 0;
+  unsigned n_prefetches = 0;
+  void load(const srs::TileId& tile_id) override
+  {
+    n_loads++;
+    MemoryTileSource::load(tile_id);
+  }
+  void prefetch(const srs::TileId& tile_id) override
+  {
+    n_prefetches++;
+    MemoryTileSource::load(tile_id);
+  }
+};
+}
+
+class TestTileSource : public QObject
+{
+  Q_OBJECT
+private:
+  const srs::TileId m_tile_a = {.zoom_level = 9, .coords = {273, 177}};
+  const srs::TileId m_tile_b = {.zoom_level = 9, .coords = {272, 179}};
+  const srs::TileId m_tile_c = {.zoom_level = 10, .coords = {544, 358}};
+
+private slots:
+  void tileAddress() {
+    const srs::TileId id = {.zoom_level = 2, .coords = {1, 0}};
+    QCOMPARE(TileSource::tileAddress(id, TileSource::UrlPattern::ZXY), QString("2/1/0"));
+    QCOMPARE(TileSource::tileAddress(id, TileSource::UrlPattern::ZYX), QString("2/0/1"));
+    QCOMPARE(TileSource::tileAddress(id, TileSource::UrlPattern::ZXY_yPointingSouth), QString("2/1/3"));
+    QCOMPARE(TileSource::tileAddress(id, TileSource::UrlPattern::ZYX_yPointingSouth), QString("2/3/1"));
+  }
+
+  void memorySource() {
+    MemoryTileSource source(10);
+    QSignalSpy ready_spy(&source, &TileSource::loadReady);
+    QSignalSpy unavailable_spy(&source, &TileSource::tileUnavailable);
+    source.insert(m_tile_a, std::make_shared<QByteArray>("aaaa"));
+    source.insert(m_tile_b, std::make_shared<QByteArray>("bbbb"));
+    QCOMPARE(source.sizeInBytes(), size_t(8));
+
+    source.load(m_tile_a);
+    source.load(m_tile_c);
+    QCOMPARE(ready_spy.size(), 0); // never from within load
+    QTRY_COMPARE(ready_spy.size(), 1);
+    QTRY_COMPARE(unavailable_spy.size(), 1);
+    QCOMPARE(ready_spy.front().at(0).value<srs::TileId>(), m_tile_a);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("aaaa"));
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), m_tile_c);
+
+    // a was loaded, b is the least recently used tile
+    source.store(m_tile_c, std::make_shared<QByteArray>("cccc"));
+    QVERIFY(source.contains(m_tile_a));
+    QVERIFY(!source.contains(m_tile_b));
+    QVERIFY(source.contains(m_tile_c));
+    QVERIFY(source.sizeInBytes() <= source.byteBudget());
+  }
+
+  void directorySource() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir().mkpath(dir.filePath("9/273")));
+    QFile file(dir.filePath("9/273/177.png"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("height a");
+    file.close();
+
+    DirectoryTileSource source(dir.path(), TileSource::UrlPattern::ZXY, ".png");
+    QSignalSpy ready_spy(&source, &TileSource::loadReady);
+    QSignalSpy unavailable_spy(&source, &TileSource::tileUnavailable);
+    source.load(m_tile_a);
+    source.load(m_tile_b);
+    QTRY_COMPARE(ready_spy.size(), 1);
+    QTRY_COMPARE(unavailable_spy.size(), 1);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("height a"));
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), m_tile_b);
+
+    source.store(m_tile_b, std::make_shared<QByteArray>("height b"));
+    QVERIFY(QFileInfo::exists(dir.filePath("9/272/179.png")));
+    source.load(m_tile_b);
+    QTRY_COMPARE(ready_spy.size(), 2);
+    QCOMPARE(*ready_spy.back().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("height b"));
+  }
+
+  void archiveSource() {
+    QTemporaryDir dir;
+    {
+      TileArchiveWriter writer(dir.filePath("ortho.atb"));
+      QVERIFY(writer.add(m_tile_a, "ortho a"));
+      QVERIFY(writer.finish());
+    }
+    auto source = std::make_unique<ArchiveTileSource>(std::make_shared<TileArchive>(dir.filePath("ortho.atb")));
+    QSignalSpy ready_spy(source.get(), &TileSource::loadReady);
+    QSignalSpy unavailable_spy(source.get(), &TileSource::tileUnavailable);
+    source->load(m_tile_a);
+    source->load(m_tile_b);
+    QTRY_COMPARE(ready_spy.size(), 1);
+    QTRY_COMPARE(unavailable_spy.size(), 1);
+
+    // the data keeps the archive mapped
+    const auto data = ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>();
+    ready_spy.clear();
+    source.reset();
+    QCOMPARE(*data, QByteArray("ortho a"));
+  }
+
+  void fallbackAsksTheSourcesInOrder() {
+    auto memory = std::make_shared<CountingTileSource>();
+    auto disk = std::make_shared<CountingTileSource>();
+    auto network = std::make_shared<CountingTileSource>();
+    disk->insert(m_tile_a, std::make_shared<QByteArray>("disk a"));
+    network->insert(m_tile_a, std::make_shared<QByteArray>("network a"));
+    network->insert(m_tile_b, std::make_shared<QByteArray>("network b"));
+    FallbackTileSource source({memory, disk, network});
+    QSignalSpy ready_spy(&source, &TileSource::loadReady);
+    QSignalSpy unavailable_spy(&source, &TileSource::tileUnavailable);
+
+    source.load(m_tile_a);
+    source.load(m_tile_a); // answered once
+    source.load(m_tile_b);
+    source.prefetch(m_tile_c);
+    QCOMPARE(ready_spy.size(), 0);
+    QTRY_COMPARE(ready_spy.size(), 2);
+    QTRY_COMPARE(unavailable_spy.size(), 1);
+    QCOMPARE(source.numberOfTilesInFlight(), size_t(0));
+    for (const auto& signal : ready_spy) {
+      const auto tile_id = signal.at(0).value<srs::TileId>();
+      const auto data = *signal.at(1).value<std::shared_ptr<QByteArray>>();
+      QCOMPARE(data, tile_id == m_tile_a ? QByteArray("disk a") : QByteArray("network b"));
+    }
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), m_tile_c);
+    QCOMPARE(memory->n_loads, 2u);
+    QCOMPARE(disk->n_loads, 2u);
+    QCOMPARE(network->n_loads, 1u);
+    QCOMPARE(network->n_prefetches, 1u); // stays a prefetch along the chain
+
+    // stored in the sources before the one, that had it
+    QVERIFY(memory->contains(m_tile_a));
+    QVERIFY(memory->contains(m_tile_b));
+    QVERIFY(disk->contains(m_tile_b));
+    QVERIFY(!memory->contains(m_tile_c));
+
+    source.load(m_tile_b);
+    QTRY_COMPARE(ready_spy.size(), 3);
+    QCOMPARE(memory->n_loads, 3u);
+    QCOMPARE(disk->n_loads, 2u);
+  }
+
+  void fallbackIgnoresAnswersToOtherRequesters() {
+    auto memory = std::make_shared<MemoryTileSource>();
+    memory->insert(m_tile_a, std::make_shared<QByteArray>("a"));
+    FallbackTileSource source({memory});
+    QSignalSpy ready_spy(&source, &TileSource::loadReady);
+    memory->load(m_tile_a);
+    QTest::qWait(10);
+    QCOMPARE(ready_spy.size(), 0);
+  }
+
+  void fallbackServesArchivedTilesOffline() {
+    QTemporaryDir dir;
+    {
+      TileArchiveWriter writer(dir.filePath("ortho.atb"));
+      QVERIFY(writer.add(m_tile_a, "archived"));
+      QVERIFY(writer.finish());
+    }
+    // as in alpine_gl_renderer with --ortho-archive and --offline
+    auto archive = std::make_shared<ArchiveTileSource>(std::make_shared<TileArchive>(dir.filePath("ortho.atb")));
+    auto network = std::make_shared<TileLoadService>("", TileLoadService::UrlPattern::ZYX, ".jpeg");
+    FallbackTileSource source({archive, network});
+    QSignalSpy ready_spy(&source, &TileSource::loadReady);
+    QSignalSpy unavailable_spy(&source, &TileSource::tileUnavailable);
+    source.load(m_tile_a);
+    source.load(m_tile_b);
+    QCOMPARE(ready_spy.size(), 0); // queued
+    QTRY_COMPARE(ready_spy.size() + unavailable_spy.size(), 2);
+    QCOMPARE(ready_spy.size(), 1);
+    QCOMPARE(*ready_spy.front().at(1).value<std::shared_ptr<QByteArray>>(), QByteArray("archived"));
+    QCOMPARE(unavailable_spy.front().at(0).value<srs::TileId>(), m_tile_b);
+  }
+};
+
+QTEST_MAIN(TestTileSource)
+#include "qtest_TileSource.moc"